@@ -0,0 +1,55 @@
+/**
+ * AccountID -> r-address cache
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "account_cache.h"
+#include "libbase58.h"
+
+// counters of caches already retired
+static uint64_t retired_hits = 0;
+static uint64_t retired_misses = 0;
+
+const char* account_cache_lookup(struct account_cache* cache, const uint8_t* id, size_t* len)
+{
+    // AccountIDs are hash outputs, any four bytes of them index well
+    uint32_t h;
+    memcpy(&h, id, sizeof(h));
+    struct account_cache_entry* e = &cache->entries[(h * 0x9E3779B1U) >> (32 - ACCOUNT_CACHE_BITS)];
+
+    if (e->len && memcmp(e->id, id, 20) == 0)
+    {
+        cache->hits++;
+        *len = e->len;
+        return e->address;
+    }
+
+    cache->misses++;
+
+    size_t address_len = sizeof(e->address);
+    if (!b58check_enc_account(e->address, &address_len, 0, id))
+    {
+        e->len = 0;
+        return 0;
+    }
+
+    memcpy(e->id, id, 20);
+    e->len = address_len;
+    *len = address_len;
+    return e->address;
+}
+
+void account_cache_stats(uint64_t* hits, uint64_t* misses)
+{
+    *hits = __atomic_load_n(&retired_hits, __ATOMIC_RELAXED);
+    *misses = __atomic_load_n(&retired_misses, __ATOMIC_RELAXED);
+}
+
+void account_cache_retire(const struct account_cache* cache)
+{
+    __atomic_add_fetch(&retired_hits, cache->hits, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&retired_misses, cache->misses, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,42 @@
+#ifndef ACCOUNT_CACHE_H
+#define ACCOUNT_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * AccountID -> r-address cache
+ * Direct mapped, one 64 byte line per entry. Metadata repeats the same few accounts many times,
+ * a hit skips the double SHA-256 and base58 conversion entirely.
+ */
+#define ACCOUNT_CACHE_BITS 10
+#define ACCOUNT_CACHE_SIZE (1U << ACCOUNT_CACHE_BITS)
+
+struct account_cache_entry
+{
+    uint8_t id[20];
+    uint8_t len;        // length of address including the NUL, 0 if the entry is empty
+    char address[43];
+} __attribute__((aligned(64)));
+
+struct account_cache
+{
+    struct account_cache_entry entries[ACCOUNT_CACHE_SIZE];
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/**
+ * Return the NUL terminated r-address of the 20 byte AccountID `id`, or 0 if it could not be encoded.
+ * `len` receives the address length including the NUL (as b58check_enc reports it).
+ * The pointer is valid until the next lookup in the same cache.
+ */
+const char* account_cache_lookup(struct account_cache* cache, const uint8_t* id, size_t* len);
+
+// hit and miss counters summed over every retired cache
+void account_cache_stats(uint64_t* hits, uint64_t* misses);
+
+// add a cache's counters to the totals account_cache_stats() reports, before it is freed
+void account_cache_retire(const struct account_cache* cache);
+
+#endif
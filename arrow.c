@@ -0,0 +1,1035 @@
+/**
+ * Arrow IPC file writer, see arrow.h
+ * The file is the magic, a Schema message, then dictionary and record batch messages, then a Footer that lists
+ * where each batch is. The message metadata is FlatBuffers, built by the small back to front builder below.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "arrow.h"
+
+// from Arrow's Schema.fbs and Message.fbs
+#define ARROW_METADATA_V5 4
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_BINARY 4
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_FIXED_SIZE_BINARY 15
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY_BATCH 2
+#define ARROW_HEADER_RECORD_BATCH 3
+
+static const uint8_t zeros[8];
+
+/**
+ * FlatBuffers builder
+ * The buffer fills from its end towards its start, so a child is always written before the table that refers to
+ * it. A ref is where something starts, counted in bytes from the end of the buffer.
+ */
+struct fb
+{
+    uint8_t* buf;
+    size_t capacity;
+    size_t used;
+    int failed;
+    size_t table;           // used when the current table was started
+    uint32_t fields[8];     // ref of each of its fields, 0 when absent
+    int field_count;
+};
+
+static int fb_reserve(struct fb* b, size_t len)
+{
+    if (b->failed)
+        return 0;
+    if (b->used + len <= b->capacity)
+        return 1;
+
+    size_t capacity = b->capacity * 2 + len + 1024;
+    uint8_t* buf = malloc(capacity);
+    if (!buf)
+    {
+        b->failed = 1;
+        return 0;
+    }
+    if (b->used > 0)
+        memcpy(buf + capacity - b->used, b->buf + b->capacity - b->used, b->used);
+    free(b->buf);
+    b->buf = buf;
+    b->capacity = capacity;
+    return 1;
+}
+
+static void fb_push(struct fb* b, const void* data, size_t len)
+{
+    if (!fb_reserve(b, len))
+        return;
+    b->used += len;
+    if (len > 0)
+        memcpy(b->buf + b->capacity - b->used, data, len);
+}
+
+// pad so that once `len` more bytes are pushed the front is aligned to `align`
+static void fb_prep(struct fb* b, size_t align, size_t len)
+{
+    fb_push(b, zeros, (align - (b->used + len) % align) % align);
+}
+
+// little endian whatever the host
+static void fb_scalar(struct fb* b, uint64_t value, int size)
+{
+    uint8_t bytes[8];
+    for (int i = 0; i < size; ++i)
+        bytes[i] = (uint8_t)(value >> (i * 8U));
+    fb_prep(b, size, size);
+    fb_push(b, bytes, size);
+}
+
+// an offset pointing forward to `ref`, relative to where the offset itself is
+static void fb_offset(struct fb* b, uint32_t ref)
+{
+    fb_prep(b, 4, 4);
+    fb_scalar(b, b->used + 4 - ref, 4);
+}
+
+static uint32_t fb_string(struct fb* b, const char* str, size_t len)
+{
+    fb_prep(b, 4, len + 1);
+    fb_push(b, "", 1);
+    fb_push(b, str, len);
+    fb_scalar(b, len, 4);
+    return b->used;
+}
+
+static uint32_t fb_offsets(struct fb* b, const uint32_t* refs, int count)
+{
+    fb_prep(b, 4, count * 4);
+    for (int i = count - 1; i >= 0; --i)
+        fb_offset(b, refs[i]);
+    fb_scalar(b, count, 4);
+    return b->used;
+}
+
+// a vector of `count` structs made of `per_struct` 64 bit words each (FieldNode, Buffer and Block)
+static uint32_t fb_structs(struct fb* b, const int64_t* words, int count, int per_struct)
+{
+    fb_prep(b, 4, count * per_struct * 8);
+    fb_prep(b, 8, count * per_struct * 8);
+    for (int i = count * per_struct - 1; i >= 0; --i)
+        fb_scalar(b, words[i], 8);
+    fb_scalar(b, count, 4);
+    return b->used;
+}
+
+static void fb_table(struct fb* b)
+{
+    memset(b->fields, 0, sizeof(b->fields));
+    b->field_count = 0;
+    b->table = b->used;
+}
+
+static void fb_field(struct fb* b, int slot)
+{
+    b->fields[slot] = b->used;
+    if (slot >= b->field_count)
+        b->field_count = slot + 1;
+}
+
+static void fb_add_scalar(struct fb* b, int slot, uint64_t value, int size)
+{
+    fb_scalar(b, value, size);
+    fb_field(b, slot);
+}
+
+static void fb_add_offset(struct fb* b, int slot, uint32_t ref)
+{
+    fb_offset(b, ref);
+    fb_field(b, slot);
+}
+
+// the table's vtable goes just in front of it, the table starts with the signed distance back to it
+static uint32_t fb_end(struct fb* b)
+{
+    fb_scalar(b, 0, 4);
+    uint32_t table = b->used;
+
+    uint16_t vtable[2 + 8];
+    vtable[0] = 4 + 2 * b->field_count;
+    vtable[1] = table - b->table;
+    for (int i = 0; i < b->field_count; ++i)
+        vtable[2 + i] = (b->fields[i] ? table - b->fields[i] : 0);
+    for (int i = b->field_count + 1; i >= 0; --i)
+        fb_scalar(b, vtable[i], 2);
+
+    if (!b->failed)
+    {
+        uint32_t distance = b->used - table;
+        for (int i = 0; i < 4; ++i)
+            b->buf[b->capacity - table + i] = (uint8_t)(distance >> (i * 8U));
+    }
+    return table;
+}
+
+// the root offset, the whole buffer comes out a multiple of 8 bytes long
+static void fb_finish(struct fb* b, uint32_t root)
+{
+    fb_prep(b, 8, 4);
+    fb_offset(b, root);
+}
+
+static uint32_t fb_empty_table(struct fb* b)
+{
+    fb_table(b);
+    return fb_end(b);
+}
+
+static uint32_t fb_int_type(struct fb* b, int bits, int is_signed)
+{
+    fb_table(b);
+    fb_add_scalar(b, 0, bits, 4);
+    fb_add_scalar(b, 1, is_signed, 1);
+    return fb_end(b);
+}
+
+static int buffer_reserve(struct arrow_buffer* buffer, size_t len)
+{
+    if (buffer->len + len <= buffer->capacity)
+        return 1;
+
+    size_t capacity = (buffer->capacity ? buffer->capacity * 2 : 4096);
+    while (capacity < buffer->len + len)
+        capacity *= 2;
+    uint8_t* data = realloc(buffer->data, capacity);
+    if (!data)
+        return 0;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 1;
+}
+
+static int buffer_push(struct arrow_buffer* buffer, const void* data, size_t len)
+{
+    if (!buffer_reserve(buffer, len))
+        return 0;
+    // an empty value may have no bytes at all behind it, nor the buffer yet
+    if (len > 0)
+        memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return 1;
+}
+
+static int buffer_int32(struct arrow_buffer* buffer, int32_t value)
+{
+    return buffer_push(buffer, &value, sizeof(value));
+}
+
+// returns the new entry or -1 if out of memory
+static int dictionary_add(struct arrow_dictionary* dictionary, const char* str, int len)
+{
+    if (dictionary->offsets.len == 0 && !buffer_int32(&dictionary->offsets, 0))
+        return -1;
+    if (!buffer_push(&dictionary->values, str, len) ||
+            !buffer_int32(&dictionary->offsets, (int32_t)dictionary->values.len))
+        return -1;
+    return dictionary->count++;
+}
+
+#define CURRENCY_SLOT 24    // 20 byte currency code then the entry + 1, 0 for an empty slot
+
+static uint32_t currency_hash(const uint8_t* currency)
+{
+    uint32_t h = 2166136261U;
+    for (int i = 0; i < 20; ++i)
+        h = (h ^ currency[i]) * 16777619U;
+    return h;
+}
+
+static uint8_t* currency_slot(uint8_t* slots, int slot_count, const uint8_t* currency)
+{
+    for (uint32_t slot = currency_hash(currency);; slot++)
+    {
+        uint8_t* s = slots + (slot & (slot_count - 1)) * CURRENCY_SLOT;
+        int32_t entry;
+        memcpy(&entry, s + 20, sizeof(entry));
+        if (entry == 0 || memcmp(s, currency, 20) == 0)
+            return s;
+    }
+}
+
+// the currency's entry, which is added the first time it is seen. -1 if out of memory
+static int dictionary_currency(struct arrow_dictionary* dictionary, const uint8_t* currency)
+{
+    // rehashed into twice the slots once half full
+    if (dictionary->count * 2 >= dictionary->currency_slots)
+    {
+        int slot_count = (dictionary->currency_slots ? dictionary->currency_slots * 2 : 64);
+        uint8_t* slots = calloc(slot_count, CURRENCY_SLOT);
+        if (!slots)
+            return -1;
+        for (int i = 0; i < dictionary->currency_slots; ++i)
+        {
+            uint8_t* s = dictionary->currencies + i * CURRENCY_SLOT;
+            int32_t entry;
+            memcpy(&entry, s + 20, sizeof(entry));
+            if (entry)
+                memcpy(currency_slot(slots, slot_count, s), s, CURRENCY_SLOT);
+        }
+        free(dictionary->currencies);
+        dictionary->currencies = slots;
+        dictionary->currency_slots = slot_count;
+    }
+
+    uint8_t* s = currency_slot(dictionary->currencies, dictionary->currency_slots, currency);
+    int32_t entry;
+    memcpy(&entry, s + 20, sizeof(entry));
+    if (entry)
+        return entry - 1;
+
+    char code[40];
+    entry = dictionary_add(dictionary, code, xd_currency_code(code, currency));
+    if (entry < 0)
+        return -1;
+    memcpy(s, currency, 20);
+    entry++;
+    memcpy(s + 20, &entry, sizeof(entry));
+    return entry - 1;
+}
+
+static int write_all(int fd, const uint8_t* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return 0;
+        data += written;
+        len -= written;
+    }
+    return 1;
+}
+
+static int arrow_flush_output(struct arrow_writer* w)
+{
+    int ok = write_all(w->fd, w->write_buffer, w->write_len);
+    w->write_len = 0;
+    return ok;
+}
+
+static int arrow_write(struct arrow_writer* w, const void* data, size_t len)
+{
+    w->offset += len;
+    if (w->write_len + len > ARROW_WRITE_BUFFER_SIZE && !arrow_flush_output(w))
+        return 0;
+    if (len >= ARROW_WRITE_BUFFER_SIZE)
+        return write_all(w->fd, data, len);
+    if (len > 0)
+        memcpy(w->write_buffer + w->write_len, data, len);
+    w->write_len += len;
+    return 1;
+}
+
+static int arrow_block(int64_t** blocks, int* count, int64_t offset, int64_t metadata_len, int64_t body_len)
+{
+    int64_t* grown = realloc(*blocks, (*count + 1) * 3 * sizeof(int64_t));
+    if (!grown)
+        return 0;
+    *blocks = grown;
+    grown[*count * 3 + 0] = offset;
+    grown[*count * 3 + 1] = metadata_len;   // an int32 then 4 bytes of padding in the Block struct
+    grown[*count * 3 + 2] = body_len;
+    (*count)++;
+    return 1;
+}
+
+// the buffers of one column in a batch, in the order the format lays them out
+struct arrow_array
+{
+    int64_t length;
+    int64_t null_count;
+    int buffer_count;
+    const uint8_t* buffers[3];
+    size_t lens[3];
+};
+
+static uint32_t arrow_schema(struct arrow_writer* w, struct fb* b)
+{
+    uint32_t fields[ARROW_COLUMNS];
+    for (int i = 0; i < w->count; ++i)
+    {
+        const struct arrow_column* c = &w->columns[i];
+        uint32_t name = fb_string(b, c->name, strlen(c->name));
+        uint32_t children = fb_offsets(b, 0, 0);
+
+        int type_type = ARROW_TYPE_UTF8;
+        uint32_t type = 0;
+        uint32_t dictionary = 0;
+        if (c->type == ARROW_INT)
+        {
+            type_type = ARROW_TYPE_INT;
+            type = fb_int_type(b, c->width * 8, c->is_signed);
+        }
+        else if (c->type == ARROW_FIXED)
+        {
+            type_type = ARROW_TYPE_FIXED_SIZE_BINARY;
+            fb_table(b);
+            fb_add_scalar(b, 0, c->width, 4);
+            type = fb_end(b);
+        }
+        else if (c->type == ARROW_BINARY)
+        {
+            type_type = ARROW_TYPE_BINARY;
+            type = fb_empty_table(b);
+        }
+        else
+        {
+            type = fb_empty_table(b);
+            if (c->type == ARROW_DICTIONARY)
+            {
+                // the field's type is that of the dictionary's values, the indices are described here
+                uint32_t index_type = fb_int_type(b, 32, 1);
+                fb_table(b);
+                fb_add_scalar(b, 0, i, 8);
+                fb_add_offset(b, 1, index_type);
+                dictionary = fb_end(b);
+            }
+        }
+
+        fb_table(b);
+        fb_add_offset(b, 0, name);
+        fb_add_scalar(b, 1, 1, 1);
+        fb_add_scalar(b, 2, type_type, 1);
+        fb_add_offset(b, 3, type);
+        if (dictionary)
+            fb_add_offset(b, 4, dictionary);
+        fb_add_offset(b, 5, children);
+        fields[i] = fb_end(b);
+    }
+
+    uint32_t vector = fb_offsets(b, fields, w->count);
+    fb_table(b);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    fb_add_scalar(b, 0, 1, 2);
+#else
+    fb_add_scalar(b, 0, 0, 2);
+#endif
+    fb_add_offset(b, 1, vector);
+    return fb_end(b);
+}
+
+// a RecordBatch table for `arrays`, `body_len` receives the size of the body they make
+static uint32_t arrow_record_batch(struct fb* b, const struct arrow_array* arrays, int count, int64_t rows,
+        int64_t* body_len)
+{
+    int64_t nodes[ARROW_COLUMNS * 2];
+    int64_t buffers[ARROW_COLUMNS * 6];
+    int buffer_count = 0;
+    int64_t offset = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        nodes[i * 2] = arrays[i].length;
+        nodes[i * 2 + 1] = arrays[i].null_count;
+        for (int j = 0; j < arrays[i].buffer_count; ++j)
+        {
+            buffers[buffer_count * 2] = offset;
+            buffers[buffer_count * 2 + 1] = arrays[i].lens[j];
+            buffer_count++;
+            offset += (arrays[i].lens[j] + 7) & ~7ULL;
+        }
+    }
+    *body_len = offset;
+
+    uint32_t node_vector = fb_structs(b, nodes, count, 2);
+    uint32_t buffer_vector = fb_structs(b, buffers, buffer_count, 2);
+    fb_table(b);
+    fb_add_scalar(b, 0, rows, 8);
+    fb_add_offset(b, 1, node_vector);
+    fb_add_offset(b, 2, buffer_vector);
+    return fb_end(b);
+}
+
+/**
+ * Write one encapsulated message: the continuation marker, the metadata length, the Message flatbuffer then the
+ * body, each buffer padded to 8 bytes. Its block is recorded for the footer when `blocks` is set.
+ */
+static int arrow_message(struct arrow_writer* w, struct fb* b, int header_type, uint32_t header, int64_t body_len,
+        const struct arrow_array* arrays, int count, int64_t** blocks, int* block_count)
+{
+    fb_table(b);
+    fb_add_scalar(b, 0, ARROW_METADATA_V5, 2);
+    fb_add_scalar(b, 1, header_type, 1);
+    fb_add_offset(b, 2, header);
+    fb_add_scalar(b, 3, body_len, 8);
+    fb_finish(b, fb_end(b));
+    if (b->failed)
+        return (snprintf(w->error, sizeof(w->error), "out of memory"), 0);
+
+    uint64_t start = w->offset;
+    uint8_t prefix[8] = { 0xFF, 0xFF, 0xFF, 0xFF,
+        (uint8_t)b->used, (uint8_t)(b->used >> 8U), (uint8_t)(b->used >> 16U), (uint8_t)(b->used >> 24U) };
+    int ok = arrow_write(w, prefix, 8) && arrow_write(w, b->buf + b->capacity - b->used, b->used);
+    for (int i = 0; ok && i < count; ++i)
+        for (int j = 0; ok && j < arrays[i].buffer_count; ++j)
+            ok = arrow_write(w, arrays[i].buffers[j], arrays[i].lens[j]) &&
+                 arrow_write(w, zeros, (8 - arrays[i].lens[j] % 8) % 8);
+    if (!ok)
+        return (snprintf(w->error, sizeof(w->error), "output could not be written"), 0);
+
+    if (blocks && !arrow_block(blocks, block_count, start, 8 + b->used, body_len))
+        return (snprintf(w->error, sizeof(w->error), "out of memory"), 0);
+    return 1;
+}
+
+// the dictionary entries added since its last batch, all of them the first time
+static int arrow_dictionary_batch(struct arrow_writer* w, int id, struct arrow_dictionary* dictionary)
+{
+    int first = dictionary->written;
+    int count = dictionary->count - first;
+    if (dictionary->offsets.len == 0 && !buffer_int32(&dictionary->offsets, 0))
+        return (snprintf(w->error, sizeof(w->error), "out of memory"), 0);
+
+    // a delta's offsets start again from 0
+    const int32_t* offsets = (const int32_t*)dictionary->offsets.data;
+    int32_t* rebased = malloc((count + 1) * sizeof(int32_t));
+    if (!rebased)
+        return (snprintf(w->error, sizeof(w->error), "out of memory"), 0);
+    for (int i = 0; i <= count; ++i)
+        rebased[i] = offsets[first + i] - offsets[first];
+
+    struct arrow_array array = { count, 0, 3,
+        { 0, (uint8_t*)rebased, dictionary->values.data + offsets[first] },
+        { 0, (count + 1) * sizeof(int32_t), offsets[dictionary->count] - offsets[first] } };
+
+    struct fb b = { 0 };
+    int64_t body_len = 0;
+    uint32_t data = arrow_record_batch(&b, &array, 1, count, &body_len);
+    fb_table(&b);
+    fb_add_scalar(&b, 0, id, 8);
+    fb_add_offset(&b, 1, data);
+    fb_add_scalar(&b, 2, (first > 0), 1);
+    uint32_t header = fb_end(&b);
+    int ok = arrow_message(w, &b, ARROW_HEADER_DICTIONARY_BATCH, header, body_len, &array, 1,
+            &w->dictionary_blocks, &w->dictionary_block_count);
+    free(b.buf);
+    free(rebased);
+
+    dictionary->written = dictionary->count;
+    return ok;
+}
+
+static int arrow_column_reset(struct arrow_column* c)
+{
+    c->validity.len = 0;
+    c->values.len = 0;
+    c->offsets.len = 0;
+    c->null_count = 0;
+    return (c->type != ARROW_UTF8 && c->type != ARROW_BINARY) || buffer_int32(&c->offsets, 0);
+}
+
+// write out the rows so far as a record batch, preceded by any dictionary entries they brought
+static int arrow_flush(struct arrow_writer* w)
+{
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct arrow_dictionary* dictionary = w->columns[i].dictionary;
+        if (dictionary && (w->batch_block_count == 0 || dictionary->count > dictionary->written) &&
+                !arrow_dictionary_batch(w, i, dictionary))
+            return 0;
+    }
+
+    struct arrow_array arrays[ARROW_COLUMNS];
+    for (int i = 0; i < w->count; ++i)
+    {
+        const struct arrow_column* c = &w->columns[i];
+        struct arrow_array* a = &arrays[i];
+        a->length = w->rows;
+        a->null_count = c->null_count;
+        a->buffer_count = 0;
+        a->buffers[a->buffer_count] = c->validity.data;
+        a->lens[a->buffer_count++] = c->validity.len;
+        if (c->type == ARROW_UTF8 || c->type == ARROW_BINARY)
+        {
+            a->buffers[a->buffer_count] = c->offsets.data;
+            a->lens[a->buffer_count++] = c->offsets.len;
+        }
+        a->buffers[a->buffer_count] = c->values.data;
+        a->lens[a->buffer_count++] = c->values.len;
+    }
+
+    struct fb b = { 0 };
+    int64_t body_len = 0;
+    uint32_t header = arrow_record_batch(&b, arrays, w->count, w->rows, &body_len);
+    int ok = arrow_message(w, &b, ARROW_HEADER_RECORD_BATCH, header, body_len, arrays, w->count,
+            &w->batch_blocks, &w->batch_block_count);
+    free(b.buf);
+
+    w->rows = 0;
+    for (int i = 0; i < w->count; ++i)
+        if (!arrow_column_reset(&w->columns[i]))
+            return (snprintf(w->error, sizeof(w->error), "out of memory"), 0);
+    return ok;
+}
+
+// stop the parse with `code`, EMIT keeps an error the visitor set
+static int arrow_fail(struct arrow_writer* w, int code, const char* message)
+{
+    w->ctx->error = code;
+    snprintf(w->ctx->error_message, sizeof(w->ctx->error_message), "Error: %.100s", message);
+    return 0;
+}
+
+#define ARROW_PUSH(buffer, data, len)\
+{\
+    if (!buffer_push((buffer), (data), (len)))\
+        return arrow_fail(w, XD_ERR_MEMORY, "out of memory building an Arrow column");\
+}
+
+static int column_fixed(struct arrow_writer* w, struct arrow_column* c, const void* data)
+{
+    ARROW_PUSH(&c->values, data, c->width);
+    c->filled = 1;
+    return 1;
+}
+
+static int column_int(struct arrow_writer* w, struct arrow_column* c, uint64_t value)
+{
+    uint8_t u8 = value;
+    uint16_t u16 = value;
+    uint32_t u32 = value;
+    const void* data = (c->width == 1 ? (void*)&u8 : c->width == 2 ? (void*)&u16 :
+                        c->width == 4 ? (void*)&u32 : (void*)&value);
+    return column_fixed(w, c, data);
+}
+
+static int column_bytes(struct arrow_writer* w, struct arrow_column* c, const void* data, size_t len)
+{
+    if (c->values.len + len > INT32_MAX)
+        return arrow_fail(w, XD_ERR_OVERSIZE, "Arrow column over 2GB in one batch, use fewer rows per batch");
+    ARROW_PUSH(&c->values, data, len);
+    int32_t end = (int32_t)c->values.len;
+    ARROW_PUSH(&c->offsets, &end, sizeof(end));
+    c->filled = 1;
+    return 1;
+}
+
+static int column_entry(struct arrow_writer* w, struct arrow_column* c, int entry)
+{
+    if (entry < 0)
+        return arrow_fail(w, XD_ERR_MEMORY, "out of memory building an Arrow dictionary");
+    int32_t index = entry;
+    ARROW_PUSH(&c->values, &index, sizeof(index));
+    c->filled = 1;
+    return 1;
+}
+
+static int column_address(struct arrow_writer* w, struct arrow_column* c, const uint8_t* id)
+{
+    if (!id)
+        return column_bytes(w, c, "", 0);
+    size_t len = 0;
+    const char* address = xd_address(w->ctx, id, &len);
+    if (!address)
+        return arrow_fail(w, XD_ERR_ENCODE, "could not base58 encode");
+    return column_bytes(w, c, address, len - 1);
+}
+
+// take back a failed object's values
+static void column_rollback(struct arrow_column* c)
+{
+    if (!c->filled)
+        return;
+    if (c->type == ARROW_UTF8 || c->type == ARROW_BINARY)
+    {
+        c->offsets.len -= sizeof(int32_t);
+        c->values.len = ((const int32_t*)c->offsets.data)[c->offsets.len / sizeof(int32_t) - 1];
+    }
+    else
+        c->values.len -= (c->type == ARROW_DICTIONARY ? (int)sizeof(int32_t) : c->width);
+    c->filled = 0;
+}
+
+static int arrow_begin(void* user, const struct xd_field* field)
+{
+    struct arrow_writer* w = user;
+    if (field)
+        w->depth++;
+    return 1;
+}
+
+static int arrow_end(void* user)
+{
+    struct arrow_writer* w = user;
+    w->depth--;
+    return 1;
+}
+
+// columns are only matched against top level fields, the first of a repeated field wins
+#define FOR_COLUMNS(field)\
+    if (w->depth > 0)\
+        return 1;\
+    for (struct arrow_column* c = w->columns; c < w->columns + w->count; ++c)\
+        if (c->field_id == (field)->field_id && !c->filled)
+
+static int arrow_integer(void* user, const struct xd_field* field, uint64_t value)
+{
+    struct arrow_writer* w = user;
+    FOR_COLUMNS(field)
+    {
+        if (c->type != ARROW_DICTIONARY)
+        {
+            if (!column_int(w, c, value))
+                return 0;
+        }
+        else if (value < 256 && c->dictionary->codes[value] >= 0 &&
+                !column_entry(w, c, c->dictionary->codes[value]))
+            return 0;
+    }
+    return 1;
+}
+
+static int arrow_hash(void* user, const struct xd_field* field, const uint8_t* bytes, int len)
+{
+    struct arrow_writer* w = user;
+    FOR_COLUMNS(field)
+        if (len == c->width && !column_fixed(w, c, bytes))
+            return 0;
+    return 1;
+}
+
+static int arrow_blob(void* user, const struct xd_field* field, const uint8_t* bytes, int len)
+{
+    struct arrow_writer* w = user;
+    FOR_COLUMNS(field)
+        if (!column_bytes(w, c, bytes, len))
+            return 0;
+    return 1;
+}
+
+static int arrow_account(void* user, const struct xd_field* field, const uint8_t* id)
+{
+    struct arrow_writer* w = user;
+    FOR_COLUMNS(field)
+        if (!column_address(w, c, id))
+            return 0;
+    return 1;
+}
+
+static int arrow_amount(void* user, const struct xd_field* field, const struct xd_amount* amount)
+{
+    static const uint8_t xrp[20];
+    struct arrow_writer* w = user;
+    FOR_COLUMNS(field)
+    {
+        int ok = 1;
+        if (c->part == ARROW_VALUE)
+        {
+            char value[XD_AMOUNT_VALUE_SIZE];
+            ok = column_bytes(w, c, value, xd_amount_value(value, amount));
+        }
+        else if (c->part == ARROW_CURRENCY)
+            ok = column_entry(w, c, dictionary_currency(c->dictionary, amount->native ? xrp : amount->currency));
+        else if (c->part == ARROW_ISSUER && !amount->native)
+            ok = column_address(w, c, amount->issuer);
+        else if (c->part == ARROW_DROPS && amount->native)
+            ok = column_int(w, c, (amount->negative ? -(int64_t)amount->mantissa : (int64_t)amount->mantissa));
+        if (!ok)
+            return 0;
+    }
+    return 1;
+}
+
+static const struct xd_visitor arrow_visitor =
+{
+    .begin_object = arrow_begin,
+    .end_object = arrow_end,
+    .begin_array = arrow_begin,
+    .end_array = arrow_end,
+    .integer = arrow_integer,
+    .hash = arrow_hash,
+    .account = arrow_account,
+    .amount = arrow_amount,
+    .blob = arrow_blob
+};
+
+// nulls for the columns the object didn't have, then the row's validity bits
+static int arrow_row(struct arrow_writer* w)
+{
+    struct xd_ctx* ctx = w->ctx;
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct arrow_column* c = &w->columns[i];
+        if (c->field_id == 0 && (ctx->flags & XD_TXID) && !column_fixed(w, c, ctx->txid))
+            return ctx->error;
+
+        if (!c->filled)
+        {
+            int ok = 1;
+            if (c->type == ARROW_UTF8 || c->type == ARROW_BINARY)
+                ok = buffer_int32(&c->offsets, (int32_t)c->values.len);
+            else
+                ok = buffer_push(&c->values, zeros, (c->type == ARROW_DICTIONARY ? (int)sizeof(int32_t) : c->width));
+            if (!ok)
+                return (arrow_fail(w, XD_ERR_MEMORY, "out of memory building an Arrow column"), ctx->error);
+            c->null_count++;
+        }
+
+        if (w->rows % 8 == 0 && !buffer_push(&c->validity, zeros, 1))
+            return (arrow_fail(w, XD_ERR_MEMORY, "out of memory building an Arrow column"), ctx->error);
+        c->validity.data[w->rows / 8] |= (uint8_t)(c->filled << (w->rows % 8U));
+        c->filled = 0;
+    }
+
+    if (++w->rows >= w->batch_rows && !arrow_flush(w))
+        return (arrow_fail(w, XD_ERR_OUTPUT, w->error), ctx->error);
+    return XD_OK;
+}
+
+// shared by both arrow_append forms
+static int arrow_finish_row(struct arrow_writer* w, const struct xd_projection* saved, int error)
+{
+    w->ctx->projection = saved;
+    if (error == XD_OK)
+        return arrow_row(w);
+    for (int i = 0; i < w->count; ++i)
+        column_rollback(&w->columns[i]);
+    return error;
+}
+
+int arrow_append(struct arrow_writer* w, struct xd_ctx* ctx, const uint8_t* input, size_t input_len)
+{
+    const struct xd_projection* saved = ctx->projection;
+    w->ctx = ctx;
+    w->depth = 0;
+    ctx->projection = (w->projection.count > 0 ? &w->projection : saved);
+    return arrow_finish_row(w, saved, xd_visit(ctx, input, input_len, &arrow_visitor, w));
+}
+
+int arrow_append_stream(struct arrow_writer* w, struct xd_ctx* ctx, xd_fetch fetch, void* user)
+{
+    const struct xd_projection* saved = ctx->projection;
+    w->ctx = ctx;
+    w->depth = 0;
+    ctx->projection = (w->projection.count > 0 ? &w->projection : saved);
+    return arrow_finish_row(w, saved, xd_visit_stream(ctx, fetch, user, &arrow_visitor, w));
+}
+
+static struct arrow_column* arrow_add_column(struct arrow_writer* w, const char* name, int name_len,
+        const char* suffix, uint32_t field_id, int part, int type, int width)
+{
+    if (w->count >= ARROW_COLUMNS)
+        return (snprintf(w->error, sizeof(w->error), "more than %d columns", ARROW_COLUMNS), (void*)0);
+    if (name_len + strlen(suffix) >= ARROW_NAME_SIZE)
+        return (snprintf(w->error, sizeof(w->error), "column name `%.*s` too long", name_len, name), (void*)0);
+
+    struct arrow_column* c = &w->columns[w->count++];
+    snprintf(c->name, sizeof(c->name), "%.*s%s", name_len, name, suffix);
+    c->field_id = field_id;
+    c->part = part;
+    c->type = type;
+    c->width = width;
+    c->is_signed = (part == ARROW_DROPS);
+    if (type == ARROW_DICTIONARY)
+    {
+        if (!(c->dictionary = calloc(1, sizeof(*c->dictionary))))
+            return (snprintf(w->error, sizeof(w->error), "out of memory"), (void*)0);
+        memset(c->dictionary->codes, 0xFF, sizeof(c->dictionary->codes));
+    }
+    if (!arrow_column_reset(c))
+        return (snprintf(w->error, sizeof(w->error), "out of memory"), (void*)0);
+    return c;
+}
+
+// a dictionary of the names in one of the definitions' code tables, known in full before the first row
+static int arrow_named_codes(struct arrow_writer* w, struct arrow_column* c, const struct definitions_name* table)
+{
+    for (int code = 0; code < 256; ++code)
+    {
+        if (!table[code].offset)
+            continue;
+        // stored as `"Name"`
+        int entry = dictionary_add(c->dictionary, DEFINITIONS_STR(w->definitions, table[code]) + 1,
+                table[code].len - 2);
+        if (entry < 0)
+            return (snprintf(w->error, sizeof(w->error), "out of memory"), 0);
+        c->dictionary->codes[code] = entry;
+    }
+    return 1;
+}
+
+// one comma separated column: a field name, an amount's name followed by .value, .currency, .issuer or .drops,
+// or hash for the transaction ID
+static int arrow_compile_column(struct arrow_writer* w, const char* column, int len)
+{
+    const struct definitions* definitions = w->definitions;
+    const char* dot = memchr(column, '.', len);
+    int name_len = (dot ? dot - column : len);
+
+    if (len == 4 && memcmp(column, "hash", 4) == 0)
+        return arrow_add_column(w, column, len, "", 0, ARROW_WHOLE, ARROW_FIXED, 32) != 0;
+
+    uint32_t field_id = definitions_field_id(definitions, column, name_len);
+    if (!field_id)
+        return (snprintf(w->error, sizeof(w->error), "unknown field `%.*s`", name_len, column), 0);
+
+    int type_code = field_id >> 16U;
+    int field_code = field_id & 0xFFFFU;
+    int kind = definitions->type_kind[type_code];
+    int size = definitions->type_size[type_code];
+
+    if (kind == KIND_AMOUNT)
+    {
+        static const char* parts[] = { "", ".value", ".currency", ".issuer", ".drops" };
+        static const int types[] = { 0, ARROW_UTF8, ARROW_DICTIONARY, ARROW_UTF8, ARROW_INT };
+        int part = ARROW_WHOLE;
+        for (int i = ARROW_VALUE; dot && i <= ARROW_DROPS; ++i)
+            if ((int)strlen(parts[i]) == len - name_len && memcmp(parts[i], dot, len - name_len) == 0)
+                part = i;
+        if (dot && part == ARROW_WHOLE)
+            return (snprintf(w->error, sizeof(w->error), "`%.*s` is not .value, .currency, .issuer or .drops",
+                    len, column), 0);
+
+        // the whole amount is its value, currency and issuer
+        for (int i = ARROW_VALUE; i <= ARROW_ISSUER; ++i)
+            if ((part == ARROW_WHOLE || part == i) &&
+                    !arrow_add_column(w, column, name_len, parts[i], field_id, i, types[i], 0))
+                return 0;
+        if (part == ARROW_DROPS && !arrow_add_column(w, column, name_len, parts[part], field_id, part, ARROW_INT, 8))
+            return 0;
+        return 1;
+    }
+
+    if (dot)
+        return (snprintf(w->error, sizeof(w->error), "`%.*s` is not an amount", name_len, column), 0);
+
+    if (kind == KIND_UINT && type_code == 1 && field_code == 2)
+    {
+        struct arrow_column* c = arrow_add_column(w, column, len, "", field_id, ARROW_WHOLE, ARROW_DICTIONARY, 0);
+        return c && arrow_named_codes(w, c, definitions->transaction_types);
+    }
+    if (kind == KIND_UINT && type_code == 1 && field_code == 1)
+    {
+        struct arrow_column* c = arrow_add_column(w, column, len, "", field_id, ARROW_WHOLE, ARROW_DICTIONARY, 0);
+        return c && arrow_named_codes(w, c, definitions->ledger_entry_types);
+    }
+    if (kind == KIND_UINT && type_code == 16 && field_code == 3)
+    {
+        struct arrow_column* c = arrow_add_column(w, column, len, "", field_id, ARROW_WHOLE, ARROW_DICTIONARY, 0);
+        return c && arrow_named_codes(w, c, definitions->transaction_results);
+    }
+
+    if (kind == KIND_UINT && (size == 1 || size == 2 || size == 4 || size == 8))
+        return arrow_add_column(w, column, len, "", field_id, ARROW_WHOLE, ARROW_INT, size) != 0;
+    if (kind == KIND_UINT || kind == KIND_HASH)
+        return arrow_add_column(w, column, len, "", field_id, ARROW_WHOLE, ARROW_FIXED, size) != 0;
+    if (kind == KIND_BLOB || kind == KIND_VECTOR256)
+        return arrow_add_column(w, column, len, "", field_id, ARROW_WHOLE, ARROW_BINARY, 0) != 0;
+    if (kind == KIND_ACCOUNT)
+        return arrow_add_column(w, column, len, "", field_id, ARROW_WHOLE, ARROW_UTF8, 0) != 0;
+
+    return (snprintf(w->error, sizeof(w->error), "`%.*s` is an object, array or pathset", len, column), 0);
+}
+
+int arrow_open(struct arrow_writer* w, const struct definitions* definitions, const char* columns,
+        int fd, int batch_rows)
+{
+    memset(w, 0, sizeof(*w));
+    w->definitions = definitions;
+    w->fd = fd;
+    w->batch_rows = (batch_rows > 0 ? batch_rows : ARROW_BATCH_ROWS);
+    if (!columns)
+        columns = ARROW_DEFAULT_COLUMNS;
+
+    // the decoder is given the columns' fields as a projection
+    char fields[1024];
+    int fields_len = 0;
+    int fields_full = 0;
+    for (const char* column = columns; *column;)
+    {
+        int len = strcspn(column, ",");
+        if (len > 0 && !arrow_compile_column(w, column, len))
+            return 0;
+        int name_len = strcspn(column, ".,");
+        if (len > 0 && !(len == 4 && memcmp(column, "hash", 4) == 0))
+        {
+            if (fields_len + name_len + 2 > (int)sizeof(fields))
+                fields_full = 1;
+            else
+                fields_len += sprintf(fields + fields_len, "%s%.*s", (fields_len ? "," : ""), name_len, column);
+        }
+        column += len + (column[len] == ',');
+    }
+    if (w->count == 0)
+        return (snprintf(w->error, sizeof(w->error), "no columns"), 0);
+    // too many to project, everything is decoded instead
+    if (fields_full || fields_len == 0 || xd_projection_compile(&w->projection, definitions, fields) != XD_OK)
+        w->projection.count = 0;
+
+    if (!(w->write_buffer = malloc(ARROW_WRITE_BUFFER_SIZE)))
+        return (snprintf(w->error, sizeof(w->error), "out of memory"), 0);
+
+    struct fb b = { 0 };
+    uint32_t schema = arrow_schema(w, &b);
+    int ok = arrow_write(w, "ARROW1\0\0", 8) &&
+             arrow_message(w, &b, ARROW_HEADER_SCHEMA, schema, 0, 0, 0, 0, 0);
+    free(b.buf);
+    if (!ok && !w->error[0])
+        snprintf(w->error, sizeof(w->error), "output could not be written");
+    return ok;
+}
+
+int arrow_close(struct arrow_writer* w)
+{
+    // a file with no rows still gets one (empty) batch, so every dictionary is written
+    int ok = ((w->rows == 0 && w->batch_block_count > 0) || arrow_flush(w));
+
+    // the end of stream marker, then the footer and its length
+    static const uint8_t end_of_stream[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 };
+    struct fb b = { 0 };
+    if (ok)
+    {
+        uint32_t batches = fb_structs(&b, w->batch_blocks, w->batch_block_count, 3);
+        uint32_t dictionaries = fb_structs(&b, w->dictionary_blocks, w->dictionary_block_count, 3);
+        uint32_t schema = arrow_schema(w, &b);
+        fb_table(&b);
+        fb_add_scalar(&b, 0, ARROW_METADATA_V5, 2);
+        fb_add_offset(&b, 1, schema);
+        fb_add_offset(&b, 2, dictionaries);
+        fb_add_offset(&b, 3, batches);
+        fb_finish(&b, fb_end(&b));
+
+        uint8_t footer_len[4] = { (uint8_t)b.used, (uint8_t)(b.used >> 8U), (uint8_t)(b.used >> 16U),
+            (uint8_t)(b.used >> 24U) };
+        ok = !b.failed &&
+             arrow_write(w, end_of_stream, 8) &&
+             arrow_write(w, b.buf + b.capacity - b.used, b.used) &&
+             arrow_write(w, footer_len, 4) &&
+             arrow_write(w, "ARROW1", 6) &&
+             arrow_flush_output(w);
+        if (!ok)
+            snprintf(w->error, sizeof(w->error), "output could not be written");
+    }
+    free(b.buf);
+
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct arrow_column* c = &w->columns[i];
+        free(c->validity.data);
+        free(c->offsets.data);
+        free(c->values.data);
+        if (c->dictionary)
+        {
+            free(c->dictionary->offsets.data);
+            free(c->dictionary->values.data);
+            free(c->dictionary->currencies);
+            free(c->dictionary);
+        }
+    }
+    free(w->dictionary_blocks);
+    free(w->batch_blocks);
+    free(w->write_buffer);
+    w->count = 0;
+    return ok;
+}
@@ -0,0 +1,122 @@
+#ifndef ARROW_H
+#define ARROW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "definitions.h"
+#include "xd.h"
+
+/**
+ * Apache Arrow IPC file output, written without the Arrow library
+ * Each object becomes a row. Each column is a top level field, its Arrow type comes from the field's type in the
+ * definitions:
+ *  - UInts are unsigned integers of their width, and TransactionType, LedgerEntryType and TransactionResult are
+ *    dictionary encoded from the definitions' names;
+ *  - hashes are fixed size binary, blobs and Vector256s binary, AccountIDs utf8 r-addresses;
+ *  - an amount is split into Name.value (utf8), Name.currency (dictionary encoded) and Name.issuer (utf8), and
+ *    Name.drops is an int64 that is only set for XRP;
+ *  - "hash" is the transaction ID when the context has XD_TXID.
+ * A field missing from an object is null. Rows are written out as a record batch every `batch_rows` objects.
+ */
+#define ARROW_COLUMNS 64            // most columns one writer holds
+#define ARROW_NAME_SIZE 64          // longest column name
+#define ARROW_BATCH_ROWS 65536      // default rows per record batch
+#define ARROW_WRITE_BUFFER_SIZE (256*1024)
+
+#define ARROW_DEFAULT_COLUMNS "TransactionType,Account,Destination,Fee.drops,Sequence,Flags,SourceTag,"\
+    "DestinationTag,LastLedgerSequence,Amount,SendMax,DeliverMin,TakerPays,TakerGets,OfferSequence,"\
+    "TransactionResult,TransactionIndex,DeliveredAmount"
+
+enum arrow_part
+{
+    ARROW_WHOLE = 0,
+    ARROW_VALUE,        // an amount's decimal value
+    ARROW_CURRENCY,
+    ARROW_ISSUER,
+    ARROW_DROPS         // an XRP amount in drops
+};
+
+// how a column is stored
+enum arrow_type
+{
+    ARROW_INT = 0,
+    ARROW_FIXED,        // fixed size binary
+    ARROW_UTF8,
+    ARROW_BINARY,
+    ARROW_DICTIONARY    // int32 indices into utf8 strings
+};
+
+struct arrow_buffer
+{
+    uint8_t* data;
+    size_t len;
+    size_t capacity;
+};
+
+// strings a dictionary column's indices refer to, append only so earlier batches stay valid
+struct arrow_dictionary
+{
+    struct arrow_buffer offsets;    // int32, count + 1 of them
+    struct arrow_buffer values;
+    int count;
+    int written;                    // entries already in the file, the next dictionary batch is a delta from here
+    int16_t codes[256];             // named codes: code -> entry, -1 for a code without a name
+    uint8_t* currencies;            // currencies: open addressed table of 20 byte code + int32 entry
+    int currency_slots;
+};
+
+struct arrow_column
+{
+    char name[ARROW_NAME_SIZE];
+    uint32_t field_id;              // 0 for the transaction ID
+    int part;                       // enum arrow_part, which piece of an amount
+    int type;                       // enum arrow_type, how it is stored
+    int width;                      // bytes per value of fixed width types
+    int is_signed;
+    struct arrow_dictionary* dictionary;
+    struct arrow_buffer validity;
+    struct arrow_buffer offsets;    // int32 for utf8 and binary
+    struct arrow_buffer values;
+    int null_count;
+    int filled;                     // has a value in the current row
+};
+
+struct arrow_writer
+{
+    const struct definitions* definitions;
+    struct xd_ctx* ctx;             // of the object being decoded
+    struct xd_projection projection;
+    int fd;
+    int batch_rows;
+    int rows;                       // in the current batch
+    int depth;
+    int count;
+    struct arrow_column columns[ARROW_COLUMNS];
+
+    uint64_t offset;                // bytes written to fd so far
+    int64_t* dictionary_blocks;     // offset, metadata length and body length of each message, for the footer
+    int dictionary_block_count;
+    int64_t* batch_blocks;
+    int batch_block_count;
+    uint8_t* write_buffer;
+    int write_len;
+    char error[128];
+};
+
+// compile `columns` (null for ARROW_DEFAULT_COLUMNS) and write the file header and schema to `fd`
+// returns 1 on success, 0 with `error` set
+int arrow_open(struct arrow_writer* writer, const struct definitions* definitions, const char* columns,
+        int fd, int batch_rows);
+
+// decode one object into a row, returns an XD_* code and a failed object leaves no row behind.
+// Only the columns' fields are decoded, the context's own projection is put back afterwards
+int arrow_append(struct arrow_writer* writer, struct xd_ctx* ctx, const uint8_t* input, size_t input_len);
+
+// the same, reading the object through `fetch`
+int arrow_append_stream(struct arrow_writer* writer, struct xd_ctx* ctx, xd_fetch fetch, void* user);
+
+// write the last batch and the footer then release the writer, returns 1 on success, 0 with `error` set
+int arrow_close(struct arrow_writer* writer);
+
+#endif
@@ -17,18 +17,22 @@
 #include <string.h>
 
 #include "libbase58.h"
+#include "sha-256.h"
 
 bool (*b58_sha256_impl)(void *, const void *, size_t) = NULL;
 
+// XRPL alphabet, the zero digit is 'r'
+static const char b58digits_ordered[] = "rpshnaf39wBUDNEGHJKLM4PQRST7VWXYZ2bcdeCg65jkm8oFqi1tuvAxyz";
+
 static const int8_t b58digits_map[] = {
 	-1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
 	-1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
 	-1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
-	-1, 0, 1, 2, 3, 4, 5, 6,  7, 8,-1,-1,-1,-1,-1,-1,
-	-1, 9,10,11,12,13,14,15, 16,-1,17,18,19,20,21,-1,
-	22,23,24,25,26,27,28,29, 30,31,32,-1,-1,-1,-1,-1,
-	-1,33,34,35,36,37,38,39, 40,41,42,43,-1,44,45,46,
-	47,48,49,50,51,52,53,54, 55,56,57,-1,-1,-1,-1,-1,
+	-1,50,33, 7,21,41,40,27, 45, 8,-1,-1,-1,-1,-1,-1,
+	-1,54,10,38,12,14,47,15, 16,-1,17,18,19,20,13,-1,
+	22,23,24,25,26,11,28,29, 30,31,32,-1,-1,-1,-1,-1,
+	-1, 5,34,35,36,37, 6,39,  3,49,42,43,-1,44, 4,46,
+	 1,48, 0, 2,51,52,53, 9, 55,56,57,-1,-1,-1,-1,-1,
 };
 
 typedef uint64_t b58_maxint_t;
@@ -58,7 +62,7 @@ bool b58tobin(void *bin, size_t *binszp, const char *b58, size_t b58sz)
 	}
 	
 	// Leading zeros, just count
-	for (i = 0; i < b58sz && b58u[i] == '1'; ++i)
+	for (i = 0; i < b58sz && b58u[i] == b58digits_ordered[0]; ++i)
 		++zerocount;
 	
 	for ( ; i < b58sz; ++i)
@@ -132,16 +136,14 @@ int b58check(const void *bin, size_t binsz, const char *base58str, size_t b58sz)
 		return -1;
 	
 	// Check number of zeros is correct AFTER verifying checksum (to avoid possibility of accessing base58str beyond the end)
-	for (i = 0; binc[i] == '\0' && base58str[i] == '1'; ++i)
+	for (i = 0; binc[i] == '\0' && base58str[i] == b58digits_ordered[0]; ++i)
 	{}  // Just finding the end of zeros, nothing to do in loop
-	if (binc[i] == '\0' || base58str[i] == '1')
+	if (binc[i] == '\0' || base58str[i] == b58digits_ordered[0])
 		return -3;
 	
 	return binc[0];
 }
 
-static const char b58digits_ordered[] = "rpshnaf39wBUDNEGHJKLM4PQRST7VWXYZ2bcdeCg65jkm8oFqi1tuvAxyz";
-
 bool b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz)
 {
 	const uint8_t *bin = data;
@@ -179,7 +181,7 @@ bool b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz)
 	}
 	
 	if (zcount)
-		memset(b58, '1', zcount);
+		memset(b58, b58digits_ordered[0], zcount);
 	for (i = zcount; j < size; ++i, ++j)
 		b58[i] = b58digits_ordered[buf[j]];
 	b58[i] = '\0';
@@ -203,3 +205,186 @@ bool b58check_enc(char *b58c, size_t *b58c_sz, uint8_t ver, const void *data, si
 	
 	return b58enc(b58c, b58c_sz, buf, 1 + datasz + 4);
 }
+
+/*
+ * Fixed width encoder for 25 byte account payloads (version, 20 byte AccountID, 4 byte checksum).
+ * The 200 bit number is held in 32 bit limbs and divided by 58^5 per pass (a 64 bit division by a
+ * constant, which compiles to a multiply), yielding five base58 digits per pass instead of one.
+ */
+#define B58_POW5 656356768U /* 58^5 */
+#define B58_ACCOUNT_LIMBS 7
+#define B58_ACCOUNT_DIGITS 35 /* 58^35 > 2^200 */
+
+static size_t b58enc_25_digits(char *b58, const uint8_t *bin)
+{
+	uint32_t limb[B58_ACCOUNT_LIMBS];
+	uint8_t digits[B58_ACCOUNT_DIGITS];
+	size_t i, j, top, zcount = 0;
+
+	limb[0] = bin[0];
+	for (i = 1; i < B58_ACCOUNT_LIMBS; ++i)
+		limb[i] = (uint32_t)bin[i * 4 - 3] << 24 | (uint32_t)bin[i * 4 - 2] << 16 |
+			(uint32_t)bin[i * 4 - 1] << 8 | bin[i * 4];
+
+	for (top = 0; top < B58_ACCOUNT_LIMBS && !limb[top]; ++top);
+
+	for (j = B58_ACCOUNT_DIGITS; j > 0; j -= 5)
+	{
+		uint64_t r = 0;
+		for (i = top; i < B58_ACCOUNT_LIMBS; ++i)
+		{
+			uint64_t cur = r << 32 | limb[i];
+			limb[i] = cur / B58_POW5;
+			r = cur % B58_POW5;
+		}
+		for (; top < B58_ACCOUNT_LIMBS && !limb[top]; ++top);
+
+		uint32_t group = r;
+		for (i = 1; i <= 5; ++i)
+		{
+			digits[j - i] = group % 58;
+			group /= 58;
+		}
+	}
+
+	while (zcount < 25 && !bin[zcount])
+		++zcount;
+	for (j = 0; j < B58_ACCOUNT_DIGITS && !digits[j]; ++j);
+
+	if (zcount)
+		memset(b58, b58digits_ordered[0], zcount);
+	for (i = zcount; j < B58_ACCOUNT_DIGITS; ++i, ++j)
+		b58[i] = b58digits_ordered[digits[j]];
+	b58[i] = '\0';
+
+	return i + 1;
+}
+
+bool b58enc_25(char *b58, size_t *b58sz, const void *data)
+{
+	char buf[B58_ACCOUNT_SIZE];
+	size_t size = b58enc_25_digits(buf, data);
+
+	if (*b58sz < size)
+	{
+		*b58sz = size;
+		return false;
+	}
+
+	memcpy(b58, buf, size);
+	*b58sz = size;
+	return true;
+}
+
+bool b58check_enc_account(char *b58c, size_t *b58c_sz, uint8_t ver, const void *data)
+{
+	uint8_t buf[1 + 20 + 0x20];
+
+	buf[0] = ver;
+	memcpy(&buf[1], data, 20);
+	sha256d_21(&buf[21], buf);
+
+	return b58enc_25(b58c, b58c_sz, buf);
+}
+
+/*
+ * Batch variant, B58_LANES payloads are converted side by side with their limbs laid out
+ * lane-minor. The lanes' divisions are independent so they overlap in the pipeline; 64 bit
+ * multiply-high has no AVX2 form, and a 32 bit SIMD formulation (14 bit limbs, divisor 58^3)
+ * needs enough extra passes that it measured slower than this.
+ */
+#define B58_LANES 8
+
+static void b58enc_25_lanes(uint32_t groups[B58_ACCOUNT_LIMBS][B58_LANES],
+	uint32_t limb[B58_ACCOUNT_LIMBS][B58_LANES])
+{
+	size_t i, g, l;
+
+	for (g = B58_ACCOUNT_LIMBS; g > 0; --g)
+	{
+		uint64_t r[B58_LANES] = { 0 };
+		for (i = 0; i < B58_ACCOUNT_LIMBS; ++i)
+		{
+			for (l = 0; l < B58_LANES; ++l)
+			{
+				uint64_t cur = r[l] << 32 | limb[i][l];
+				limb[i][l] = cur / B58_POW5;
+				r[l] = cur % B58_POW5;
+			}
+		}
+		for (l = 0; l < B58_LANES; ++l)
+			groups[g - 1][l] = r[l];
+	}
+}
+
+bool b58check_enc_account_batch(char *b58c, size_t *b58c_sz, uint8_t ver, const void *data, size_t count)
+{
+	const uint8_t *ids = data;
+	size_t n, i, j, k, l;
+
+	for (n = 0; n < count; n += B58_LANES)
+	{
+		uint8_t payload[B58_LANES][25];
+		uint8_t versioned[B58_LANES][21];
+		uint8_t checksums[B58_LANES][0x20];
+		uint32_t limb[B58_ACCOUNT_LIMBS][B58_LANES];
+		uint32_t groups[B58_ACCOUNT_LIMBS][B58_LANES];
+		size_t lanes = (count - n < B58_LANES ? count - n : B58_LANES);
+
+		memset(versioned, 0, sizeof(versioned));
+		for (l = 0; l < lanes; ++l)
+		{
+			versioned[l][0] = ver;
+			memcpy(&versioned[l][1], &ids[(n + l) * 20], 20);
+		}
+
+		sha256d_21_x8(checksums, versioned);
+
+		for (l = 0; l < B58_LANES; ++l)
+		{
+			memcpy(payload[l], versioned[l], 21);
+			memcpy(&payload[l][21], checksums[l], 4);
+		}
+
+		for (l = 0; l < B58_LANES; ++l)
+		{
+			const uint8_t *bin = payload[l];
+			limb[0][l] = bin[0];
+			for (i = 1; i < B58_ACCOUNT_LIMBS; ++i)
+				limb[i][l] = (uint32_t)bin[i * 4 - 3] << 24 | (uint32_t)bin[i * 4 - 2] << 16 |
+					(uint32_t)bin[i * 4 - 1] << 8 | bin[i * 4];
+		}
+
+		b58enc_25_lanes(groups, limb);
+
+		for (l = 0; l < lanes; ++l)
+		{
+			uint8_t digits[B58_ACCOUNT_DIGITS];
+			char *out = b58c + (n + l) * B58_ACCOUNT_SIZE;
+			size_t zcount = 0;
+
+			for (i = 0; i < B58_ACCOUNT_LIMBS; ++i)
+			{
+				uint32_t group = groups[i][l];
+				for (j = 5; j > 0; --j)
+				{
+					digits[i * 5 + j - 1] = group % 58;
+					group /= 58;
+				}
+			}
+
+			while (zcount < 25 && !payload[l][zcount])
+				++zcount;
+			for (j = 0; j < B58_ACCOUNT_DIGITS && !digits[j]; ++j);
+
+			if (zcount)
+				memset(out, b58digits_ordered[0], zcount);
+			for (k = zcount; j < B58_ACCOUNT_DIGITS; ++k, ++j)
+				out[k] = b58digits_ordered[digits[j]];
+			out[k] = '\0';
+			b58c_sz[n + l] = k + 1;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * base58 account encoding benchmark
+ * Checks b58check_enc_account() and b58check_enc_account_batch() against b58check_enc()
+ * on random AccountIDs, then times all three
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../libbase58.h"
+#include "../sha-256.h"
+
+#define COUNT (1024*1024)
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    b58_sha256_impl = calc_sha_256;
+
+    uint8_t* ids = malloc(COUNT * 20);
+    char* out = malloc(COUNT * B58_ACCOUNT_SIZE);
+    size_t* out_sz = malloc(COUNT * sizeof(size_t));
+
+    srand(1);
+    for (int i = 0; i < COUNT * 20; ++i)
+        ids[i] = rand();
+
+    // leading zero bytes exercise the zero prefix handling
+    memset(ids, 0, 20);
+    memset(ids + 20, 0, 3);
+
+    if (!b58check_enc_account_batch(out, out_sz, 0, ids, COUNT))
+        return fprintf(stderr, "batch encode failed\n");
+
+    for (int i = 0; i < COUNT; ++i)
+    {
+        char a[64], b[64];
+        size_t a_sz = sizeof(a), b_sz = sizeof(b);
+        if (!b58check_enc(a, &a_sz, 0, ids + i * 20, 20) ||
+            !b58check_enc_account(b, &b_sz, 0, ids + i * 20) ||
+            a_sz != b_sz || strcmp(a, b) != 0 ||
+            a_sz != out_sz[i] || strcmp(a, out + i * B58_ACCOUNT_SIZE) != 0)
+            return fprintf(stderr, "mismatch at %d: %s %s %s\n", i, a, b, out + i * B58_ACCOUNT_SIZE);
+    }
+    printf("%d AccountIDs bit-exact\n", COUNT);
+
+    double t = now();
+    for (int i = 0; i < COUNT; ++i)
+    {
+        out_sz[i] = B58_ACCOUNT_SIZE;
+        b58check_enc(out + i * B58_ACCOUNT_SIZE, &out_sz[i], 0, ids + i * 20, 20);
+    }
+    double generic = (now() - t) * 1e9 / COUNT;
+
+    t = now();
+    for (int i = 0; i < COUNT; ++i)
+    {
+        out_sz[i] = B58_ACCOUNT_SIZE;
+        b58check_enc_account(out + i * B58_ACCOUNT_SIZE, &out_sz[i], 0, ids + i * 20);
+    }
+    double fixed = (now() - t) * 1e9 / COUNT;
+
+    t = now();
+    b58check_enc_account_batch(out, out_sz, 0, ids, COUNT);
+    double batch = (now() - t) * 1e9 / COUNT;
+
+    // the conversion alone, without the checksum hashing
+    uint8_t* payloads = malloc(COUNT * 25);
+    for (int i = 0; i < COUNT; ++i)
+    {
+        payloads[i * 25] = 0;
+        memcpy(payloads + i * 25 + 1, ids + i * 20, 20);
+        memcpy(payloads + i * 25 + 21, ids + ((i + 1) % COUNT) * 20, 4);
+    }
+
+    t = now();
+    for (int i = 0; i < COUNT; ++i)
+    {
+        out_sz[i] = B58_ACCOUNT_SIZE;
+        b58enc(out + i * B58_ACCOUNT_SIZE, &out_sz[i], payloads + i * 25, 25);
+    }
+    double generic_enc = (now() - t) * 1e9 / COUNT;
+
+    t = now();
+    for (int i = 0; i < COUNT; ++i)
+    {
+        out_sz[i] = B58_ACCOUNT_SIZE;
+        b58enc_25(out + i * B58_ACCOUNT_SIZE, &out_sz[i], payloads + i * 25);
+    }
+    double fixed_enc = (now() - t) * 1e9 / COUNT;
+
+    printf("b58enc (25 bytes):          %7.1f ns/address\n", generic_enc);
+    printf("b58enc_25:                  %7.1f ns/address (%.2fx)\n", fixed_enc, generic_enc / fixed_enc);
+    printf("b58check_enc:               %7.1f ns/address\n", generic);
+    printf("b58check_enc_account:       %7.1f ns/address (%.2fx)\n", fixed, generic / fixed);
+    printf("b58check_enc_account_batch: %7.1f ns/address (%.2fx)\n", batch, generic / batch);
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * Shared by the benchmarks that link libxd: a clock, loading the objects of hex files and building a Payment of any
+ * size to decode
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../xd.h"
+#include "../hex.h"
+
+#define BENCH_MAX_OBJECTS (1024*1024)
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct bench_objects
+{
+    uint8_t** bytes;
+    size_t* lens;
+    int count;
+    size_t total;           // bytes in all of them
+};
+
+// each line of the files named in argv[1...] that is the hex of an object `ctx` decodes, 0 if a file won't open
+static int bench_load(struct bench_objects* objects, struct xd_ctx* ctx, int argc, char** argv)
+{
+    static char line[4*1024*1024];
+    static uint8_t binary[2*1024*1024];
+
+    objects->bytes = malloc(BENCH_MAX_OBJECTS * sizeof(uint8_t*));
+    objects->lens = malloc(BENCH_MAX_OBJECTS * sizeof(size_t));
+    objects->count = 0;
+    objects->total = 0;
+    for (int a = 1; a < argc; ++a)
+    {
+        FILE* f = fopen(argv[a], "r");
+        if (!f)
+        {
+            fprintf(stderr, "Could not open `%s`\n", argv[a]);
+            return 0;
+        }
+        while (objects->count < BENCH_MAX_OBJECTS && fgets(line, sizeof(line), f))
+        {
+            size_t len = strcspn(line, "\r\n");
+            int carry = -1;
+            int bytes = hex_decode(binary, (const uint8_t*)line, len, &carry);
+            if (bytes <= 0 || xd_decode(ctx, binary, bytes) != XD_OK)
+                continue;
+
+            objects->bytes[objects->count] = malloc(bytes);
+            memcpy(objects->bytes[objects->count], binary, bytes);
+            objects->lens[objects->count++] = bytes;
+            objects->total += bytes;
+        }
+        fclose(f);
+    }
+    return 1;
+}
+
+static void bench_free(struct bench_objects* objects)
+{
+    for (int i = 0; i < objects->count; ++i)
+        free(objects->bytes[i]);
+    free(objects->bytes);
+    free(objects->lens);
+}
+
+// a VL length prefix
+static uint8_t* put_vl(uint8_t* p, int len)
+{
+    if (len <= 192)
+        *p++ = len;
+    else if (len <= 12480)
+    {
+        *p++ = 193 + ((len - 193) >> 8U);
+        *p++ = (len - 193) & 0xFFU;
+    }
+    else
+    {
+        *p++ = 241 + ((len - 12481) >> 16U);
+        *p++ = ((len - 12481) >> 8U) & 0xFFU;
+        *p++ = (len - 12481) & 0xFFU;
+    }
+    return p;
+}
+
+// a Payment with `memos` memos of `data` random bytes each
+static uint8_t* build(int memos, int data, size_t* len)
+{
+    static const uint8_t head[] =
+    {
+        0x12, 0x00, 0x00,                                       // TransactionType Payment
+        0x68, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C,   // Fee 12
+        0x81, 0x14,                                             // Account
+        0xB5, 0xF7, 0x62, 0x79, 0x8A, 0x53, 0xD5, 0x43, 0xA0, 0x14,
+        0xCA, 0xF8, 0xB2, 0x97, 0xCF, 0xF8, 0xF2, 0xF9, 0x37, 0xE8,
+        0xF9                                                    // Memos
+    };
+    uint8_t* b = malloc(sizeof(head) + (size_t)memos * (data + 16) + 1);
+    memcpy(b, head, sizeof(head));
+    uint8_t* p = b + sizeof(head);
+    srand(memos);
+    for (int m = 0; m < memos; ++m)
+    {
+        *p++ = 0xEA;                                            // Memo
+        *p++ = 0x7C; *p++ = 4;                                  // MemoType
+        memcpy(p, "text", 4);
+        p += 4;
+        *p++ = 0x7D;                                            // MemoData
+        p = put_vl(p, data);
+        for (int i = 0; i < data; ++i)
+            *p++ = rand();
+        *p++ = 0xE1;
+    }
+    *p++ = 0xF1;
+    *len = p - b;
+    return b;
+}
+
+#endif
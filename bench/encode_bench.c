@@ -0,0 +1,69 @@
+/**
+ * JSON -> binary encoder benchmark
+ * Decodes each line of the hex files given to compact JSON, checks encode_json() gives back the same bytes, then
+ * times encoding all of them
+ */
+#include "bench.h"
+#include "../encode.h"
+
+#define ROUNDS_BYTES (256*1024*1024)   // encode about this much JSON in total
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        return fprintf(stderr, "Usage: %s file.hex ...\n", argv[0]);
+
+    static struct definitions definitions;
+    definitions_builtin(&definitions);
+
+    struct xd_ctx ctx;
+    xd_init(&ctx, &definitions, XD_COMPACT);
+    struct encoder encoder;
+    if (!encode_init(&encoder, &definitions))
+        return fprintf(stderr, "out of memory\n");
+
+    struct bench_objects objects;
+    if (!bench_load(&objects, &ctx, argc, argv))
+        return 1;
+
+    int count = objects.count;
+    char** jsons = malloc(count * sizeof(char*));
+    size_t* lens = malloc(count * sizeof(size_t));
+    size_t json_total = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        xd_decode(&ctx, objects.bytes[i], objects.lens[i]);
+        if (encode_json(&encoder, (const char*)ctx.output, ctx.output_len) != XD_OK)
+            return fprintf(stderr, "object %d: %s\n", i, encoder.error_message);
+        if (encoder.output_len != objects.lens[i] || memcmp(encoder.output, objects.bytes[i], objects.lens[i]) != 0)
+            return fprintf(stderr, "object %d: round trip differs\n", i);
+
+        jsons[i] = malloc(ctx.output_len);
+        memcpy(jsons[i], ctx.output, ctx.output_len);
+        lens[i] = ctx.output_len;
+        json_total += ctx.output_len;
+    }
+    if (count == 0)
+        return fprintf(stderr, "no objects decoded\n");
+    printf("%d objects round trip byte-exact\n", count);
+
+    int rounds = ROUNDS_BYTES / json_total + 1;
+    double t = now();
+    for (int r = 0; r < rounds; ++r)
+        for (int i = 0; i < count; ++i)
+            encode_json(&encoder, jsons[i], lens[i]);
+    double elapsed = now() - t;
+
+    printf("average object %zu bytes of JSON, %zu of binary\n", json_total / count, objects.total / count);
+    printf("encode_json: %7.1f ns/object, %6.1f MB/s of JSON\n",
+            elapsed * 1e9 / ((double)rounds * count), (double)rounds * json_total / elapsed / 1e6);
+
+    for (int i = 0; i < count; ++i)
+        free(jsons[i]);
+    free(jsons);
+    free(lens);
+    bench_free(&objects);
+    encode_free(&encoder);
+    xd_free(&ctx);
+    return 0;
+}
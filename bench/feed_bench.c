@@ -0,0 +1,118 @@
+/**
+ * Push mode benchmark
+ * Feeds each line of the hex files given to xd_feed in chunks of many sizes, with and without a projection, and
+ * checks the JSON matches xd_decode's and that a truncated object is refused, then times both
+ */
+#include "bench.h"
+
+#define ROUNDS_BYTES (64*1024*1024)    // decode about this much binary in total per timing
+
+static const int chunk_sizes[] = { 1, 2, 3, 5, 8, 13, 21, 48, 100, 1500 };
+#define CHUNK_SIZES (int)(sizeof(chunk_sizes) / sizeof(chunk_sizes[0]))
+
+// feed `input` in chunks of `chunk` bytes, collecting the JSON into `out`, returns the XD_* code
+static int feed(struct xd_ctx* ctx, const uint8_t* input, size_t len, int chunk, char* out, size_t* out_len)
+{
+    *out_len = 0;
+    int error = xd_feed_begin(ctx, 0, 0);
+    for (size_t at = 0; error == XD_OK; at += chunk)
+    {
+        memcpy(out + *out_len, ctx->output, ctx->output_len);
+        *out_len += ctx->output_len;
+        if (at >= len)
+            break;
+        error = xd_feed(ctx, input + at, (len - at < (size_t)chunk ? len - at : (size_t)chunk));
+    }
+    if (error == XD_OK)
+        error = xd_feed_end(ctx);
+    memcpy(out + *out_len, ctx->output, ctx->output_len);
+    *out_len += ctx->output_len;
+    return error;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        return fprintf(stderr, "Usage: %s file.hex ...\n", argv[0]);
+
+    static struct definitions definitions;
+    definitions_builtin(&definitions);
+
+    static struct xd_projection projection;
+    if (xd_projection_compile(&projection, &definitions,
+                "TransactionType,Paths,Memos.Memo.MemoType,AffectedNodes.ModifiedNode.FinalFields") != XD_OK)
+        return fprintf(stderr, "projection failed to compile\n");
+
+    struct xd_ctx pull[2], push[2];
+    for (int p = 0; p < 2; ++p)
+    {
+        xd_init(&pull[p], &definitions, XD_COMPACT | XD_TXID);
+        xd_init(&push[p], &definitions, XD_COMPACT | XD_TXID);
+        xd_set_projection(&pull[p], (p ? &projection : 0));
+        xd_set_projection(&push[p], (p ? &projection : 0));
+    }
+
+    struct bench_objects objects;
+    if (!bench_load(&objects, &pull[0], argc, argv))
+        return 1;
+
+    int count = objects.count;
+    static char json[16*1024*1024];
+    for (int i = 0; i < count; ++i)
+    {
+        const uint8_t* binary = objects.bytes[i];
+        size_t bytes = objects.lens[i];
+        for (int p = 0; p < 2; ++p)
+        {
+            if (xd_decode(&pull[p], binary, bytes) != XD_OK)
+                return fprintf(stderr, "object %d: %s\n", i, pull[p].error_message);
+            for (int c = 0; c < CHUNK_SIZES; ++c)
+            {
+                size_t json_len;
+                int error = feed(&push[p], binary, bytes, chunk_sizes[c], json, &json_len);
+                if (error != XD_OK)
+                    return fprintf(stderr, "object %d: %d byte chunks: %s\n", i, chunk_sizes[c],
+                            push[p].error_message);
+                if (json_len != pull[p].output_len || memcmp(json, pull[p].output, json_len) != 0)
+                    return fprintf(stderr, "object %d: %d byte chunks%s: JSON differs\n", i, chunk_sizes[c],
+                            (p ? " with a projection" : ""));
+            }
+        }
+
+        size_t json_len;
+        if (feed(&push[0], binary, bytes - 1, 7, json, &json_len) != XD_ERR_TRUNCATED)
+            return fprintf(stderr, "object %d: a truncated object was not refused\n", i);
+    }
+    if (count == 0)
+        return fprintf(stderr, "no objects decoded\n");
+    printf("%d objects decode the same fed in chunks of 1 - %d bytes\n", count, chunk_sizes[CHUNK_SIZES - 1]);
+
+    int rounds = ROUNDS_BYTES / objects.total + 1;
+    double t = now();
+    for (int r = 0; r < rounds; ++r)
+        for (int i = 0; i < count; ++i)
+            xd_decode(&pull[0], objects.bytes[i], objects.lens[i]);
+    double decode = (now() - t) * 1e9 / ((double)rounds * count);
+    printf("average object %zu bytes\n", objects.total / count);
+    printf("xd_decode:             %7.1f ns/object\n", decode);
+
+    static const int timed[] = { 1500, 64 };
+    for (int c = 0; c < 2; ++c)
+    {
+        size_t json_len;
+        t = now();
+        for (int r = 0; r < rounds; ++r)
+            for (int i = 0; i < count; ++i)
+                feed(&push[0], objects.bytes[i], objects.lens[i], timed[c], json, &json_len);
+        double fed = (now() - t) * 1e9 / ((double)rounds * count);
+        printf("xd_feed, %4d byte chunks: %7.1f ns/object (%.2fx)\n", timed[c], fed, decode / fed);
+    }
+
+    bench_free(&objects);
+    for (int p = 0; p < 2; ++p)
+    {
+        xd_free(&pull[p]);
+        xd_free(&push[p]);
+    }
+    return 0;
+}
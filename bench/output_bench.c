@@ -0,0 +1,145 @@
+/**
+ * Chunked output benchmark
+ * Decodes each line of the hex files given, and a few large built objects, into ctx->output and with XD_CHUNKED into
+ * chunks, checks both give the same JSON and CBOR (pulled and pushed), then times the small objects on warm contexts
+ * and the large ones on fresh contexts, where ctx->output grows by doubling
+ */
+#include "bench.h"
+
+#define ROUNDS_BYTES (64*1024*1024)    // decode about this much binary in total per timing
+#define MAX_IOV 4096
+
+static const unsigned checked_flags[] = { 0, XD_COMPACT, XD_COMPACT | XD_TXID, XD_CBOR, XD_CBOR | XD_RAW_BYTES };
+#define CHECKED_FLAGS (int)(sizeof(checked_flags) / sizeof(checked_flags[0]))
+
+// the chunked result gathered through its iovecs
+static size_t gather(const struct xd_ctx* ctx, uint8_t* out)
+{
+    static struct iovec iov[MAX_IOV];
+    int count = xd_output_iov(ctx, iov, MAX_IOV);
+    size_t len = 0;
+    for (int i = 0; i < count && i < MAX_IOV; ++i)
+    {
+        memcpy(out + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+    return len;
+}
+
+// decoded into ctx->output, into chunks, copied out of the chunks and pushed into chunks, all four agree
+static int check(struct xd_ctx* whole, struct xd_ctx* chunked, const uint8_t* object, size_t len, uint8_t* out)
+{
+    if (xd_decode(whole, object, len) != XD_OK || xd_decode(chunked, object, len) != XD_OK)
+        return fprintf(stderr, "decode failed: %s%s\n", whole->error_message, chunked->error_message), 0;
+    if (chunked->output_len != whole->output_len || gather(chunked, out) != whole->output_len ||
+            memcmp(out, whole->output, whole->output_len) != 0)
+        return fprintf(stderr, "%zu byte object: chunked output differs\n", len), 0;
+    if (xd_output_copy(chunked, out, whole->output_len) != XD_ERR_OUTPUT ||
+            xd_output_copy(chunked, out, whole->output_len + 1) != XD_OK ||
+            memcmp(out, whole->output, whole->output_len + 1) != 0)
+        return fprintf(stderr, "%zu byte object: copied output differs\n", len), 0;
+
+    // pushed in one piece, so the middle call has all but the outermost object's ends
+    size_t pushed = 0;
+    int error = xd_feed_begin(chunked, 0, 0);
+    pushed += (error == XD_OK ? gather(chunked, out + pushed) : 0);
+    error = (error == XD_OK ? xd_feed(chunked, object, len) : error);
+    pushed += (error == XD_OK ? gather(chunked, out + pushed) : 0);
+    error = (error == XD_OK ? xd_feed_end(chunked) : error);
+    pushed += (error == XD_OK ? gather(chunked, out + pushed) : 0);
+    if (error != XD_OK || pushed != whole->output_len || memcmp(out, whole->output, pushed) != 0)
+        return fprintf(stderr, "%zu byte object: pushed chunked output differs\n", len), 0;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        return fprintf(stderr, "Usage: %s file.hex ...\n", argv[0]);
+
+    static struct definitions definitions;
+    definitions_builtin(&definitions);
+
+    struct xd_ctx whole[CHECKED_FLAGS], chunked[CHECKED_FLAGS];
+    for (int f = 0; f < CHECKED_FLAGS; ++f)
+    {
+        xd_init(&whole[f], &definitions, checked_flags[f]);
+        xd_init(&chunked[f], &definitions, checked_flags[f] | XD_CHUNKED);
+    }
+
+    struct bench_objects objects;
+    if (!bench_load(&objects, &whole[0], argc, argv))
+        return 1;
+
+    int count = objects.count;
+    uint8_t* out = malloc(64*1024*1024);
+    for (int i = 0; i < count; ++i)
+        for (int c = 0; c < CHECKED_FLAGS; ++c)
+            if (!check(&whole[c], &chunked[c], objects.bytes[i], objects.lens[i], out))
+                return fprintf(stderr, "object %d, flags %u\n", i, checked_flags[c]);
+    if (count == 0)
+        return fprintf(stderr, "no objects decoded\n");
+
+    // many memos and one huge blob, both spanning many chunks
+    static const int large[][2] = { { 4096, 1000 }, { 1, 900000 } };
+    uint8_t* large_objects[2];
+    size_t large_lens[2];
+    for (int l = 0; l < 2; ++l)
+    {
+        large_objects[l] = build(large[l][0], large[l][1], &large_lens[l]);
+        for (int c = 0; c < CHECKED_FLAGS; ++c)
+            if (!check(&whole[c], &chunked[c], large_objects[l], large_lens[l], out))
+                return fprintf(stderr, "large object, flags %u\n", checked_flags[c]);
+    }
+    printf("%d objects and 2 large ones decode the same chunked, pulled and pushed, as JSON and CBOR\n", count);
+
+    // small objects, on contexts that have been decoding for a while
+    struct xd_ctx* timed[2] = { &whole[1], &chunked[1] };
+    int rounds = ROUNDS_BYTES / objects.total + 1;
+    double ns[2];
+    for (int t = 0; t < 2; ++t)
+    {
+        double start = now();
+        for (int r = 0; r < rounds; ++r)
+            for (int i = 0; i < count; ++i)
+                xd_decode(timed[t], objects.bytes[i], objects.lens[i]);
+        ns[t] = (now() - start) * 1e9 / ((double)rounds * count);
+    }
+    printf("average object %zu bytes\n", objects.total / count);
+    printf("small objects:  ctx->output %7.1f ns/object, chunked %7.1f ns/object (%.2fx)\n", ns[0], ns[1],
+            ns[0] / ns[1]);
+
+    // large objects, each on a fresh context, and what the contexts hold afterwards
+    for (int l = 0; l < 2; ++l)
+    {
+        double ms[2];
+        size_t held[2];
+        for (int t = 0; t < 2; ++t)
+        {
+            int large_rounds = 20;
+            double start = now();
+            for (int r = 0; r < large_rounds; ++r)
+            {
+                struct xd_ctx ctx;
+                xd_init(&ctx, &definitions, XD_COMPACT | (t ? XD_CHUNKED : 0));
+                xd_decode(&ctx, large_objects[l], large_lens[l]);
+                held[t] = (t ? (size_t)ctx.output_chunks * XD_OUTPUT_CHUNK_SIZE : ctx.output_capacity);
+                xd_free(&ctx);
+            }
+            ms[t] = (now() - start) * 1e3 / large_rounds;
+        }
+        printf("%8zu byte object, fresh context: ctx->output %6.2f ms holding %7zuKB, chunked %6.2f ms holding "
+                "%7zuKB\n", large_lens[l], ms[0], held[0] / 1024, ms[1], held[1] / 1024);
+    }
+
+    bench_free(&objects);
+    for (int l = 0; l < 2; ++l)
+        free(large_objects[l]);
+    free(out);
+    for (int f = 0; f < CHECKED_FLAGS; ++f)
+    {
+        xd_free(&whole[f]);
+        xd_free(&chunked[f]);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * SHA-512Half transaction ID benchmark
+ * Checks sha512_half_prefixed_x4() against sha512_half_prefixed() on random blobs of transaction like sizes,
+ * then times both
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../sha-512.h"
+
+#define COUNT (256*1024)
+#define MAX_LEN 1024
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    uint8_t* blobs = malloc(COUNT * MAX_LEN);
+    size_t* lens = malloc(COUNT * sizeof(size_t));
+    uint8_t* hashes = malloc(COUNT * 32);
+    uint8_t* hashes_x4 = malloc(COUNT * 32);
+    const void** inputs = malloc(COUNT * sizeof(void*));
+
+    srand(1);
+    size_t total = 0;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        // mostly 100 - 400 bytes with the odd large one, every padding boundary gets hit
+        lens[i] = (i % 16 == 0 ? rand() % MAX_LEN : 100 + rand() % 300);
+        inputs[i] = blobs + (size_t)i * MAX_LEN;
+        total += lens[i];
+    }
+    for (size_t i = 0; i < (size_t)COUNT * MAX_LEN; ++i)
+        blobs[i] = rand();
+
+    // the empty message, "abc" and a two block one
+    static const char* vectors[][2] = {
+        { "", "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce" },
+        { "abc", "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a" },
+        { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+          "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018" }
+    };
+    for (int v = 0; v < 3; ++v)
+    {
+        uint8_t h[64];
+        char hex[65];
+        calc_sha_512(h, vectors[v][0], strlen(vectors[v][0]));
+        for (int i = 0; i < 32; ++i)
+            sprintf(hex + i * 2, "%02x", h[i]);
+        if (strcmp(hex, vectors[v][1]) != 0)
+            return fprintf(stderr, "SHA-512 vector %d: %s\n", v, hex);
+    }
+
+    for (int i = 0; i < COUNT; i += 4)
+        sha512_half_prefixed_x4(hashes_x4 + i * 32, SHA512_PREFIX_TRANSACTION_ID, inputs + i, lens + i);
+    for (int i = 0; i < COUNT; ++i)
+    {
+        sha512_half_prefixed(hashes + i * 32, SHA512_PREFIX_TRANSACTION_ID, inputs[i], lens[i]);
+        if (memcmp(hashes + i * 32, hashes_x4 + i * 32, 32) != 0)
+            return fprintf(stderr, "mismatch at %d (%zu bytes)\n", i, lens[i]);
+    }
+    printf("%d transaction IDs bit-exact\n", COUNT);
+
+    double t = now();
+    for (int i = 0; i < COUNT; ++i)
+        sha512_half_prefixed(hashes + i * 32, SHA512_PREFIX_TRANSACTION_ID, inputs[i], lens[i]);
+    double scalar = (now() - t) * 1e9 / COUNT;
+
+    t = now();
+    for (int i = 0; i < COUNT; i += 4)
+        sha512_half_prefixed_x4(hashes_x4 + i * 32, SHA512_PREFIX_TRANSACTION_ID, inputs + i, lens + i);
+    double x4 = (now() - t) * 1e9 / COUNT;
+
+    printf("average blob %zu bytes\n", total / COUNT);
+    printf("sha512_half_prefixed:    %7.1f ns/hash\n", scalar);
+    printf("sha512_half_prefixed_x4: %7.1f ns/hash (%.2fx)\n", x4, scalar / x4);
+
+    return 0;
+}
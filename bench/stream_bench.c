@@ -0,0 +1,142 @@
+/**
+ * Stream mode benchmark
+ * Builds objects of growing size (a payment with more and more memos), streams each through the context's own
+ * mirrored input buffer and through a caller's buffer that is compacted, checks both see the same bytes and the same
+ * transaction ID as buffer mode, then times them. The mirrored buffer's throughput should not depend on the size.
+ * First a blob far larger than a small stream buffer is checked to decode the same as in buffer mode
+ */
+#include "bench.h"
+
+#define MEMO_DATA 1000
+#define LARGE_MEMO_DATA 900000      // near the largest VL field, 918744 bytes
+#define SMALL_BUFFER 4096
+
+// the object, handed over as large blocks as the parser will take, like reads of a regular file
+struct source
+{
+    const uint8_t* bytes;
+    size_t len;
+    size_t at;
+};
+
+static int fetch(void* user, uint8_t* buf, int len, int min_bytes)
+{
+    struct source* s = user;
+    if (s->at >= s->len)
+        return -1;
+    size_t l = s->len - s->at;
+    if (l > (size_t)len)
+        l = len;
+    memcpy(buf, s->bytes + s->at, l);
+    s->at += l;
+    return l;
+}
+
+// an FNV-1a hash of every blob, so a blob the parser saw out of place shows up
+static int blob(void* user, const struct xd_field* field, const uint8_t* bytes, int len)
+{
+    uint64_t* h = user;
+    for (int i = 0; i < len; ++i)
+        *h = (*h ^ bytes[i]) * 0x100000001b3ULL;
+    return 1;
+}
+
+static const struct xd_visitor checking = { .blob = blob };
+static const struct xd_visitor counting = { 0 };
+
+// a blob larger than the stream buffer goes through in pieces and decodes the same as in buffer mode
+static int check_large(const struct definitions* definitions, unsigned flags)
+{
+    size_t len;
+    uint8_t* object = build(1, LARGE_MEMO_DATA, &len);
+    static uint8_t buffer[SMALL_BUFFER];
+
+    struct xd_ctx whole, streamed;
+    xd_init(&whole, definitions, flags);
+    xd_init(&streamed, definitions, flags);
+    xd_set_input_buffer(&streamed, buffer, sizeof(buffer));
+
+    struct source source = { object, len, 0 };
+    int ok = (xd_decode(&whole, object, len) == XD_OK &&
+              xd_decode_stream(&streamed, fetch, &source, 0) == XD_OK &&
+              whole.output_len == streamed.output_len &&
+              memcmp(whole.output, streamed.output, whole.output_len) == 0);
+    if (!ok)
+        fprintf(stderr, "%d byte blob through a %d byte buffer: %s\n", LARGE_MEMO_DATA, SMALL_BUFFER,
+                (streamed.error_message[0] ? streamed.error_message : "output differs"));
+
+    xd_free(&whole);
+    xd_free(&streamed);
+    free(object);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    static struct definitions definitions;
+    definitions_builtin(&definitions);
+
+    // checked with transaction IDs, timed without them as hashing would be most of the time
+    struct xd_ctx buffered, ctxs[2][2];
+    xd_init(&buffered, &definitions, XD_TXID);
+    uint8_t* own_buffers[2];
+    for (int t = 0; t < 2; ++t)
+    {
+        xd_init(&ctxs[t][0], &definitions, (t ? 0 : XD_TXID));
+        xd_init(&ctxs[t][1], &definitions, (t ? 0 : XD_TXID));
+        own_buffers[t] = malloc(XD_INPUT_SIZE);
+        xd_set_input_buffer(&ctxs[t][1], own_buffers[t], XD_INPUT_SIZE);
+    }
+
+    if (!check_large(&definitions, XD_COMPACT | XD_TXID) || !check_large(&definitions, XD_CBOR) ||
+        !check_large(&definitions, XD_CBOR | XD_RAW_BYTES))
+        return 1;
+    printf("%d byte blob decodes the same as JSON and CBOR through a %d byte stream buffer\n",
+            LARGE_MEMO_DATA, SMALL_BUFFER);
+
+    static const int sizes[] = { 64, 1024, 16 * 1024, 128 * 1024 };
+    for (int s = 0; s < 4; ++s)
+    {
+        size_t len;
+        uint8_t* object = build(sizes[s], MEMO_DATA, &len);
+
+        uint64_t expected = 0xcbf29ce484222325ULL;
+        if (xd_visit(&buffered, object, len, &checking, &expected) != XD_OK)
+            return fprintf(stderr, "buffer mode: %s\n", buffered.error_message);
+
+        double mbs[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            uint64_t h = 0xcbf29ce484222325ULL;
+            struct source source = { object, len, 0 };
+            if (xd_visit_stream(&ctxs[0][c], fetch, &source, &checking, &h) != XD_OK)
+                return fprintf(stderr, "stream mode: %s\n", ctxs[0][c].error_message);
+            if (h != expected || memcmp(ctxs[0][c].txid, buffered.txid, 32) != 0)
+                return fprintf(stderr, "%zu byte object: %s stream mode differs from buffer mode\n",
+                        len, (c ? "compacted" : "mirrored"));
+
+            // about 512MB streamed whatever the size
+            int rounds = (512 * 1024 * 1024) / len + 1;
+            double t = now();
+            for (int r = 0; r < rounds; ++r)
+            {
+                source.at = 0;
+                xd_visit_stream(&ctxs[1][c], fetch, &source, &counting, 0);
+            }
+            mbs[c] = (double)rounds * len / (now() - t) / 1e6;
+        }
+
+        printf("%10zu byte object: mirrored %7.1f MB/s, compacted %7.1f MB/s\n", len, mbs[0], mbs[1]);
+        free(object);
+    }
+    printf("mirrored input buffer: %s\n", (ctxs[0][0].input_mirrored ? "yes" : "no (fell back to compacting)"));
+
+    xd_free(&buffered);
+    for (int t = 0; t < 2; ++t)
+    {
+        xd_free(&ctxs[t][0]);
+        xd_free(&ctxs[t][1]);
+        free(own_buffers[t]);
+    }
+    return 0;
+}
@@ -0,0 +1,510 @@
+/**
+ * Delimited output, see csv.h
+ * Cells are collected as the object is visited, because a row's fields can come after the array entries it is
+ * repeated on, and written out as rows once it has been decoded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "csv.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static int csv_grow(void** data, size_t* capacity, size_t need)
+{
+    if (need <= *capacity)
+        return 1;
+
+    size_t grown = (*capacity ? *capacity * 2 : 4096);
+    while (grown < need)
+        grown *= 2;
+    void* p = realloc(*data, grown);
+    if (!p)
+        return 0;
+    *data = p;
+    *capacity = grown;
+    return 1;
+}
+
+static int output_push(struct csv_writer* w, const void* data, size_t len)
+{
+    if (!csv_grow((void**)&w->output, &w->output_capacity, w->output_len + len))
+        return 0;
+    memcpy(w->output + w->output_len, data, len);
+    w->output_len += len;
+    return 1;
+}
+
+// one cell, quoted for CSV (RFC 4180) or backslash escaped for TSV (PostgreSQL's text format) if it has to be
+static int output_cell(struct csv_writer* w, const char* text, size_t len)
+{
+    size_t plain = 0;
+    while (plain < len && text[plain] != w->separator && text[plain] != '"' && text[plain] != '\\' &&
+            text[plain] != '\n' && text[plain] != '\r')
+        plain++;
+    if (plain == len)
+        return output_push(w, text, len);
+
+    // the worst case doubles every byte
+    if (!csv_grow((void**)&w->output, &w->output_capacity, w->output_len + len * 2 + 2))
+        return 0;
+    uint8_t* out = w->output + w->output_len;
+    if (w->separator == '\t')
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            char ch = text[i];
+            if (ch == '\\' || ch == '\t' || ch == '\n' || ch == '\r')
+            {
+                *out++ = '\\';
+                ch = (ch == '\t' ? 't' : ch == '\n' ? 'n' : ch == '\r' ? 'r' : ch);
+            }
+            *out++ = ch;
+        }
+    }
+    else
+    {
+        *out++ = '"';
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (text[i] == '"')
+                *out++ = '"';
+            *out++ = text[i];
+        }
+        *out++ = '"';
+    }
+    w->output_len = out - w->output;
+    return 1;
+}
+
+// stop the parse with `code`, EMIT keeps an error the visitor set
+static int csv_fail(struct csv_writer* w, int code, const char* message)
+{
+    w->ctx->error = code;
+    snprintf(w->ctx->error_message, sizeof(w->ctx->error_message), "Error: %.100s", message);
+    return 0;
+}
+
+// room for `len` more bytes of cell text, 0 if out of memory
+static char* csv_text(struct csv_writer* w, size_t len)
+{
+    if (!csv_grow((void**)&w->text, &w->text_capacity, w->text_len + len))
+        return (csv_fail(w, XD_ERR_MEMORY, "out of memory building a CSV row"), (char*)0);
+    return w->text + w->text_len;
+}
+
+static int cell_set(struct csv_writer* w, struct csv_cell* cell, const char* text, size_t len)
+{
+    char* out = csv_text(w, len);
+    if (!out)
+        return 0;
+    memcpy(out, text, len);
+    cell->offset = w->text_len;
+    cell->len = len;
+    w->text_len += len;
+    return 1;
+}
+
+static int cell_hex(struct csv_writer* w, struct csv_cell* cell, const uint8_t* bytes, size_t len)
+{
+    char* out = csv_text(w, len * 2);
+    if (!out)
+        return 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        out[i * 2] = hex_digits[bytes[i] >> 4U];
+        out[i * 2 + 1] = hex_digits[bytes[i] & 0xFU];
+    }
+    cell->offset = w->text_len;
+    cell->len = len * 2;
+    w->text_len += len * 2;
+    return 1;
+}
+
+static int cell_address(struct csv_writer* w, struct csv_cell* cell, const uint8_t* id)
+{
+    if (!id)
+        return cell_set(w, cell, "", 0);
+    size_t len = 0;
+    const char* address = xd_address(w->ctx, id, &len);
+    if (!address)
+        return csv_fail(w, XD_ERR_ENCODE, "could not base58 encode");
+    return cell_set(w, cell, address, len - 1);
+}
+
+// the empty cell column `i` has for the field being visited if its path ends there, 0 otherwise.
+// A path into the explode array has one cell per entry
+static struct csv_cell* csv_match(struct csv_writer* w, int i, uint32_t field_id)
+{
+    const struct csv_column* c = &w->columns[i];
+    if (c->len != w->depth + 1)
+        return 0;
+    for (int d = 0; d < w->depth; ++d)
+        if (c->path[d] != CSV_ANY && c->path[d] != w->stack[d])
+            return 0;
+    if (c->path[w->depth] != CSV_ANY && c->path[w->depth] != field_id)
+        return 0;
+
+    struct csv_cell* cell = &w->cells[i];
+    if (c->per_entry)
+    {
+        if (!w->in_entry)
+            return 0;
+        cell = &w->entry_cells[(w->entries - 1) * w->count + i];
+    }
+    return (cell->len < 0 ? cell : 0);
+}
+
+// a new entry of the explode array, all of its cells empty
+static int csv_entry(struct csv_writer* w)
+{
+    if (w->entries >= w->entry_capacity)
+    {
+        int capacity = (w->entry_capacity ? w->entry_capacity * 2 : 64);
+        struct csv_cell* cells = realloc(w->entry_cells, (size_t)capacity * w->count * sizeof(*cells));
+        if (!cells)
+            return csv_fail(w, XD_ERR_MEMORY, "out of memory building a CSV row");
+        w->entry_cells = cells;
+        w->entry_capacity = capacity;
+    }
+    struct csv_cell* cells = &w->entry_cells[w->entries * w->count];
+    for (int i = 0; i < w->count; ++i)
+        cells[i].len = -1;
+    w->entries++;
+    w->in_entry = 1;
+    return 1;
+}
+
+// objects and arrays, a path that ends at one gets its name
+static int csv_begin(void* user, const struct xd_field* field)
+{
+    struct csv_writer* w = user;
+    if (!field)
+        return 1;
+    if (w->explode && w->depth == 1 && w->stack[0] == w->explode && !csv_entry(w))
+        return 0;
+
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct csv_cell* cell = csv_match(w, i, field->field_id);
+        if (cell && field->name && !cell_set(w, cell, field->name, field->name_len))
+            return 0;
+    }
+
+    if (w->depth < CSV_DEPTH)
+        w->stack[w->depth] = field->field_id;
+    w->depth++;
+    return 1;
+}
+
+static int csv_end(void* user)
+{
+    struct csv_writer* w = user;
+    // the outermost object
+    if (w->depth == 0)
+        return 1;
+    w->depth--;
+    if (w->explode && w->depth == 1 && w->stack[0] == w->explode)
+        w->in_entry = 0;
+    return 1;
+}
+
+static int csv_integer(void* user, const struct xd_field* field, uint64_t value)
+{
+    struct csv_writer* w = user;
+    const struct definitions* definitions = w->definitions;
+
+    // named codes
+    const struct definitions_name* name = 0;
+    if (field->type_code == 1 && field->field_code == 2)
+        name = &definitions->transaction_types[value & 0xFFU];
+    else if (field->type_code == 1 && field->field_code == 1)
+        name = &definitions->ledger_entry_types[value & 0xFFU];
+    else if (field->type_code == 16 && field->field_code == 3)
+        name = &definitions->transaction_results[value & 0xFFU];
+
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct csv_cell* cell = csv_match(w, i, field->field_id);
+        if (!cell)
+            continue;
+        int ok = 1;
+        if (name && value < 256 && name->offset)
+            // stored as `"Name"`
+            ok = cell_set(w, cell, DEFINITIONS_STR(definitions, *name) + 1, name->len - 2);
+        else
+        {
+            char str[24];
+            ok = cell_set(w, cell, str, snprintf(str, sizeof(str), "%llu", (unsigned long long)value));
+        }
+        if (!ok)
+            return 0;
+    }
+    return 1;
+}
+
+// hashes, blobs and Vector256s are all hex
+static int csv_bytes(void* user, const struct xd_field* field, const uint8_t* bytes, int len)
+{
+    struct csv_writer* w = user;
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct csv_cell* cell = csv_match(w, i, field->field_id);
+        if (cell && !cell_hex(w, cell, bytes, len))
+            return 0;
+    }
+    return 1;
+}
+
+static int csv_account(void* user, const struct xd_field* field, const uint8_t* id)
+{
+    struct csv_writer* w = user;
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct csv_cell* cell = csv_match(w, i, field->field_id);
+        if (cell && !cell_address(w, cell, id))
+            return 0;
+    }
+    return 1;
+}
+
+static int csv_amount(void* user, const struct xd_field* field, const struct xd_amount* amount)
+{
+    static const uint8_t xrp[20];
+    struct csv_writer* w = user;
+    for (int i = 0; i < w->count; ++i)
+    {
+        struct csv_cell* cell = csv_match(w, i, field->field_id);
+        if (!cell)
+            continue;
+
+        int part = w->columns[i].part;
+        int ok = 1;
+        if (part == CSV_WHOLE || part == CSV_VALUE || (part == CSV_DROPS && amount->native))
+        {
+            char value[XD_AMOUNT_VALUE_SIZE];
+            ok = cell_set(w, cell, value, xd_amount_value(value, amount));
+        }
+        else if (part == CSV_CURRENCY)
+        {
+            char code[40];
+            ok = cell_set(w, cell, code, xd_currency_code(code, amount->native ? xrp : amount->currency));
+        }
+        else if (part == CSV_ISSUER && !amount->native)
+            ok = cell_address(w, cell, amount->issuer);
+        if (!ok)
+            return 0;
+    }
+    return 1;
+}
+
+static const struct xd_visitor csv_visitor =
+{
+    .begin_object = csv_begin,
+    .end_object = csv_end,
+    .begin_array = csv_begin,
+    .end_array = csv_end,
+    .integer = csv_integer,
+    .hash = csv_bytes,
+    .account = csv_account,
+    .amount = csv_amount,
+    .blob = csv_bytes
+};
+
+// one row, `entry` is the explode array entry's cells
+static int csv_row(struct csv_writer* w, const struct csv_cell* entry)
+{
+    for (int i = 0; i < w->count; ++i)
+    {
+        const struct csv_cell* cell = (w->columns[i].per_entry ? &entry[i] : &w->cells[i]);
+        if ((i > 0 && !output_push(w, &w->separator, 1)) ||
+                (cell->len > 0 && !output_cell(w, w->text + cell->offset, cell->len)))
+            return 0;
+    }
+    return output_push(w, "\n", 1);
+}
+
+// write the object's rows once it has decoded
+static int csv_rows(struct csv_writer* w, const struct xd_projection* saved, int error)
+{
+    struct xd_ctx* ctx = w->ctx;
+    ctx->projection = saved;
+    if (error != XD_OK)
+        return error;
+
+    for (int i = 0; i < w->count; ++i)
+        if (w->columns[i].len == 0 && (ctx->flags & XD_TXID) && !cell_hex(w, &w->cells[i], ctx->txid, 32))
+            return ctx->error;
+
+    int ok = 1;
+    if (!w->explode)
+        ok = csv_row(w, 0);
+    for (int e = 0; ok && e < w->entries; ++e)
+        ok = csv_row(w, &w->entry_cells[e * w->count]);
+    if (!ok)
+        return (csv_fail(w, XD_ERR_MEMORY, "out of memory writing CSV rows"), ctx->error);
+    return XD_OK;
+}
+
+static const struct xd_projection* csv_start(struct csv_writer* w, struct xd_ctx* ctx)
+{
+    const struct xd_projection* saved = ctx->projection;
+    w->ctx = ctx;
+    w->depth = 0;
+    w->in_entry = 0;
+    w->entries = 0;
+    w->text_len = 0;
+    w->output_len = 0;
+    for (int i = 0; i < w->count; ++i)
+        w->cells[i].len = -1;
+    ctx->projection = (w->projection.count > 0 ? &w->projection : saved);
+    return saved;
+}
+
+int csv_append(struct csv_writer* w, struct xd_ctx* ctx, const uint8_t* input, size_t input_len)
+{
+    const struct xd_projection* saved = csv_start(w, ctx);
+    return csv_rows(w, saved, xd_visit(ctx, input, input_len, &csv_visitor, w));
+}
+
+int csv_append_stream(struct csv_writer* w, struct xd_ctx* ctx, xd_fetch fetch, void* user)
+{
+    const struct xd_projection* saved = csv_start(w, ctx);
+    return csv_rows(w, saved, xd_visit_stream(ctx, fetch, user, &csv_visitor, w));
+}
+
+int csv_header(struct csv_writer* w)
+{
+    w->output_len = 0;
+    for (int i = 0; i < w->count; ++i)
+        if ((i > 0 && !output_push(w, &w->separator, 1)) ||
+                !output_cell(w, w->columns[i].name, strlen(w->columns[i].name)))
+            return 0;
+    return output_push(w, "\n", 1);
+}
+
+/**
+ * One comma separated column: hash, or a dotted path of field names and `*`, which an amount's .value, .currency,
+ * .issuer or .drops can end. `project_len` receives how much of the path the decoder has to keep, up to the first
+ * `*`, 0 when that is everything
+ */
+static int csv_compile_column(struct csv_writer* w, const char* column, int len, int* project_len)
+{
+    static const char* parts[] = { "", "value", "currency", "issuer", "drops" };
+    const struct definitions* definitions = w->definitions;
+
+    if (w->count >= CSV_COLUMNS)
+        return (snprintf(w->error, sizeof(w->error), "more than %d columns", CSV_COLUMNS), 0);
+    if (len >= CSV_NAME_SIZE)
+        return (snprintf(w->error, sizeof(w->error), "column `%.*s` too long", len, column), 0);
+
+    struct csv_column* c = &w->columns[w->count++];
+    snprintf(c->name, sizeof(c->name), "%.*s", len, column);
+    *project_len = -1;
+    if (len == 4 && memcmp(column, "hash", 4) == 0)
+        return 1;
+
+    int kind = KIND_OBJECT;
+    int wildcard = 0;
+    for (const char* end = column + len; column < end;)
+    {
+        const char* dot = memchr(column, '.', end - column);
+        int name_len = (dot ? dot : end) - column;
+
+        if (kind == KIND_AMOUNT)
+        {
+            for (int i = CSV_VALUE; i <= CSV_DROPS; ++i)
+                if ((int)strlen(parts[i]) == name_len && memcmp(parts[i], column, name_len) == 0)
+                    c->part = i;
+            if (c->part == CSV_WHOLE || dot)
+                return (snprintf(w->error, sizeof(w->error), "`%s` is not .value, .currency, .issuer or .drops",
+                        c->name), 0);
+            break;
+        }
+        if (kind != KIND_OBJECT && kind != KIND_ARRAY)
+            return (snprintf(w->error, sizeof(w->error), "`%s` goes inside a field that is not an object or array",
+                    c->name), 0);
+        if (c->len >= CSV_DEPTH)
+            return (snprintf(w->error, sizeof(w->error), "`%s` is more than %d fields deep", c->name, CSV_DEPTH), 0);
+
+        if (name_len == 1 && *column == '*')
+        {
+            c->path[c->len++] = CSV_ANY;
+            wildcard = 1;
+            kind = KIND_OBJECT;
+        }
+        else
+        {
+            uint32_t field_id = definitions_field_id(definitions, column, name_len);
+            if (!field_id)
+                return (snprintf(w->error, sizeof(w->error), "unknown field `%.*s`", name_len, column), 0);
+            c->path[c->len++] = field_id;
+            // a field inside `*` could be anything
+            kind = (wildcard ? KIND_OBJECT : definitions->type_kind[field_id >> 16U]);
+            if (kind == KIND_PATHSET)
+                return (snprintf(w->error, sizeof(w->error), "`%s` is a pathset", c->name), 0);
+        }
+        if (!wildcard)
+            *project_len = (dot ? dot : end) - (end - len);
+        column += name_len + (dot != 0);
+    }
+
+    if (wildcard && *project_len < 0)
+        *project_len = 0;
+    c->per_entry = (w->explode && c->len > 1 && c->path[0] == w->explode);
+    return 1;
+}
+
+int csv_open(struct csv_writer* w, const struct definitions* definitions, const char* columns,
+        const char* explode, char separator)
+{
+    memset(w, 0, sizeof(*w));
+    w->definitions = definitions;
+    w->separator = separator;
+    if (!columns)
+        columns = CSV_DEFAULT_COLUMNS;
+
+    // the decoder is given the columns' fields and the explode array as a projection
+    char fields[1024];
+    int fields_len = 0;
+    int fields_all = 0;
+    if (explode)
+    {
+        w->explode = definitions_field_id(definitions, explode, strlen(explode));
+        if (!w->explode || definitions->type_kind[w->explode >> 16U] != KIND_ARRAY)
+            return (snprintf(w->error, sizeof(w->error), "`%.100s` is not an array", explode), 0);
+        fields_len = snprintf(fields, sizeof(fields), "%s", explode);
+    }
+
+    for (const char* column = columns; *column;)
+    {
+        int len = strcspn(column, ",");
+        int project_len = -1;
+        if (len > 0 && !csv_compile_column(w, column, len, &project_len))
+            return 0;
+        if (project_len == 0 || fields_len + project_len + 2 > (int)sizeof(fields))
+            fields_all = 1;
+        else if (project_len > 0)
+            fields_len += sprintf(fields + fields_len, "%s%.*s", (fields_len ? "," : ""), project_len, column);
+        column += len + (column[len] == ',');
+    }
+    if (w->count == 0)
+        return (snprintf(w->error, sizeof(w->error), "no columns"), 0);
+    // a path that starts with `*`, or too many to project, everything is decoded instead
+    if (fields_all || fields_len == 0 || xd_projection_compile(&w->projection, definitions, fields) != XD_OK)
+        w->projection.count = 0;
+    return 1;
+}
+
+void csv_free(struct csv_writer* w)
+{
+    free(w->entry_cells);
+    free(w->text);
+    free(w->output);
+    w->entry_cells = 0;
+    w->text = 0;
+    w->output = 0;
+    w->count = 0;
+}
@@ -0,0 +1,101 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "definitions.h"
+#include "xd.h"
+
+/**
+ * Delimited (CSV or TSV) output, one row per object or one row per entry of a top level array
+ * A column is a dotted path of field names from the top level, like Account, Memos.Memo.MemoType or
+ * AffectedNodes.ModifiedNode.FinalFields.Balance. `*` in a path matches any field. A cell holds the text the JSON
+ * output has for the field, without quotes. An amount is its value, and Name.value, Name.currency, Name.issuer and
+ * Name.drops (XRP only) pick one part of it. A path that ends at an object or array gives that field's name, so
+ * AffectedNodes.* is the kind of each node. "hash" is the transaction ID when the context has XD_TXID.
+ * The first field to match a path fills its cell, a path that matches nothing leaves the cell empty.
+ *
+ * With an `explode` array there is one row per entry of it instead, paths into the array are matched inside
+ * the entry and the rest are repeated on each of its rows. An object without the array makes no rows.
+ */
+#define CSV_COLUMNS 64              // most columns one writer holds
+#define CSV_DEPTH 8                 // longest path
+#define CSV_NAME_SIZE 64            // longest column
+#define CSV_ANY 0xFFFFFFFFU         // `*` in a path
+
+#define CSV_DEFAULT_COLUMNS "TransactionType,Account,Destination,Fee,Sequence,Flags,DestinationTag,"\
+    "Amount.value,Amount.currency,Amount.issuer,TransactionResult"
+
+enum csv_part
+{
+    CSV_WHOLE = 0,
+    CSV_VALUE,
+    CSV_CURRENCY,
+    CSV_ISSUER,
+    CSV_DROPS
+};
+
+struct csv_column
+{
+    char name[CSV_NAME_SIZE];
+    uint32_t path[CSV_DEPTH];       // field_ids from the top level, empty for the transaction ID
+    int len;
+    int part;                       // enum csv_part, for amounts
+    int per_entry;                  // a path into the explode array
+};
+
+// a cell's text in the writer's text buffer, len is -1 while it is empty
+struct csv_cell
+{
+    int offset;
+    int len;
+};
+
+struct csv_writer
+{
+    const struct definitions* definitions;
+    struct xd_ctx* ctx;             // of the object being decoded
+    struct xd_projection projection;
+    char separator;                 // ',' for CSV, '\t' for TSV
+    uint32_t explode;               // field_id of the array with one row per entry, 0 for one row per object
+    int count;
+    struct csv_column columns[CSV_COLUMNS];
+
+    // the object being decoded
+    uint32_t stack[CSV_DEPTH];      // field_ids of the objects and arrays it is inside
+    int depth;
+    int in_entry;
+    struct csv_cell cells[CSV_COLUMNS];
+    struct csv_cell* entry_cells;   // `count` per entry
+    int entries;
+    int entry_capacity;
+    char* text;
+    size_t text_len;
+    size_t text_capacity;
+
+    // rows for the last object, or the header
+    uint8_t* output;
+    size_t output_len;
+    size_t output_capacity;
+    char error[128];
+};
+
+// compile `columns` (null for CSV_DEFAULT_COLUMNS) and `explode` (null for one row per object),
+// returns 1 on success, 0 with `error` set
+int csv_open(struct csv_writer* writer, const struct definitions* definitions, const char* columns,
+        const char* explode, char separator);
+
+// the header row into `output`, returns 0 if out of memory
+int csv_header(struct csv_writer* writer);
+
+// decode one object into rows in `output`, returns an XD_* code. Only the columns' fields are decoded, the
+// context's own projection is put back afterwards
+int csv_append(struct csv_writer* writer, struct xd_ctx* ctx, const uint8_t* input, size_t input_len);
+
+// the same, reading the object through `fetch`
+int csv_append_stream(struct csv_writer* writer, struct xd_ctx* ctx, xd_fetch fetch, void* user);
+
+void csv_free(struct csv_writer* writer);
+
+#endif
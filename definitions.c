@@ -0,0 +1,382 @@
+/**
+ * Runtime type / field definitions
+ * Built from the lists in definitions.h, loaded from a rippled style definitions.json,
+ * or mmapped from a precompiled cache file
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "definitions.h"
+#include "json.h"
+
+// how each serialized type named in definitions.json is decoded
+static const struct
+{
+    const char* name;
+    uint8_t kind;
+    uint8_t size;
+} type_kinds[] =
+{
+    { "UInt8",      KIND_UINT,      1 },
+    { "UInt16",     KIND_UINT,      2 },
+    { "UInt32",     KIND_UINT,      4 },
+    { "UInt64",     KIND_UINT,      8 },
+    { "UInt96",     KIND_HASH,      12 },
+    { "Hash128",    KIND_HASH,      16 },
+    { "Hash160",    KIND_HASH,      20 },
+    { "Hash192",    KIND_HASH,      24 },
+    { "Hash256",    KIND_HASH,      32 },
+    { "UInt384",    KIND_HASH,      48 },
+    { "UInt512",    KIND_HASH,      64 },
+    { "Amount",     KIND_AMOUNT,    8 },
+    { "Blob",       KIND_BLOB,      0 },
+    { "AccountID",  KIND_ACCOUNT,   21 },
+    { "STObject",   KIND_OBJECT,    0 },
+    { "STArray",    KIND_ARRAY,     0 },
+    { "PathSet",    KIND_PATHSET,   0 },
+    { "Vector256",  KIND_VECTOR256, 0 },
+};
+
+static void definitions_clear(struct definitions* d)
+{
+    memset(d, 0, sizeof(*d));
+    memcpy(d->magic, DEFINITIONS_MAGIC, sizeof(d->magic));
+    d->size = sizeof(*d);
+    memset(d->type_row, 0xFF, sizeof(d->type_row));
+    d->strings_used = 1; // offset 0 is reserved for "not defined"
+}
+
+// copy `prefix name suffix` into the string table
+static int definitions_string(struct definitions* d, struct definitions_name* out,
+        const char* prefix, const char* name, int name_len, const char* suffix)
+{
+    int prefix_len = strlen(prefix);
+    int suffix_len = strlen(suffix);
+    int l = prefix_len + name_len + suffix_len;
+    if (d->strings_used + l + 1 > DEFINITIONS_STRINGS_SIZE)
+        return 0;
+
+    char* s = d->strings + d->strings_used;
+    memcpy(s, prefix, prefix_len);
+    memcpy(s + prefix_len, name, name_len);
+    memcpy(s + prefix_len + name_len, suffix, suffix_len);
+    s[l] = '\0';
+
+    out->offset = d->strings_used;
+    out->len = l;
+    d->strings_used += l + 1;
+    return 1;
+}
+
+static int definitions_type(struct definitions* d, long long type_code, const char* name, int name_len)
+{
+    if (type_code <= 0 || type_code > 255)
+        return 1;
+
+    for (int i = 0; i < sizeof(type_kinds)/sizeof(*type_kinds); ++i)
+    {
+        if (strlen(type_kinds[i].name) != name_len || memcmp(type_kinds[i].name, name, name_len) != 0)
+            continue;
+        d->type_kind[type_code] = type_kinds[i].kind;
+        d->type_size[type_code] = type_kinds[i].size;
+        if (d->type_row[type_code] == 0xFFU)
+        {
+            if (d->rows_used >= DEFINITIONS_MAX_ROWS)
+                return 0;
+            d->type_row[type_code] = d->rows_used++;
+        }
+        return 1;
+    }
+
+    // types xd does not know how to decode stay unknown
+    return 1;
+}
+
+static int definitions_field(struct definitions* d, long long type_code, long long field_code,
+        const char* name, int name_len)
+{
+    // fields outside the one byte header range are never serialized
+    if (type_code <= 0 || type_code > 255 || field_code <= 0 || field_code > 255)
+        return 1;
+
+    // end markers have no key
+    if ((d->type_kind[type_code] == KIND_OBJECT || d->type_kind[type_code] == KIND_ARRAY) && field_code == 1)
+        return 1;
+
+    uint8_t row = d->type_row[type_code];
+    if (row == 0xFFU)
+        return 1;
+
+    return definitions_string(d, &d->field_keys[row][field_code], "\"", name, name_len, "\": ");
+}
+
+static int definitions_code(struct definitions* d, struct definitions_name* table,
+        long long code, const char* name, int name_len)
+{
+    if (code < 0 || code > 255)
+        return 1;
+    return definitions_string(d, &table[code], "\"", name, name_len, "\"");
+}
+
+void definitions_builtin(struct definitions* d)
+{
+    definitions_clear(d);
+
+    #define BUILTIN_TYPE(type_code, name) definitions_type(d, (type_code), name, sizeof(name) - 1);
+    XD_TYPES(BUILTIN_TYPE)
+
+    #define BUILTIN_FIELD(type_code, field_code, name)\
+        definitions_field(d, (type_code), (field_code), name, sizeof(name) - 1);
+    XD_FIELDS(BUILTIN_FIELD)
+
+    #define BUILTIN_TRANSACTION_TYPE(code, name)\
+        definitions_code(d, d->transaction_types, (code), name, sizeof(name) - 1);
+    XD_TRANSACTION_TYPES(BUILTIN_TRANSACTION_TYPE)
+
+    #define BUILTIN_LEDGER_ENTRY_TYPE(code, name)\
+        definitions_code(d, d->ledger_entry_types, (code), name, sizeof(name) - 1);
+    XD_LEDGER_ENTRY_TYPES(BUILTIN_LEDGER_ENTRY_TYPE)
+
+    #define BUILTIN_TRANSACTION_RESULT(code, name)\
+        definitions_code(d, d->transaction_results, (code), name, sizeof(name) - 1);
+    XD_TRANSACTION_RESULTS(BUILTIN_TRANSACTION_RESULT)
+}
+
+// field_id of a field name by a scan of every defined type's keys
+uint32_t definitions_field_id(const struct definitions* d, const char* name, int name_len)
+{
+    // keys are stored as `"Name": `
+    for (int type_code = 1; type_code < 256; ++type_code)
+    {
+        uint8_t row = d->type_row[type_code];
+        if (row == 0xFFU)
+            continue;
+        for (int field_code = 1; field_code < 256; ++field_code)
+        {
+            const struct definitions_name* key = &d->field_keys[row][field_code];
+            if (key->offset && key->len == name_len + 4 && memcmp(DEFINITIONS_STR(d, *key) + 1, name, name_len) == 0)
+                return ((uint32_t)type_code << 16U) + field_code;
+        }
+    }
+    return 0;
+}
+
+int definitions_field_path(const struct definitions* d, const char* path, int path_len, uint32_t* ids, int max_ids)
+{
+    int count = 0;
+    const char* end = path + path_len;
+    while (path < end)
+    {
+        const char* dot = memchr(path, '.', end - path);
+        int len = (dot ? dot : end) - path;
+        if (count >= max_ids || !(ids[count++] = definitions_field_id(d, path, len)))
+            return 0;
+        path += len + (dot ? 1 : 0);
+    }
+    return count;
+}
+
+int definitions_find_code(const struct definitions* d, const struct definitions_name* table,
+        const char* name, int name_len)
+{
+    // codes are stored as `"Name"`
+    for (int code = 0; code < 256; ++code)
+        if (table[code].offset && table[code].len == name_len + 2 &&
+                memcmp(DEFINITIONS_STR(d, table[code]) + 1, name, name_len) == 0)
+            return code;
+    return -1;
+}
+
+// load the name: code pairs of a definitions.json object section into `table`
+static int definitions_json_codes(struct definitions* d, struct definitions_name* table,
+        const char* js, struct json_token* t, int i)
+{
+    if (t[i].type != JSON_OBJECT)
+        return 0;
+
+    int end = json_skip(t, i);
+    for (i++; i < end; i = json_skip(t, i + 1))
+    {
+        long long code;
+        if (!json_int(js, &t[i + 1], &code))
+            return 0;
+        if (!definitions_code(d, table, code, js + t[i].start, t[i].end - t[i].start))
+            return 0;
+    }
+    return 1;
+}
+
+int definitions_load_json(struct definitions* d, const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    char* js = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (js == MAP_FAILED)
+        return 0;
+
+    int ok = 0;
+    struct json_token* t = 0;
+    int count = json_parse(js, st.st_size, 0, 0);
+    if (count <= 0 || !(t = malloc(count * sizeof(*t))) ||
+        json_parse(js, st.st_size, t, count) != count || t[0].type != JSON_OBJECT)
+        goto done;
+
+    definitions_clear(d);
+
+    // TYPES first, the FIELDS section refers to types by name
+    int types = -1, fields = -1, transaction_types = -1, ledger_entry_types = -1, transaction_results = -1;
+    for (int i = 1; i < count; i = json_skip(t, i + 1))
+    {
+        if (json_eq(js, &t[i], "TYPES")) types = i + 1;
+        else if (json_eq(js, &t[i], "FIELDS")) fields = i + 1;
+        else if (json_eq(js, &t[i], "TRANSACTION_TYPES")) transaction_types = i + 1;
+        else if (json_eq(js, &t[i], "LEDGER_ENTRY_TYPES")) ledger_entry_types = i + 1;
+        else if (json_eq(js, &t[i], "TRANSACTION_RESULTS")) transaction_results = i + 1;
+    }
+
+    if (types < 0 || fields < 0 || t[types].type != JSON_OBJECT || t[fields].type != JSON_ARRAY)
+        goto done;
+
+    for (int i = types + 1, end = json_skip(t, types); i < end; i = json_skip(t, i + 1))
+    {
+        long long type_code;
+        if (!json_int(js, &t[i + 1], &type_code) ||
+            !definitions_type(d, type_code, js + t[i].start, t[i].end - t[i].start))
+            goto done;
+    }
+
+    // [ "Name", { "nth": 1, "isSerialized": true, "type": "UInt16", ... } ]
+    for (int i = fields + 1, end = json_skip(t, fields); i < end; i = json_skip(t, i))
+    {
+        if (t[i].type != JSON_ARRAY || t[i].size != 2 ||
+            t[i + 1].type != JSON_STRING || t[i + 2].type != JSON_OBJECT)
+            goto done;
+
+        long long nth = -1;
+        long long type_code = -1;
+        int serialized = 1;
+        for (int j = i + 3, field_end = json_skip(t, i + 2); j < field_end; j = json_skip(t, j + 1))
+        {
+            struct json_token* v = &t[j + 1];
+            if (json_eq(js, &t[j], "nth"))
+                json_int(js, v, &nth);
+            else if (json_eq(js, &t[j], "isSerialized"))
+                serialized = (v->end - v->start == 4 && memcmp(js + v->start, "true", 4) == 0);
+            else if (json_eq(js, &t[j], "type") && v->type == JSON_STRING)
+            {
+                for (int k = types + 1, types_end = json_skip(t, types); k < types_end; k = json_skip(t, k + 1))
+                    if (t[k].end - t[k].start == v->end - v->start &&
+                        memcmp(js + t[k].start, js + v->start, v->end - v->start) == 0)
+                        json_int(js, &t[k + 1], &type_code);
+            }
+        }
+
+        if (serialized &&
+            !definitions_field(d, type_code, nth, js + t[i + 1].start, t[i + 1].end - t[i + 1].start))
+            goto done;
+    }
+
+    if ((transaction_types >= 0 &&
+            !definitions_json_codes(d, d->transaction_types, js, t, transaction_types)) ||
+        (ledger_entry_types >= 0 &&
+            !definitions_json_codes(d, d->ledger_entry_types, js, t, ledger_entry_types)) ||
+        (transaction_results >= 0 &&
+            !definitions_json_codes(d, d->transaction_results, js, t, transaction_results)))
+        goto done;
+
+    ok = 1;
+
+done:
+    free(t);
+    munmap(js, st.st_size);
+    return ok;
+}
+
+int definitions_save(const struct definitions* d, const char* path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return 0;
+
+    const uint8_t* p = (const uint8_t*)d;
+    size_t remaining = sizeof(*d);
+    while (remaining > 0)
+    {
+        ssize_t written = write(fd, p, remaining);
+        if (written <= 0)
+        {
+            close(fd);
+            return 0;
+        }
+        p += written;
+        remaining -= written;
+    }
+
+    return close(fd) == 0;
+}
+
+// a cache file is trusted only as far as every index and string in it stays in bounds
+static int definitions_valid(const struct definitions* d)
+{
+    if (memcmp(d->magic, DEFINITIONS_MAGIC, sizeof(d->magic)) != 0 || d->size != sizeof(*d) ||
+        d->rows_used > DEFINITIONS_MAX_ROWS || d->strings_used > DEFINITIONS_STRINGS_SIZE)
+        return 0;
+
+    for (int i = 0; i < 256; ++i)
+        if (d->type_row[i] != 0xFFU && d->type_row[i] >= d->rows_used)
+            return 0;
+
+    const struct definitions_name* names = &d->field_keys[0][0];
+    int name_count = (sizeof(d->field_keys) + sizeof(d->transaction_types) +
+            sizeof(d->ledger_entry_types) + sizeof(d->transaction_results)) / sizeof(*names);
+    for (int i = 0; i < name_count; ++i)
+        if (names[i].offset && (names[i].offset >= d->strings_used ||
+                names[i].len >= d->strings_used - names[i].offset))
+            return 0;
+
+    return 1;
+}
+
+const struct definitions* definitions_map(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size != sizeof(struct definitions))
+    {
+        close(fd);
+        return 0;
+    }
+
+    const struct definitions* d = mmap(0, sizeof(*d), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (d == MAP_FAILED)
+        return 0;
+
+    if (!definitions_valid(d))
+    {
+        munmap((void*)d, sizeof(*d));
+        return 0;
+    }
+
+    return d;
+}
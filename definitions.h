@@ -0,0 +1,350 @@
+/**
+ * XRPL type, field, transaction type, ledger entry type and transaction result definitions
+ * The lists below are the builtin definitions, each is an X-macro expanded with a macro taking the listed arguments
+ * TYPE(type_code, name), FIELD(type_code, field_code, name)
+ * TRANSACTION_TYPE(code, name), LEDGER_ENTRY_TYPE(code, name), TRANSACTION_RESULT(code, name)
+ *
+ * At runtime a context decodes against the struct definitions in xd_ctx.definitions, which is built from these lists,
+ * loaded from a rippled style definitions.json or mmapped from a cache file written by definitions_save()
+ */
+#ifndef DEFINITIONS_H
+#define DEFINITIONS_H
+
+#include <stdint.h>
+
+#define DEFINITIONS_MAGIC "XDDEFS01"
+#define DEFINITIONS_MAX_ROWS 32
+#define DEFINITIONS_STRINGS_SIZE (64*1024)
+
+enum type_kind
+{
+    KIND_UNKNOWN = 0,
+    KIND_UINT,
+    KIND_HASH,
+    KIND_AMOUNT,
+    KIND_BLOB,
+    KIND_ACCOUNT,
+    KIND_OBJECT,
+    KIND_ARRAY,
+    KIND_PATHSET,
+    KIND_VECTOR256
+};
+
+// offset and length of a string in definitions.strings, offset 0 means not defined
+struct definitions_name
+{
+    uint32_t offset;
+    uint32_t len;
+};
+
+// flat and pointer free so it can be written out and mmapped back as is
+struct definitions
+{
+    char magic[8];
+    uint32_t size;
+    uint32_t strings_used;
+    uint8_t type_kind[256];     // by type_code
+    uint8_t type_size[256];     // fixed size in bytes, 0 for variable length types
+    uint8_t type_row[256];      // row of field_keys for the type_code, 0xFF if the type has no fields
+    uint8_t rows_used;
+    uint8_t reserved[7];
+    struct definitions_name field_keys[DEFINITIONS_MAX_ROWS][256];  // "Name": , by type row then field_code
+    struct definitions_name transaction_types[256];                 // "Name", by code
+    struct definitions_name ledger_entry_types[256];
+    struct definitions_name transaction_results[256];
+    char strings[DEFINITIONS_STRINGS_SIZE];
+};
+
+#define DEFINITIONS_STR(d, name) ((d)->strings + (name).offset)
+
+static inline const struct definitions_name* definitions_field_key(
+        const struct definitions* d, int type_code, int field_code)
+{
+    uint8_t row = d->type_row[type_code];
+    return (row == 0xFFU ? 0 : &d->field_keys[row][field_code]);
+}
+
+// field_id (type_code << 16 | field_code) of the field called `name`, 0 if there is none
+uint32_t definitions_field_id(const struct definitions* d, const char* name, int name_len);
+
+// field_ids of a dotted path of field names like "AffectedNodes.ModifiedNode.Balance", returns how many or 0 if
+// a name is unknown or there are more than `max_ids` of them
+int definitions_field_path(const struct definitions* d, const char* path, int path_len, uint32_t* ids, int max_ids);
+
+// code of `name` in one of the transaction_types, ledger_entry_types or transaction_results tables, -1 if missing
+int definitions_find_code(const struct definitions* d, const struct definitions_name* table,
+        const char* name, int name_len);
+
+// fill `d` from the builtin lists
+void definitions_builtin(struct definitions* d);
+
+// fill `d` from a rippled style definitions.json, returns 0 on failure
+int definitions_load_json(struct definitions* d, const char* path);
+
+// write `d` out as a cache file, returns 0 on failure
+int definitions_save(const struct definitions* d, const char* path);
+
+// mmap a cache file written by definitions_save(), returns 0 if it is missing or stale
+const struct definitions* definitions_map(const char* path);
+
+#define XD_TYPES(TYPE)\
+    TYPE(1, "UInt16")\
+    TYPE(2, "UInt32")\
+    TYPE(3, "UInt64")\
+    TYPE(4, "Hash128")\
+    TYPE(5, "Hash256")\
+    TYPE(6, "Amount")\
+    TYPE(7, "Blob")\
+    TYPE(8, "AccountID")\
+    TYPE(14, "STObject")\
+    TYPE(15, "STArray")\
+    TYPE(16, "UInt8")\
+    TYPE(17, "Hash160")\
+    TYPE(18, "PathSet")\
+    TYPE(19, "Vector256")
+
+#define XD_FIELDS(FIELD)\
+    FIELD(16, 1, "CloseResolution")\
+    FIELD(16, 2, "Method")\
+    FIELD(16, 3, "TransactionResult")\
+    FIELD(16, 16, "TickSize")\
+    FIELD(16, 17, "UNLModifyDisabling")\
+    FIELD(1, 1, "LedgerEntryType")\
+    FIELD(1, 2, "TransactionType")\
+    FIELD(1, 3, "SignerWeight")\
+    FIELD(1, 16, "Version")\
+    FIELD(2, 2, "Flags")\
+    FIELD(2, 3, "SourceTag")\
+    FIELD(2, 4, "Sequence")\
+    FIELD(2, 5, "PreviousTxnLgrSeq")\
+    FIELD(2, 6, "LedgerSequence")\
+    FIELD(2, 7, "CloseTime")\
+    FIELD(2, 8, "ParentCloseTime")\
+    FIELD(2, 9, "SigningTime")\
+    FIELD(2, 10, "Expiration")\
+    FIELD(2, 11, "erRate")\
+    FIELD(2, 12, "WalletSize")\
+    FIELD(2, 13, "OwnerCount")\
+    FIELD(2, 14, "DestinationTag")\
+    FIELD(2, 16, "HighQualityIn")\
+    FIELD(2, 17, "HighQualityOut")\
+    FIELD(2, 18, "LowQualityIn")\
+    FIELD(2, 19, "LowQualityOut")\
+    FIELD(2, 20, "QualityIn")\
+    FIELD(2, 21, "QualityOut")\
+    FIELD(2, 22, "StampEscrow")\
+    FIELD(2, 23, "BondAmount")\
+    FIELD(2, 24, "LoadFee")\
+    FIELD(2, 25, "OfferSequence")\
+    FIELD(2, 26, "FirstLedgerSequence")\
+    FIELD(2, 27, "LastLedgerSequence")\
+    FIELD(2, 28, "TransactionIndex")\
+    FIELD(2, 29, "OperationLimit")\
+    FIELD(2, 30, "ReferenceFeeUnits")\
+    FIELD(2, 31, "ReserveBase")\
+    FIELD(2, 32, "ReserveIncrement")\
+    FIELD(2, 33, "SetFlag")\
+    FIELD(2, 34, "ClearFlag")\
+    FIELD(2, 35, "SignerQuorum")\
+    FIELD(2, 36, "CancelAfter")\
+    FIELD(2, 37, "FinishAfter")\
+    FIELD(2, 38, "SignerListID")\
+    FIELD(2, 39, "SettleDelay")\
+    FIELD(2, 40, "HookStateCount")\
+    FIELD(2, 41, "HookReserveCount")\
+    FIELD(2, 42, "HookDataMaxSize")\
+    FIELD(2, 43, "EmitGeneration")\
+    FIELD(3, 1, "IndexNext")\
+    FIELD(3, 2, "IndexPrevious")\
+    FIELD(3, 3, "BookNode")\
+    FIELD(3, 4, "OwnerNode")\
+    FIELD(3, 5, "BaseFee")\
+    FIELD(3, 6, "ExchangeRate")\
+    FIELD(3, 7, "LowNode")\
+    FIELD(3, 8, "HighNode")\
+    FIELD(3, 9, "DestinationNode")\
+    FIELD(3, 10, "Cookie")\
+    FIELD(3, 11, "ServerVersion")\
+    FIELD(3, 12, "EmitBurden")\
+    FIELD(3, 16, "HookOn")\
+    FIELD(4, 1, "EmailHash")\
+    FIELD(17, 1, "TakerPaysCurrency")\
+    FIELD(17, 2, "TakerPaysIssuer")\
+    FIELD(17, 3, "TakerGetsCurrency")\
+    FIELD(17, 4, "TakerGetsIssuer")\
+    FIELD(5, 1, "LedgerHash")\
+    FIELD(5, 2, "ParentHash")\
+    FIELD(5, 3, "TransactionHash")\
+    FIELD(5, 4, "AccountHash")\
+    FIELD(5, 5, "PreviousTxnID")\
+    FIELD(5, 6, "LedgerIndex")\
+    FIELD(5, 7, "WalletLocator")\
+    FIELD(5, 8, "RootIndex")\
+    FIELD(5, 9, "AccountTxnID")\
+    FIELD(5, 10, "EmitParentTxnID")\
+    FIELD(5, 11, "EmitNonce")\
+    FIELD(5, 16, "BookDirectory")\
+    FIELD(5, 17, "InvoiceID")\
+    FIELD(5, 18, "Nickname")\
+    FIELD(5, 19, "Amendment")\
+    FIELD(5, 20, "TicketID")\
+    FIELD(5, 21, "Digest")\
+    FIELD(5, 22, "PayChannel")\
+    FIELD(5, 23, "ConsensusHash")\
+    FIELD(5, 24, "CheckID")\
+    FIELD(5, 25, "ValidatedHash")\
+    FIELD(6, 1, "Amount")\
+    FIELD(6, 2, "Balance")\
+    FIELD(6, 3, "LimitAmount")\
+    FIELD(6, 4, "TakerPays")\
+    FIELD(6, 5, "TakerGets")\
+    FIELD(6, 6, "LowLimit")\
+    FIELD(6, 7, "HighLimit")\
+    FIELD(6, 8, "Fee")\
+    FIELD(6, 9, "SendMax")\
+    FIELD(6, 10, "DeliverMin")\
+    FIELD(6, 16, "MinimumOffer")\
+    FIELD(6, 17, "RippleEscrow")\
+    FIELD(6, 18, "DeliveredAmount")\
+    FIELD(7, 1, "PublicKey")\
+    FIELD(7, 2, "MessageKey")\
+    FIELD(7, 3, "SigningPubKey")\
+    FIELD(7, 4, "TxnSignature")\
+    FIELD(7, 6, "Signature")\
+    FIELD(7, 7, "Domain")\
+    FIELD(7, 8, "FundCode")\
+    FIELD(7, 9, "RemoveCode")\
+    FIELD(7, 10, "ExpireCode")\
+    FIELD(7, 11, "CreateCode")\
+    FIELD(7, 12, "MemoType")\
+    FIELD(7, 13, "MemoData")\
+    FIELD(7, 14, "MemoFormat")\
+    FIELD(7, 16, "Fulfillment")\
+    FIELD(7, 17, "Condition")\
+    FIELD(7, 18, "MasterSignature")\
+    FIELD(7, 19, "UNLModifyValidator")\
+    FIELD(7, 20, "NegativeUNLToDisable")\
+    FIELD(7, 21, "NegativeUNLToReEnable")\
+    FIELD(7, 22, "HookData")\
+    FIELD(8, 1, "Account")\
+    FIELD(8, 2, "Owner")\
+    FIELD(8, 3, "Destination")\
+    FIELD(8, 4, "Issuer")\
+    FIELD(8, 5, "Authorize")\
+    FIELD(8, 6, "Unauthorize")\
+    FIELD(8, 7, "Target")\
+    FIELD(8, 8, "RegularKey")\
+    FIELD(18, 1, "Paths")\
+    FIELD(19, 1, "Indexes")\
+    FIELD(19, 2, "Hashes")\
+    FIELD(19, 3, "Amendments")\
+    FIELD(14, 2, "TransactionMetaData")\
+    FIELD(14, 3, "CreatedNode")\
+    FIELD(14, 4, "DeletedNode")\
+    FIELD(14, 5, "ModifiedNode")\
+    FIELD(14, 6, "PreviousFields")\
+    FIELD(14, 7, "FinalFields")\
+    FIELD(14, 8, "NewFields")\
+    FIELD(14, 9, "TemplateEntry")\
+    FIELD(14, 10, "Memo")\
+    FIELD(14, 11, "SignerEntry")\
+    FIELD(14, 12, "EmitDetails")\
+    FIELD(14, 16, "Signer")\
+    FIELD(14, 18, "Majority")\
+    FIELD(14, 19, "NegativeUNLEntry")\
+    FIELD(15, 2, "SigningAccounts")\
+    FIELD(15, 3, "Signers")\
+    FIELD(15, 4, "SignerEntries")\
+    FIELD(15, 5, "Template")\
+    FIELD(15, 6, "Necessary")\
+    FIELD(15, 7, "Sufficient")\
+    FIELD(15, 8, "AffectedNodes")\
+    FIELD(15, 9, "Memos")\
+    FIELD(15, 16, "Majorities")\
+    FIELD(15, 17, "NegativeUNL")
+
+#define XD_TRANSACTION_TYPES(TRANSACTION_TYPE)\
+    TRANSACTION_TYPE(21, "AccountDelete")\
+    TRANSACTION_TYPE(3, "AccountSet")\
+    TRANSACTION_TYPE(18, "CheckCancel")\
+    TRANSACTION_TYPE(17, "CheckCash")\
+    TRANSACTION_TYPE(16, "CheckCreate")\
+    TRANSACTION_TYPE(9, "Contract")\
+    TRANSACTION_TYPE(19, "DepositPreauth")\
+    TRANSACTION_TYPE(100, "EnableAmendment")\
+    TRANSACTION_TYPE(4, "EscrowCancel")\
+    TRANSACTION_TYPE(1, "EscrowCreate")\
+    TRANSACTION_TYPE(2, "EscrowFinish")\
+    TRANSACTION_TYPE(6, "NickNameSet")\
+    TRANSACTION_TYPE(8, "OfferCancel")\
+    TRANSACTION_TYPE(7, "OfferCreate")\
+    TRANSACTION_TYPE(0, "Payment")\
+    TRANSACTION_TYPE(15, "PaymentChannelClaim")\
+    TRANSACTION_TYPE(13, "PaymentChannelCreate")\
+    TRANSACTION_TYPE(14, "PaymentChannelFund")\
+    TRANSACTION_TYPE(101, "SetFee")\
+    TRANSACTION_TYPE(5, "SetRegularKey")\
+    TRANSACTION_TYPE(12, "SignerListSet")\
+    TRANSACTION_TYPE(11, "TicketCancel")\
+    TRANSACTION_TYPE(10, "TicketCreate")\
+    TRANSACTION_TYPE(20, "TrustSet")\
+    TRANSACTION_TYPE(102, "UNLModify")
+
+#define XD_LEDGER_ENTRY_TYPES(LEDGER_ENTRY_TYPE)\
+    LEDGER_ENTRY_TYPE('a', "AccountRoot")\
+    LEDGER_ENTRY_TYPE('f', "Ammendments")\
+    LEDGER_ENTRY_TYPE('C', "Check")\
+    LEDGER_ENTRY_TYPE('p', "DepositPreauth")\
+    LEDGER_ENTRY_TYPE('d', "DirectoryNode")\
+    LEDGER_ENTRY_TYPE('u', "Escrow")\
+    LEDGER_ENTRY_TYPE('s', "FeeSettings")\
+    LEDGER_ENTRY_TYPE('h', "LedgerHashes")\
+    LEDGER_ENTRY_TYPE('N', "NegativeUNL")\
+    LEDGER_ENTRY_TYPE('o', "Offer")\
+    LEDGER_ENTRY_TYPE('x', "PayChan")\
+    LEDGER_ENTRY_TYPE('r', "RippleState")\
+    LEDGER_ENTRY_TYPE('S', "SignerList")\
+    LEDGER_ENTRY_TYPE('T', "Ticket")
+
+#define XD_TRANSACTION_RESULTS(TRANSACTION_RESULT)\
+    TRANSACTION_RESULT(100, "tecCLAIM")\
+    TRANSACTION_RESULT(146, "tecCRYPTOCONDITION_ERROR")\
+    TRANSACTION_RESULT(121, "tecDIR_FULL")\
+    TRANSACTION_RESULT(143, "tecDST_TAG_NEEDED")\
+    TRANSACTION_RESULT(149, "tecDUPLICATE")\
+    TRANSACTION_RESULT(148, "tecEXPIRED")\
+    TRANSACTION_RESULT(105, "tecFAILED_PROCESSING")\
+    TRANSACTION_RESULT(137, "tecFROZEN")\
+    TRANSACTION_RESULT(151, "tecHAS_OBLIGATIONS")\
+    TRANSACTION_RESULT(136, "tecINSUFF_FEE")\
+    TRANSACTION_RESULT(141, "tecINSUFFICIENT_RESERVE")\
+    TRANSACTION_RESULT(122, "tecINSUF_RESERVE_LINE")\
+    TRANSACTION_RESULT(123, "tecINSUF_RESERVE_OFFER")\
+    TRANSACTION_RESULT(144, "tecINTERNAL")\
+    TRANSACTION_RESULT(147, "tecINVARIANT_FAILED")\
+    TRANSACTION_RESULT(150, "tecKILLED")\
+    TRANSACTION_RESULT(142, "tecNEED_MASTER_KEY")\
+    TRANSACTION_RESULT(130, "tecNO_ALTERNATIVE_KEY")\
+    TRANSACTION_RESULT(134, "tecNO_AUTH")\
+    TRANSACTION_RESULT(124, "tecNO_DST")\
+    TRANSACTION_RESULT(125, "tecNO_DST_INSUF_XRP")\
+    TRANSACTION_RESULT(140, "tecNO_ENTRY")\
+    TRANSACTION_RESULT(133, "tecNO_ISSUER")\
+    TRANSACTION_RESULT(135, "tecNO_LINE")\
+    TRANSACTION_RESULT(126, "tecNO_LINE_INSUF_RESERVE")\
+    TRANSACTION_RESULT(127, "tecNO_LINE_REDUNDANT")\
+    TRANSACTION_RESULT(139, "tecNO_PERMISSION")\
+    TRANSACTION_RESULT(131, "tecNO_REGULAR_KEY")\
+    TRANSACTION_RESULT(138, "tecNO_TARGET")\
+    TRANSACTION_RESULT(145, "tecOVERSIZE")\
+    TRANSACTION_RESULT(132, "tecOWNERS")\
+    TRANSACTION_RESULT(128, "tecPATH_DRY")\
+    TRANSACTION_RESULT(101, "tecPATH_PARTIAL")\
+    TRANSACTION_RESULT(152, "tecTOO_SOON")\
+    TRANSACTION_RESULT(129, "tecUNFUNDED")\
+    TRANSACTION_RESULT(102, "tecUNFUNDED_ADD")\
+    TRANSACTION_RESULT(103, "tecUNFUNDED_OFFER")\
+    TRANSACTION_RESULT(104, "tecUNFUNDED_PAYMENT")\
+    TRANSACTION_RESULT(0, "tesSUCCESS")
+
+#endif
@@ -0,0 +1,625 @@
+/**
+ * JSON -> XRPL binary encoder, see encode.h
+ * The JSON is tokenized in place by json.c, then each object's fields are sorted by field_id (type code << 16 |
+ * field code is the canonical order) and written out depth first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "encode.h"
+#include "hex.h"
+#include "libbase58.h"
+#include "sha-256.h"
+#include "xd.h"
+
+// which table an encode_name is from
+#define NAME_FIELD 0
+#define NAME_TRANSACTION_TYPE 1
+#define NAME_LEDGER_ENTRY_TYPE 2
+#define NAME_TRANSACTION_RESULT 3
+
+#define PATH_ACCOUNT 0x01U
+#define PATH_CURRENCY 0x10U
+#define PATH_ISSUER 0x20U
+#define PATH_NEXT 0xFFU
+#define PATH_END 0x00U
+
+#define IOU_MIN_MANTISSA 1000000000000000ULL     // 10^15
+#define IOU_MAX_MANTISSA 9999999999999999ULL
+#define IOU_MIN_EXPONENT -96
+#define IOU_MAX_EXPONENT 80
+#define XRP_MAX_DROPS 100000000000000000ULL     // 10^17
+
+static uint32_t name_hash(int table, const char* name, int len)
+{
+    uint32_t h = 2166136261U ^ (uint32_t)table;
+    for (int i = 0; i < len; ++i)
+        h = (h ^ (uint8_t)name[i]) * 16777619U;
+    return h;
+}
+
+static struct encode_name* name_slot(const struct encoder* e, int table, const char* name, int len)
+{
+    for (uint32_t slot = name_hash(table, name, len);; slot++)
+    {
+        struct encode_name* n = &e->names[slot & (e->name_slots - 1)];
+        if (!n->name || (n->table == table && n->len == len && memcmp(n->name, name, len) == 0))
+            return n;
+    }
+}
+
+static void name_add(struct encoder* e, int table, const char* name, int len, uint32_t value)
+{
+    struct encode_name* n = name_slot(e, table, name, len);
+    // the first of a repeated name wins, as in definitions_field_id
+    if (n->name)
+        return;
+    n->name = name;
+    n->len = len;
+    n->table = table;
+    n->value = value;
+}
+
+// the name's field_id or code, -1 if there is none
+static int64_t name_find(const struct encoder* e, int table, const char* name, int len)
+{
+    const struct encode_name* n = name_slot(e, table, name, len);
+    return (n->name ? (int64_t)n->value : -1);
+}
+
+int encode_init(struct encoder* e, const struct definitions* definitions)
+{
+    memset(e, 0, sizeof(*e));
+    e->definitions = definitions;
+
+    // a fifth of the slots used at most: every field and code fits with room to spare
+    e->name_slots = 8192;
+    if (!(e->names = calloc(e->name_slots, sizeof(*e->names))))
+        return 0;
+
+    // keys are stored as `"Name": `
+    for (int type_code = 1; type_code < 256; ++type_code)
+        for (int field_code = 1; field_code < 256; ++field_code)
+        {
+            const struct definitions_name* key = definitions_field_key(definitions, type_code, field_code);
+            if (key && key->offset)
+                name_add(e, NAME_FIELD, DEFINITIONS_STR(definitions, *key) + 1, key->len - 4,
+                        ((uint32_t)type_code << 16U) + field_code);
+        }
+
+    // codes are stored as `"Name"`
+    const struct definitions_name* tables[] = { 0, definitions->transaction_types,
+        definitions->ledger_entry_types, definitions->transaction_results };
+    for (int table = NAME_TRANSACTION_TYPE; table <= NAME_TRANSACTION_RESULT; ++table)
+        for (int code = 0; code < 256; ++code)
+            if (tables[table][code].offset)
+                name_add(e, table, DEFINITIONS_STR(definitions, tables[table][code]) + 1,
+                        tables[table][code].len - 2, code);
+    return 1;
+}
+
+void encode_free(struct encoder* e)
+{
+    free(e->names);
+    free(e->tokens);
+    free(e->output);
+    memset(e, 0, sizeof(*e));
+}
+
+// record a failure, returns 0 so the encoding functions can `return encode_fail(...)`
+static int encode_fail(struct encoder* e, int code, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    e->error = code;
+    vsnprintf(e->error_message, sizeof(e->error_message), format, args);
+    va_end(args);
+    return 0;
+}
+
+// a token's text, for messages
+#define TOKEN_TEXT(t) ((t)->end - (t)->start > 64 ? 64 : (t)->end - (t)->start), e->json + (t)->start
+
+static uint8_t* reserve(struct encoder* e, size_t len)
+{
+    if (e->output_len + len > e->output_capacity)
+    {
+        size_t capacity = (e->output_capacity ? e->output_capacity * 2 : 4096);
+        while (capacity < e->output_len + len)
+            capacity *= 2;
+        uint8_t* grown = realloc(e->output, capacity);
+        if (!grown)
+            return (encode_fail(e, XD_ERR_MEMORY, "Error: could not grow the output buffer"), (uint8_t*)0);
+        e->output = grown;
+        e->output_capacity = capacity;
+    }
+    return e->output + e->output_len;
+}
+
+static int put(struct encoder* e, const void* data, size_t len)
+{
+    uint8_t* out = reserve(e, len);
+    if (!out)
+        return 0;
+    memcpy(out, data, len);
+    e->output_len += len;
+    return 1;
+}
+
+static int put_byte(struct encoder* e, uint8_t byte)
+{
+    return put(e, &byte, 1);
+}
+
+// the 1 to 3 byte field header, the reverse of the decoder's
+static int put_header(struct encoder* e, int type_code, int field_code)
+{
+    uint8_t header[3];
+    int len = 0;
+    if (type_code < 16 && field_code < 16)
+        header[len++] = (uint8_t)((type_code << 4U) | field_code);
+    else if (type_code < 16)
+    {
+        header[len++] = (uint8_t)(type_code << 4U);
+        header[len++] = (uint8_t)field_code;
+    }
+    else if (field_code < 16)
+    {
+        header[len++] = (uint8_t)field_code;
+        header[len++] = (uint8_t)type_code;
+    }
+    else
+    {
+        header[len++] = 0;
+        header[len++] = (uint8_t)type_code;
+        header[len++] = (uint8_t)field_code;
+    }
+    return put(e, header, len);
+}
+
+// the 1 to 3 byte VL length prefix
+static int put_vl(struct encoder* e, size_t len)
+{
+    uint8_t prefix[3];
+    if (len <= 192)
+        return put_byte(e, (uint8_t)len);
+    if (len <= 12480)
+    {
+        len -= 193;
+        prefix[0] = (uint8_t)(193 + (len >> 8U));
+        prefix[1] = (uint8_t)len;
+        return put(e, prefix, 2);
+    }
+    if (len <= 918744)
+    {
+        len -= 12481;
+        prefix[0] = (uint8_t)(241 + (len >> 16U));
+        prefix[1] = (uint8_t)(len >> 8U);
+        prefix[2] = (uint8_t)len;
+        return put(e, prefix, 3);
+    }
+    return encode_fail(e, XD_ERR_OVERSIZE, "Error: %zu bytes is too long for a VL field", len);
+}
+
+// a hex string of exactly `len` bytes, any length when `len` is -1
+static int put_hex(struct encoder* e, const struct json_token* t, int len, int vl)
+{
+    int text_len = t->end - t->start;
+    if (t->type != JSON_STRING || text_len % 2 != 0 || (len >= 0 && text_len != len * 2))
+    {
+        if (len < 0)
+            return encode_fail(e, XD_ERR_INPUT, "Error: `%.*s` is not hex", TOKEN_TEXT(t));
+        return encode_fail(e, XD_ERR_INPUT, "Error: `%.*s` is not %d bytes of hex", TOKEN_TEXT(t), len);
+    }
+    if (vl && !put_vl(e, text_len / 2))
+        return 0;
+
+    uint8_t* out = reserve(e, text_len / 2);
+    int carry = -1;
+    if (!out)
+        return 0;
+    if (hex_decode(out, (const uint8_t*)e->json + t->start, text_len, &carry) != text_len / 2)
+        return encode_fail(e, XD_ERR_INPUT, "Error: `%.*s` is not hex", TOKEN_TEXT(t));
+    e->output_len += text_len / 2;
+    return 1;
+}
+
+// an r-address into its 20 byte AccountID, the checksum is checked
+static int read_address(struct encoder* e, const struct json_token* t, uint8_t* id)
+{
+    uint8_t decoded[25];
+    size_t decoded_len = sizeof(decoded);
+    uint8_t check[32];
+    if (t->type != JSON_STRING || t->end - t->start > 35 ||
+            !b58tobin(decoded, &decoded_len, e->json + t->start, t->end - t->start) ||
+            decoded_len != sizeof(decoded) || decoded[0] != 0)
+        return encode_fail(e, XD_ERR_ENCODE, "Error: `%.*s` is not an r-address", TOKEN_TEXT(t));
+
+    calc_sha_256(check, decoded, 21);
+    calc_sha_256(check, check, 32);
+    if (memcmp(check, decoded + 21, 4) != 0)
+        return encode_fail(e, XD_ERR_ENCODE, "Error: `%.*s` has a bad checksum", TOKEN_TEXT(t));
+    memcpy(id, decoded + 1, 20);
+    return 1;
+}
+
+static int put_address(struct encoder* e, const struct json_token* t)
+{
+    uint8_t id[20];
+    return read_address(e, t, id) && put(e, id, 20);
+}
+
+// 3 letter ISO code (XRP for all zeros, as the decoder writes it) or 40 hex digits
+static int put_currency(struct encoder* e, const struct json_token* t)
+{
+    uint8_t currency[20] = { 0 };
+    int len = t->end - t->start;
+    if (t->type == JSON_STRING && len == 40)
+        return put_hex(e, t, 20, 0);
+    if (t->type != JSON_STRING || len != 3)
+        return encode_fail(e, XD_ERR_INPUT, "Error: `%.*s` is not a currency code", TOKEN_TEXT(t));
+    if (memcmp(e->json + t->start, "XRP", 3) != 0)
+        memcpy(currency + 12, e->json + t->start, 3);
+    return put(e, currency, 20);
+}
+
+// unsigned decimal, returns 0 if it isn't one or is more than `max`
+static int read_uint(const char* s, int len, uint64_t max, uint64_t* value)
+{
+    *value = 0;
+    if (len <= 0 || len > 20)
+        return 0;
+    for (int i = 0; i < len; ++i)
+    {
+        if (s[i] < '0' || s[i] > '9')
+            return 0;
+        uint64_t digit = s[i] - '0';
+        if (*value > (max - digit) / 10)
+            return 0;
+        *value = *value * 10 + digit;
+    }
+    return 1;
+}
+
+// decimal text like "-1.5", "0.0001" or "1.5e-20" as mantissa * 10^exponent, digits past the 19th are dropped
+static int read_decimal(const char* s, int len, uint64_t* mantissa, int* exponent, int* negative)
+{
+    int i = 0;
+    int digits = 0;
+    int point = 0;
+    *mantissa = 0;
+    *exponent = 0;
+    *negative = (len > 0 && s[0] == '-');
+    if (len > 0 && (s[0] == '-' || s[0] == '+'))
+        i++;
+
+    for (; i < len; ++i)
+    {
+        if (s[i] == '.' && !point)
+        {
+            point = 1;
+            continue;
+        }
+        if (s[i] < '0' || s[i] > '9')
+            break;
+        digits++;
+        if (*mantissa < 1000000000000000000ULL)
+        {
+            *mantissa = *mantissa * 10 + (s[i] - '0');
+            *exponent -= point;
+        }
+        else
+            *exponent += !point;
+    }
+    if (digits == 0)
+        return 0;
+
+    if (i < len && (s[i] == 'e' || s[i] == 'E'))
+    {
+        int exponent_negative = (i + 1 < len && s[i + 1] == '-');
+        i += 1 + (i + 1 < len && (s[i + 1] == '-' || s[i + 1] == '+'));
+        uint64_t e = 0;
+        if (!read_uint(s + i, len - i, 100000, &e))
+            return 0;
+        *exponent += (exponent_negative ? -(int)e : (int)e);
+        i = len;
+    }
+    return i == len;
+}
+
+// drops in a string (or a number) for XRP, {value, currency, issuer} for an IOU
+static int put_amount(struct encoder* e, int i)
+{
+    const struct json_token* t = &e->tokens[i];
+    uint8_t bytes[8];
+
+    if (t->type == JSON_STRING || t->type == JSON_PRIMITIVE)
+    {
+        const char* s = e->json + t->start;
+        int len = t->end - t->start;
+        int negative = (len > 0 && s[0] == '-');
+        uint64_t drops = 0;
+        if (!read_uint(s + negative, len - negative, XRP_MAX_DROPS, &drops))
+            return encode_fail(e, XD_ERR_AMOUNT, "Error: `%.*s` is not an amount of drops", TOKEN_TEXT(t));
+        // bit 62 is set for a positive amount
+        uint64_t value = drops | (negative ? 0 : 0x4000000000000000ULL);
+        for (int b = 0; b < 8; ++b)
+            bytes[b] = (uint8_t)(value >> ((7 - b) * 8U));
+        return put(e, bytes, 8);
+    }
+
+    if (t->type != JSON_OBJECT)
+        return encode_fail(e, XD_ERR_AMOUNT, "Error: `%.*s` is not an amount", TOKEN_TEXT(t));
+
+    const struct json_token* parts[3] = { 0 };
+    static const char* part_names[3] = { "value", "currency", "issuer" };
+    for (int k = i + 1, pair = 0; pair < t->size / 2; ++pair, k = json_skip(e->tokens, k + 1))
+    {
+        int found = 0;
+        for (int p = 0; p < 3; ++p)
+            if (json_eq(e->json, &e->tokens[k], part_names[p]))
+            {
+                parts[p] = &e->tokens[k + 1];
+                found = 1;
+            }
+        if (!found)
+            return encode_fail(e, XD_ERR_AMOUNT, "Error: unknown amount key `%.*s`", TOKEN_TEXT(&e->tokens[k]));
+    }
+    if (!parts[0] || !parts[1] || !parts[2])
+        return encode_fail(e, XD_ERR_AMOUNT, "Error: an IOU amount needs value, currency and issuer");
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int negative = 0;
+    if (!read_decimal(e->json + parts[0]->start, parts[0]->end - parts[0]->start, &mantissa, &exponent, &negative))
+        return encode_fail(e, XD_ERR_AMOUNT, "Error: `%.*s` is not a decimal value", TOKEN_TEXT(parts[0]));
+
+    // normalized to a 16 digit mantissa, anything too small to hold is zero
+    uint64_t value = 0x8000000000000000ULL;
+    if (mantissa != 0)
+    {
+        while (mantissa < IOU_MIN_MANTISSA)
+        {
+            mantissa *= 10;
+            exponent--;
+        }
+        while (mantissa > IOU_MAX_MANTISSA)
+        {
+            mantissa /= 10;
+            exponent++;
+        }
+        if (exponent > IOU_MAX_EXPONENT)
+            return encode_fail(e, XD_ERR_AMOUNT, "Error: `%.*s` is too large", TOKEN_TEXT(parts[0]));
+        if (exponent >= IOU_MIN_EXPONENT)
+            value |= (negative ? 0 : 0x4000000000000000ULL) | ((uint64_t)(exponent + 97) << 54U) | mantissa;
+    }
+    for (int b = 0; b < 8; ++b)
+        bytes[b] = (uint8_t)(value >> ((7 - b) * 8U));
+    return put(e, bytes, 8) && put_currency(e, parts[1]) && put_address(e, parts[2]);
+}
+
+// a number, the name of a code for the three named fields, or rippled's hex for a UInt64
+static int put_uint(struct encoder* e, uint32_t field_id, int size, const struct json_token* t)
+{
+    const char* s = e->json + t->start;
+    int len = t->end - t->start;
+    uint64_t value = 0;
+    uint64_t max = (size == 8 ? UINT64_MAX : (1ULL << (size * 8U)) - 1);
+
+    if (t->type == JSON_STRING)
+    {
+        int table = (field_id == 0x10002U ? NAME_TRANSACTION_TYPE : field_id == 0x10001U ? NAME_LEDGER_ENTRY_TYPE :
+                     field_id == 0x100003U ? NAME_TRANSACTION_RESULT : -1);
+        int64_t code = (table >= 0 ? name_find(e, table, s, len) : -1);
+        if (code >= 0)
+            value = code;
+        else if (size == 8)
+            return put_hex(e, t, 8, 0);
+        else
+            return encode_fail(e, XD_ERR_INPUT, "Error: unknown code `%.*s`", TOKEN_TEXT(t));
+    }
+    else if (t->type != JSON_PRIMITIVE || !read_uint(s, len, max, &value))
+        return encode_fail(e, XD_ERR_INPUT, "Error: `%.*s` is not a UInt%d", TOKEN_TEXT(t), size * 8);
+
+    uint8_t bytes[8];
+    for (int b = 0; b < size; ++b)
+        bytes[b] = (uint8_t)(value >> ((size - 1 - b) * 8U));
+    return put(e, bytes, size);
+}
+
+// arrays of paths, each an array of steps with any of account, currency and issuer
+static int put_pathset(struct encoder* e, int i)
+{
+    const struct json_token* t = &e->tokens[i];
+    if (t->type != JSON_ARRAY)
+        return encode_fail(e, XD_ERR_INPUT, "Error: a PathSet is an array of paths");
+
+    int p = i + 1;
+    for (int path = 0; path < t->size; ++path, p = json_skip(e->tokens, p))
+    {
+        if (e->tokens[p].type != JSON_ARRAY)
+            return encode_fail(e, XD_ERR_INPUT, "Error: a path is an array of steps");
+        if (path > 0 && !put_byte(e, PATH_NEXT))
+            return 0;
+
+        int s = p + 1;
+        for (int step = 0; step < e->tokens[p].size; ++step, s = json_skip(e->tokens, s))
+        {
+            if (e->tokens[s].type != JSON_OBJECT)
+                return encode_fail(e, XD_ERR_INPUT, "Error: a path step is an object");
+
+            const struct json_token* account = 0;
+            const struct json_token* currency = 0;
+            const struct json_token* issuer = 0;
+            for (int k = s + 1, pair = 0; pair < e->tokens[s].size / 2; ++pair, k = json_skip(e->tokens, k + 1))
+            {
+                const struct json_token* key = &e->tokens[k];
+                if (json_eq(e->json, key, "account"))
+                    account = key + 1;
+                else if (json_eq(e->json, key, "currency"))
+                    currency = key + 1;
+                else if (json_eq(e->json, key, "issuer"))
+                    issuer = key + 1;
+                // the type byte follows from the rest
+                else if (!json_eq(e->json, key, "type"))
+                    return encode_fail(e, XD_ERR_INPUT, "Error: unknown path step key `%.*s`", TOKEN_TEXT(key));
+            }
+
+            uint8_t type = (account ? PATH_ACCOUNT : 0) | (currency ? PATH_CURRENCY : 0) | (issuer ? PATH_ISSUER : 0);
+            if (!put_byte(e, type) ||
+                    (account && !put_address(e, account)) ||
+                    (currency && !put_currency(e, currency)) ||
+                    (issuer && !put_address(e, issuer)))
+                return 0;
+        }
+    }
+    return put_byte(e, PATH_END);
+}
+
+static int put_object(struct encoder* e, int i, int top);
+static int put_field(struct encoder* e, uint32_t field_id, int i);
+
+// each element is an object of one field, {"Name": {...}}, written as that field
+static int put_array(struct encoder* e, int i)
+{
+    const struct json_token* t = &e->tokens[i];
+    if (t->type != JSON_ARRAY)
+        return encode_fail(e, XD_ERR_INPUT, "Error: `%.*s` is not an array", TOKEN_TEXT(t));
+
+    int element = i + 1;
+    for (int n = 0; n < t->size; ++n, element = json_skip(e->tokens, element))
+    {
+        const struct json_token* key = &e->tokens[element + 1];
+        if (e->tokens[element].type != JSON_OBJECT || e->tokens[element].size != 2)
+            return encode_fail(e, XD_ERR_INPUT, "Error: an array element is an object with one field");
+
+        int64_t field_id = name_find(e, NAME_FIELD, e->json + key->start, key->end - key->start);
+        if (key->type != JSON_STRING || field_id < 0)
+            return encode_fail(e, XD_ERR_UNKNOWN_FIELD, "Error: unknown field `%.*s`", TOKEN_TEXT(key));
+        if (!put_field(e, (uint32_t)field_id, element + 2))
+            return 0;
+    }
+    return 1;
+}
+
+// rippled's array of hashes, or the hex string the decoder writes
+static int put_vector256(struct encoder* e, int i)
+{
+    const struct json_token* t = &e->tokens[i];
+    if (t->type != JSON_ARRAY)
+        return put_hex(e, t, -1, 1);
+
+    if (!put_vl(e, t->size * 32))
+        return 0;
+    for (int n = 0; n < t->size; ++n)
+        if (!put_hex(e, &e->tokens[i + 1 + n], 32, 0))
+            return 0;
+    return 1;
+}
+
+static int put_field(struct encoder* e, uint32_t field_id, int i)
+{
+    const struct definitions* d = e->definitions;
+    const struct json_token* t = &e->tokens[i];
+    int type_code = field_id >> 16U;
+    int kind = d->type_kind[type_code];
+    int size = d->type_size[type_code];
+
+    if (!put_header(e, type_code, field_id & 0xFFFFU))
+        return 0;
+
+    switch (kind)
+    {
+        case KIND_UINT:
+            return (size <= 8 ? put_uint(e, field_id, size, t) : put_hex(e, t, size, 0));
+        case KIND_HASH:
+            return put_hex(e, t, size, 0);
+        case KIND_AMOUNT:
+            return put_amount(e, i);
+        case KIND_BLOB:
+            return put_hex(e, t, -1, 1);
+        case KIND_ACCOUNT:
+            // the empty string is an empty AccountID
+            if (t->type == JSON_STRING && t->end == t->start)
+                return put_vl(e, 0);
+            return put_vl(e, 20) && put_address(e, t);
+        case KIND_OBJECT:
+            return put_object(e, i, 0) && put_header(e, type_code, 1);
+        case KIND_ARRAY:
+            return put_array(e, i) && put_header(e, type_code, 1);
+        case KIND_PATHSET:
+            return put_pathset(e, i);
+        case KIND_VECTOR256:
+            return put_vector256(e, i);
+    }
+    return encode_fail(e, XD_ERR_UNKNOWN_TYPE, "Error: unknown typecode %d", type_code);
+}
+
+// an object's fields in canonical order, without the end marker
+static int put_object(struct encoder* e, int i, int top)
+{
+    const struct json_token* t = &e->tokens[i];
+    if (t->type != JSON_OBJECT)
+        return encode_fail(e, XD_ERR_INPUT, "Error: `%.*s` is not an object", TOKEN_TEXT(t));
+
+    struct
+    {
+        uint32_t field_id;
+        int value;
+    } fields[ENCODE_OBJECT_FIELDS];
+    int count = 0;
+
+    for (int k = i + 1, pair = 0; pair < t->size / 2; ++pair, k = json_skip(e->tokens, k + 1))
+    {
+        const struct json_token* key = &e->tokens[k];
+        if (top && json_eq(e->json, key, "hash"))
+            continue;
+        int64_t field_id = name_find(e, NAME_FIELD, e->json + key->start, key->end - key->start);
+        if (key->type != JSON_STRING || field_id < 0)
+            return encode_fail(e, XD_ERR_UNKNOWN_FIELD, "Error: unknown field `%.*s`", TOKEN_TEXT(key));
+        if (count >= ENCODE_OBJECT_FIELDS)
+            return encode_fail(e, XD_ERR_INDEX_FULL, "Error: more than %d fields in one object", ENCODE_OBJECT_FIELDS);
+
+        // insertion sort, objects are small
+        int at = count++;
+        for (; at > 0 && fields[at - 1].field_id > (uint32_t)field_id; --at)
+            fields[at] = fields[at - 1];
+        if (at > 0 && fields[at - 1].field_id == (uint32_t)field_id)
+            return encode_fail(e, XD_ERR_INPUT, "Error: field `%.*s` given twice", TOKEN_TEXT(key));
+        fields[at].field_id = (uint32_t)field_id;
+        fields[at].value = k + 1;
+    }
+
+    for (int f = 0; f < count; ++f)
+        if (!put_field(e, fields[f].field_id, fields[f].value))
+            return 0;
+    return 1;
+}
+
+int encode_json(struct encoder* e, const char* json, size_t len)
+{
+    e->json = json;
+    e->output_len = 0;
+    e->error = XD_OK;
+    e->error_message[0] = '\0';
+    if (len > INT32_MAX)
+        return (encode_fail(e, XD_ERR_OVERSIZE, "Error: input larger than 2GB"), e->error);
+
+    // every token but the last takes at least two characters, a separator included
+    int needed = (int)(len / 2) + 2;
+    if (needed > e->token_capacity)
+    {
+        struct json_token* tokens = realloc(e->tokens, needed * sizeof(*tokens));
+        if (!tokens)
+            return (encode_fail(e, XD_ERR_MEMORY, "Error: could not allocate JSON tokens"), e->error);
+        e->tokens = tokens;
+        e->token_capacity = needed;
+    }
+
+    if (json_parse(json, len, e->tokens, e->token_capacity) < 0)
+        return (encode_fail(e, XD_ERR_INPUT, "Error: malformed JSON"), e->error);
+    return (put_object(e, 0, 1) ? XD_OK : e->error);
+}
@@ -0,0 +1,56 @@
+#ifndef ENCODE_H
+#define ENCODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "definitions.h"
+#include "json.h"
+
+/**
+ * JSON -> XRPL binary, the inverse of the decoder
+ * Takes an object in the shape xd writes and produces its canonical serialization, driven by the same definitions:
+ *  - an object's fields are sorted by type code then field code, array elements keep their order;
+ *  - UInts are numbers or, for TransactionType, LedgerEntryType and TransactionResult, names;
+ *  - hashes, blobs and Vector256s are hex, blobs, AccountIDs and Vector256s get a VL length prefix;
+ *  - AccountIDs are r-addresses, the empty string for an empty one;
+ *  - XRP amounts are drops in a string, IOU amounts {value, currency, issuer} are normalized to a 16 digit mantissa.
+ * rippled's forms are accepted too: UInt64s as hex strings and Vector256s as arrays of hashes. A top level "hash"
+ * (the transaction ID xd --hash adds) is not a field and is skipped.
+ */
+#define ENCODE_OBJECT_FIELDS 256    // most fields in one object
+
+// a name in one of the definitions' tables, in an open addressed table keyed by table and name
+struct encode_name
+{
+    const char* name;
+    int len;
+    int table;
+    uint32_t value;                 // field_id or code
+};
+
+struct encoder
+{
+    const struct definitions* definitions;
+    struct encode_name* names;
+    int name_slots;
+    struct json_token* tokens;
+    int token_capacity;
+    const char* json;               // being encoded
+
+    uint8_t* output;                // the binary of the last object
+    size_t output_len;
+    size_t output_capacity;
+    int error;                      // XD_* code of the last failure
+    char error_message[128];
+};
+
+// index the definitions' names, returns 0 if out of memory
+int encode_init(struct encoder* encoder, const struct definitions* definitions);
+
+// encode one JSON object into `output`, returns an XD_* code with `error_message` set on failure
+int encode_json(struct encoder* encoder, const char* json, size_t len);
+
+void encode_free(struct encoder* encoder);
+
+#endif
@@ -0,0 +1,278 @@
+/**
+ * Field offset index, see field_index.h
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "field_index.h"
+
+static void field_index_hash_insert(struct field_index* index, uint32_t field_id, int entry)
+{
+    // beyond half full the probes get long, find() falls back to scanning instead
+    if (index->top_used >= FIELD_INDEX_SLOTS / 2)
+    {
+        index->top_full = 1;
+        return;
+    }
+
+    uint32_t slot = (field_id * 2654435761U) >> 24U;
+    for (;; slot++)
+    {
+        uint16_t* s = &index->top[slot & (FIELD_INDEX_SLOTS - 1)];
+        if (*s == 0)
+        {
+            *s = entry + 1;
+            index->top_used++;
+            return;
+        }
+        // a repeated top level field, the first one wins
+        if (index->entries[*s - 1].field_id == field_id)
+            return;
+    }
+}
+
+int field_index_build(struct field_index* index, const struct definitions* definitions,
+        const uint8_t* input, size_t input_len)
+{
+    index->input = input;
+    index->input_len = input_len;
+    index->count = 0;
+    index->top_used = 0;
+    index->top_full = 0;
+    memset(index->top, 0, sizeof(index->top));
+
+    if (input_len > UINT32_MAX)
+        return XD_ERR_OVERSIZE;
+
+    uint16_t open[FIELD_INDEX_DEPTH];  // entries of the enclosing objects and arrays
+    int depth = 0;
+
+    #define NEED(b)\
+    {\
+        if (input_len - at < (size_t)(b))\
+            return XD_ERR_TRUNCATED;\
+    }
+
+    size_t at = 0;
+    while (at < input_len)
+    {
+        size_t header = at;
+        int type_code = 0;
+        int field_code = 0;
+        uint8_t b = input[at];
+        if (b == 0)
+        {
+            NEED(3);
+            type_code = input[at + 1];
+            field_code = input[at + 2];
+            at += 3;
+        }
+        else if ((b >> 4U) == 0)
+        {
+            NEED(2);
+            field_code = (b & 0xFU);
+            type_code = input[at + 1];
+            at += 2;
+        }
+        else if ((b & 0xFU) == 0)
+        {
+            NEED(2);
+            type_code = (b >> 4U);
+            field_code = input[at + 1];
+            at += 2;
+        }
+        else
+        {
+            type_code = (b >> 4U);
+            field_code = (b & 0xFU);
+            at += 1;
+        }
+
+        int kind = definitions->type_kind[type_code];
+        if (type_code == 0 || kind == KIND_UNKNOWN)
+            return XD_ERR_UNKNOWN_TYPE;
+
+        if ((kind == KIND_OBJECT || kind == KIND_ARRAY) && field_code == 1)
+        {
+            if (depth == 0)
+                return XD_ERR_UNBALANCED;
+            struct field_index_entry* e = &index->entries[open[--depth]];
+            e->len = header - e->offset;
+            continue;
+        }
+
+        if (index->count >= FIELD_INDEX_SIZE)
+            return XD_ERR_INDEX_FULL;
+
+        struct field_index_entry* e = &index->entries[index->count];
+        e->field_id = ((uint32_t)type_code << 16U) + field_code;
+        e->parent = (depth > 0 ? open[depth - 1] : FIELD_INDEX_ROOT);
+        e->kind = kind;
+        e->depth = depth;
+
+        size_t len = 0;
+        if (kind == KIND_OBJECT || kind == KIND_ARRAY)
+        {
+            if (depth >= FIELD_INDEX_DEPTH)
+                return XD_ERR_INDEX_FULL;
+            open[depth++] = index->count;
+        }
+        else if (kind == KIND_UINT || kind == KIND_HASH)
+            len = definitions->type_size[type_code];
+        else if (kind == KIND_AMOUNT)
+        {
+            NEED(1);
+            len = (input[at] >> 7U ? 48 : 8);
+        }
+        else if (kind == KIND_PATHSET)
+        {
+            // steps up to the 0x00 that ends the set, which is counted in the length
+            size_t p = at;
+            while (1)
+            {
+                if (p >= input_len)
+                    return XD_ERR_TRUNCATED;
+                uint8_t path_type = input[p++];
+                if (path_type == 0x00U)
+                    break;
+                if (path_type != 0xFFU)
+                    p += 20 * ((path_type & 0x01U) + ((path_type >> 4U) & 1U) + ((path_type >> 5U) & 1U));
+            }
+            len = p - at;
+        }
+        else
+        {
+            // AccountID, Blob and Vector256 are length prefixed
+            NEED(1);
+            len = input[at];
+            if (len <= 192)
+                at += 1;
+            else if (len <= 240)
+            {
+                NEED(2);
+                len = 193 + ((len - 193) * 256) + input[at + 1];
+                at += 2;
+            }
+            else
+            {
+                NEED(3);
+                len = 12481 + ((len - 241) * 65536) + (input[at + 1] * 256) + input[at + 2];
+                at += 3;
+            }
+        }
+
+        NEED(len);
+        e->offset = at;
+        e->len = len;
+        at += len;
+
+        if (e->parent == FIELD_INDEX_ROOT)
+            field_index_hash_insert(index, e->field_id, index->count);
+        index->count++;
+    }
+
+    #undef NEED
+
+    return (depth == 0 ? XD_OK : XD_ERR_TRUNCATED);
+}
+
+int field_index_find(const struct field_index* index, int parent, uint32_t field_id)
+{
+    if (parent == FIELD_INDEX_ROOT && !index->top_full)
+    {
+        for (uint32_t slot = (field_id * 2654435761U) >> 24U;; slot++)
+        {
+            uint16_t s = index->top[slot & (FIELD_INDEX_SLOTS - 1)];
+            if (s == 0)
+                return -1;
+            if (index->entries[s - 1].field_id == field_id)
+                return s - 1;
+        }
+    }
+
+    if (parent != FIELD_INDEX_ROOT && (parent < 0 || parent >= index->count))
+        return -1;
+
+    // children follow their parent until the next entry at its depth or above
+    int start = (parent == FIELD_INDEX_ROOT ? 0 : parent + 1);
+    int depth = (parent == FIELD_INDEX_ROOT ? 0 : index->entries[parent].depth + 1);
+    for (int i = start; i < index->count && index->entries[i].depth >= depth; ++i)
+        if (index->entries[i].parent == parent && index->entries[i].field_id == field_id)
+            return i;
+    return -1;
+}
+
+int field_index_find_next(const struct field_index* index, int entry)
+{
+    if (entry < 0 || entry >= index->count)
+        return -1;
+
+    const struct field_index_entry* e = &index->entries[entry];
+    for (int i = entry + 1; i < index->count && index->entries[i].depth >= e->depth; ++i)
+        if (index->entries[i].parent == e->parent && index->entries[i].field_id == e->field_id)
+            return i;
+    return -1;
+}
+
+// depth first, so AffectedNodes.ModifiedNode.Balance finds the first ModifiedNode that has a Balance
+static int field_index_match(const struct field_index* index, int parent, const uint32_t* ids, int count)
+{
+    for (int e = field_index_find(index, parent, ids[0]); e >= 0; e = field_index_find_next(index, e))
+    {
+        if (count == 1)
+            return e;
+        int found = field_index_match(index, e, ids + 1, count - 1);
+        if (found >= 0)
+            return found;
+    }
+    return -1;
+}
+
+int field_index_find_path(const struct field_index* index, const uint32_t* ids, int count)
+{
+    return (count > 0 ? field_index_match(index, FIELD_INDEX_ROOT, ids, count) : -1);
+}
+
+int field_index_path(const struct field_index* index, const struct definitions* definitions, const char* path)
+{
+    uint32_t ids[FIELD_INDEX_DEPTH + 1];
+    int count = definitions_field_path(definitions, path, strlen(path), ids, FIELD_INDEX_DEPTH + 1);
+    return (count > 0 ? field_index_find_path(index, ids, count) : -1);
+}
+
+int field_index_uint(const struct field_index* index, int entry, uint64_t* value)
+{
+    if (entry < 0 || entry >= index->count || index->entries[entry].kind != KIND_UINT)
+        return 0;
+
+    const struct field_index_entry* e = &index->entries[entry];
+    uint64_t number = 0;
+    for (int i = 0; i < e->len; ++i)
+        number = (number << 8U) + index->input[e->offset + i];
+    *value = number;
+    return 1;
+}
+
+const uint8_t* field_index_account(const struct field_index* index, int entry)
+{
+    if (entry < 0 || entry >= index->count || index->entries[entry].kind != KIND_ACCOUNT ||
+            index->entries[entry].len != 20)
+        return 0;
+    return index->input + index->entries[entry].offset;
+}
+
+int field_index_amount(const struct field_index* index, int entry, struct xd_amount* amount)
+{
+    if (entry < 0 || entry >= index->count || index->entries[entry].kind != KIND_AMOUNT)
+        return 0;
+    xd_amount_read(amount, index->input + index->entries[entry].offset);
+    return 1;
+}
+
+const uint8_t* field_index_bytes(const struct field_index* index, int entry, int* len)
+{
+    if (entry < 0 || entry >= index->count)
+        return 0;
+    *len = index->entries[entry].len;
+    return index->input + index->entries[entry].offset;
+}
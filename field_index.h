@@ -0,0 +1,71 @@
+#ifndef FIELD_INDEX_H
+#define FIELD_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "definitions.h"
+#include "xd.h"
+
+/**
+ * Field offset index
+ * One pass over the field headers and length prefixes records where every field's value sits in the serialized
+ * object, nothing is formatted. The accessors then read single fields straight from the original bytes, which
+ * must outlive the index. Top level fields are found through a small hash table, nested ones by scanning the
+ * entries of their parent.
+ */
+#define FIELD_INDEX_SIZE 2048           // most fields one index holds
+#define FIELD_INDEX_DEPTH 32            // deepest nesting of objects and arrays
+#define FIELD_INDEX_SLOTS 256           // top level hash table, a power of two
+#define FIELD_INDEX_ROOT 0xFFFFU        // parent of the top level fields
+
+struct field_index_entry
+{
+    uint32_t field_id;      // type_code << 16 | field_code
+    uint16_t parent;        // entry of the enclosing object or array, FIELD_INDEX_ROOT at the top level
+    uint8_t kind;           // enum type_kind
+    uint8_t depth;          // 0 at the top level
+    uint32_t offset;        // of the value, past the field header and any length prefix
+    uint32_t len;           // of the value, objects and arrays run up to (not including) their end marker
+};
+
+struct field_index
+{
+    const uint8_t* input;
+    size_t input_len;
+    int count;
+    int top_used;
+    int top_full;                       // too many top level fields to hash, find() scans for them instead
+    uint16_t top[FIELD_INDEX_SLOTS];    // top level field_id -> entry + 1, 0 when empty
+    struct field_index_entry entries[FIELD_INDEX_SIZE];     // in input order, children follow their parent
+};
+
+// index the serialized object in `input`, returns XD_OK or an XD_ERR_* code
+int field_index_build(struct field_index* index, const struct definitions* definitions,
+        const uint8_t* input, size_t input_len);
+
+// first entry with `field_id` directly inside `parent` (FIELD_INDEX_ROOT for the top level), -1 if there is none
+int field_index_find(const struct field_index* index, int parent, uint32_t field_id);
+
+// the next entry after `entry` with the same field_id and parent, -1 if there is none
+int field_index_find_next(const struct field_index* index, int entry);
+
+// first entry matching a path of `count` field_ids from the top level, -1 if none
+int field_index_find_path(const struct field_index* index, const uint32_t* ids, int count);
+
+// first entry matching a dotted path of field names like "AffectedNodes.ModifiedNode.LedgerEntryType", -1 if none
+int field_index_path(const struct field_index* index, const struct definitions* definitions, const char* path);
+
+// accessors, each returns 0 (or null) if the entry is missing or of another type
+
+int field_index_uint(const struct field_index* index, int entry, uint64_t* value);
+
+// the 20 byte AccountID
+const uint8_t* field_index_account(const struct field_index* index, int entry);
+
+int field_index_amount(const struct field_index* index, int entry, struct xd_amount* amount);
+
+// the raw value bytes of any entry: hashes, blobs, a whole object ...
+const uint8_t* field_index_bytes(const struct field_index* index, int entry, int* len);
+
+#endif
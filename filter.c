@@ -0,0 +1,206 @@
+/**
+ * Record filter, see filter.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "filter.h"
+#include "libbase58.h"
+#include "hex.h"
+
+// the value text of a term as the bytes or number the field holds
+static int filter_value(struct filter* filter, struct filter_term* t, const struct definitions* definitions,
+        const char* value, int len)
+{
+    uint32_t field_id = t->path[t->path_len - 1];
+    int type_code = field_id >> 16U;
+    int field_code = field_id & 0xFFFFU;
+    char text[FILTER_VALUE_SIZE * 2 + 1];
+    if (len <= 0 || len >= sizeof(text))
+        return snprintf(filter->error, sizeof(filter->error), "missing or oversized value"), 0;
+    memcpy(text, value, len);
+    text[len] = '\0';
+
+    if (t->kind == KIND_UINT)
+    {
+        // named codes
+        const struct definitions_name* table = 0;
+        if (type_code == 1 && field_code == 2)
+            table = definitions->transaction_types;
+        else if (type_code == 1 && field_code == 1)
+            table = definitions->ledger_entry_types;
+        else if (type_code == 16 && field_code == 3)
+            table = definitions->transaction_results;
+
+        int code = (table ? definitions_find_code(definitions, table, text, len) : -1);
+        if (code >= 0)
+        {
+            t->number = code;
+            return 1;
+        }
+
+        // decimal, or hex with an explicit 0x, strtoull alone would take octal, signs and spaces too
+        char* end = 0;
+        int hex = (text[0] == '0' && (text[1] == 'x' || text[1] == 'X'));
+        if (hex ? isxdigit((unsigned char)text[2]) : isdigit((unsigned char)text[0]))
+        {
+            errno = 0;
+            t->number = strtoull(text, &end, (hex ? 16 : 10));
+            if (*end == '\0' && errno == 0)
+                return 1;
+        }
+        return snprintf(filter->error, sizeof(filter->error), "`%s` is not a number or a known name", text), 0;
+    }
+
+    if (t->kind == KIND_AMOUNT)
+    {
+        char* end = 0;
+        t->drops = strtoll(text, &end, 10);
+        if (*end == '\0')
+            return 1;
+        return snprintf(filter->error, sizeof(filter->error), "`%s` is not an amount in drops", text), 0;
+    }
+
+    if (t->op != FILTER_EQ && t->op != FILTER_NE)
+        return snprintf(filter->error, sizeof(filter->error), "only == and != compare `%s`", text), 0;
+
+    if (t->kind == KIND_ACCOUNT && len != 40)
+    {
+        // version byte, AccountID and checksum
+        uint8_t bin[25];
+        size_t bin_len = sizeof(bin);
+        if (!b58tobin(bin, &bin_len, text, len) || bin_len != sizeof(bin) || b58check(bin, bin_len, text, len) != 0)
+            return snprintf(filter->error, sizeof(filter->error), "`%s` is not an r-address", text), 0;
+        memcpy(t->bytes, bin + 1, 20);
+        t->len = 20;
+        return 1;
+    }
+
+    if (t->kind == KIND_ACCOUNT || t->kind == KIND_HASH || t->kind == KIND_BLOB || t->kind == KIND_VECTOR256)
+    {
+        int carry = -1;
+        t->len = hex_decode(t->bytes, (uint8_t*)text, len, &carry);
+        if (t->len >= 0 && carry == -1)
+            return 1;
+        return snprintf(filter->error, sizeof(filter->error), "`%s` is not hex", text), 0;
+    }
+
+    return snprintf(filter->error, sizeof(filter->error), "objects, arrays and paths can't be compared"), 0;
+}
+
+int filter_compile(struct filter* filter, const struct definitions* definitions, const char* expression)
+{
+    memset(filter, 0, sizeof(*filter));
+
+    const char* p = expression;
+    while (1)
+    {
+        while (*p == ' ')
+            p++;
+        const char* end = strstr(p, "&&");
+        if (!end)
+            end = p + strlen(p);
+
+        if (filter->count >= FILTER_TERMS)
+            return snprintf(filter->error, sizeof(filter->error), "more than %d terms", FILTER_TERMS), 0;
+        struct filter_term* t = &filter->terms[filter->count++];
+
+        // path, operator, value
+        const char* op = p;
+        while (op < end && !strchr("=!<>", *op))
+            op++;
+        const char* value = op;
+        if (value < end && value[1] == '=')
+        {
+            t->op = (*op == '=' ? FILTER_EQ : *op == '!' ? FILTER_NE : *op == '<' ? FILTER_LE : FILTER_GE);
+            value += 2;
+        }
+        else if (value < end && (*op == '<' || *op == '>'))
+        {
+            t->op = (*op == '<' ? FILTER_LT : FILTER_GT);
+            value += 1;
+        }
+        else
+            return snprintf(filter->error, sizeof(filter->error), "term %d has no operator", filter->count), 0;
+
+        int path_len = op - p;
+        while (path_len > 0 && p[path_len - 1] == ' ')
+            path_len--;
+        t->path_len = definitions_field_path(definitions, p, path_len, t->path, FIELD_INDEX_DEPTH);
+        if (t->path_len == 0)
+            return snprintf(filter->error, sizeof(filter->error), "unknown field in `%.*s`", path_len, p), 0;
+        t->kind = definitions->type_kind[t->path[t->path_len - 1] >> 16U];
+
+        while (value < end && *value == ' ')
+            value++;
+        int value_len = end - value;
+        while (value_len > 0 && value[value_len - 1] == ' ')
+            value_len--;
+        if (!filter_value(filter, t, definitions, value, value_len))
+            return 0;
+
+        if (!*end)
+            return 1;
+        p = end + 2;
+    }
+}
+
+static int filter_compare(const struct filter_term* t, const struct field_index* index, int entry)
+{
+    int order = 0;
+    if (t->kind == KIND_UINT)
+    {
+        uint64_t value = 0;
+        if (!field_index_uint(index, entry, &value))
+            return 0;
+        order = (value < t->number ? -1 : value > t->number);
+    }
+    else if (t->kind == KIND_AMOUNT)
+    {
+        struct xd_amount amount;
+        if (!field_index_amount(index, entry, &amount) || !amount.native)
+            return 0;
+        int64_t drops = (amount.negative ? -(int64_t)amount.mantissa : (int64_t)amount.mantissa);
+        order = (drops < t->drops ? -1 : drops > t->drops);
+    }
+    else
+    {
+        int len = 0;
+        const uint8_t* bytes = field_index_bytes(index, entry, &len);
+        return (bytes && len == t->len && memcmp(bytes, t->bytes, len) == 0);
+    }
+
+    switch (t->op)
+    {
+        case FILTER_LT: return order < 0;
+        case FILTER_LE: return order <= 0;
+        case FILTER_GT: return order > 0;
+        case FILTER_GE: return order >= 0;
+    }
+    return order == 0;
+}
+
+// does any field on the term's path (from `parent` down) satisfy it
+static int filter_any(const struct filter_term* t, const struct field_index* index, int parent, int depth)
+{
+    for (int e = field_index_find(index, parent, t->path[depth]); e >= 0; e = field_index_find_next(index, e))
+        if (depth + 1 == t->path_len ? filter_compare(t, index, e) : filter_any(t, index, e, depth + 1))
+            return 1;
+    return 0;
+}
+
+int filter_match(const struct filter* filter, const struct field_index* index)
+{
+    for (int i = 0; i < filter->count; ++i)
+    {
+        const struct filter_term* t = &filter->terms[i];
+        // != is tested as == and negated, a record without the field passes it
+        if (filter_any(t, index, FIELD_INDEX_ROOT, 0) == (t->op == FILTER_NE))
+            return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,55 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+
+#include "definitions.h"
+#include "field_index.h"
+
+/**
+ * Record filter: `&&` separated terms like TransactionType==Payment, Destination==rXYZ..., Fee<=12 or
+ * AffectedNodes.ModifiedNode.LedgerEntryType==AccountRoot, compiled once and then tested against the raw bytes
+ * of each record through a field index, nothing is formatted.
+ * A path that matches several fields (inside arrays) passes if any of them does, `!=` is the negation of `==`.
+ * Values are compiled to what the field holds: names to their codes, r-addresses to AccountIDs, hex to bytes,
+ * decimal (or 0x hex) numbers for UInts and XRP amounts in drops (which are the only types that take < <= > >=).
+ */
+#define FILTER_TERMS 16
+#define FILTER_VALUE_SIZE 256   // longest hash or blob a term compares against
+
+enum filter_op
+{
+    FILTER_EQ,
+    FILTER_NE,
+    FILTER_LT,
+    FILTER_LE,
+    FILTER_GT,
+    FILTER_GE
+};
+
+struct filter_term
+{
+    uint32_t path[FIELD_INDEX_DEPTH];   // field_ids from the top level
+    int path_len;
+    int kind;                           // enum type_kind of the last field in the path
+    int op;                             // enum filter_op
+    uint64_t number;                    // UInt terms
+    int64_t drops;                      // Amount terms
+    int len;                            // AccountID, hash and blob terms
+    uint8_t bytes[FILTER_VALUE_SIZE];
+};
+
+struct filter
+{
+    int count;
+    struct filter_term terms[FILTER_TERMS];
+    char error[128];                    // why filter_compile failed
+};
+
+// returns 1, or 0 with filter->error set
+int filter_compile(struct filter* filter, const struct definitions* definitions, const char* expression);
+
+// 1 if the indexed record passes every term
+int filter_match(const struct filter* filter, const struct field_index* index);
+
+#endif
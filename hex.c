@@ -0,0 +1,174 @@
+/**
+ * Hex text decoding for stream input
+ * Scalar table-driven decoder with SSE2 / AVX2 kernels selected at runtime
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hex.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HEX_X86 1
+#endif
+
+// nibble value of each character, -2 for whitespace, -1 for garbage
+static const int8_t hex_digits_map[256] = {
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-2,-2,-1,-1,-2,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -2,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+     0, 1, 2, 3, 4, 5, 6, 7,  8, 9,-1,-1,-1,-1,-1,-1,
+    -1,10,11,12,13,14,15,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,10,11,12,13,14,15,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+};
+
+static int hex_decode_scalar(uint8_t* out, const uint8_t* in, const uint8_t* end, int* carry)
+{
+    uint8_t* o = out;
+    int c = *carry;
+    for (; in < end; ++in)
+    {
+        int8_t v = hex_digits_map[*in];
+        if (v >= 0)
+        {
+            if (c < 0)
+                c = v;
+            else
+            {
+                *o++ = (uint8_t)((c << 4U) + v);
+                c = -1;
+            }
+        }
+        else if (v == -1)
+            return -1;
+    }
+    *carry = c;
+    return o - out;
+}
+
+/**
+ * The vector kernels only handle windows made entirely of hex digits that start on a byte boundary.
+ * Anything else (whitespace, garbage, a dangling nibble) drops to the scalar decoder for one window,
+ * then one character at a time until the nibble pairing is realigned.
+ */
+#define HEX_DECODE_LOOP(window, kernel)\
+{\
+    const uint8_t* end = in + in_len;\
+    uint8_t* o = out;\
+    while (end - in >= (window))\
+    {\
+        if (*carry < 0 && kernel(o, in))\
+        {\
+            in += (window);\
+            o += (window) / 2;\
+            continue;\
+        }\
+        const uint8_t* stop = in + (*carry < 0 ? (window) : 1);\
+        int l = hex_decode_scalar(o, in, stop, carry);\
+        if (l < 0)\
+            return -1;\
+        in = stop;\
+        o += l;\
+    }\
+    int l = hex_decode_scalar(o, in, end, carry);\
+    if (l < 0)\
+        return -1;\
+    return (o + l) - out;\
+}
+
+#ifdef HEX_X86
+
+// decode 16 hex characters into 8 bytes, returns 0 if the window is not pure hex
+static inline int hex_kernel_sse2(uint8_t* out, const uint8_t* in)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)in);
+    __m128i lc = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(
+            _mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+            _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i alpha = _mm_and_si128(
+            _mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(lc, _mm_set1_epi8('f' + 1)));
+
+    if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xFFFF)
+        return 0;
+
+    __m128i nib = _mm_or_si128(
+            _mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+            _mm_and_si128(alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a' - 10))));
+
+    // even characters are the high nibble, they sit in the low byte of each 16 bit lane
+    __m128i w = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(nib, _mm_set1_epi16(0x00FF)), 4),
+            _mm_srli_epi16(nib, 8));
+
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(w, w));
+    return 1;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_nibbles_avx2(__m256i v, int* valid)
+{
+    __m256i lc = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i digit = _mm256_andnot_si256(
+            _mm256_cmpgt_epi8(v, _mm256_set1_epi8('9')),
+            _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)));
+    __m256i alpha = _mm256_andnot_si256(
+            _mm256_cmpgt_epi8(lc, _mm256_set1_epi8('f')),
+            _mm256_cmpgt_epi8(lc, _mm256_set1_epi8('a' - 1)));
+
+    *valid = (_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) == -1);
+
+    __m256i nib = _mm256_or_si256(
+            _mm256_and_si256(digit, _mm256_sub_epi8(v, _mm256_set1_epi8('0'))),
+            _mm256_and_si256(alpha, _mm256_sub_epi8(lc, _mm256_set1_epi8('a' - 10))));
+
+    // hi * 16 + lo for each pair of characters
+    return _mm256_maddubs_epi16(nib, _mm256_set1_epi16(0x0110));
+}
+
+// decode 64 hex characters into 32 bytes, returns 0 if the window is not pure hex
+__attribute__((target("avx2")))
+static inline int hex_kernel_avx2(uint8_t* out, const uint8_t* in)
+{
+    int valid_a, valid_b;
+    __m256i a = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i*)in), &valid_a);
+    __m256i b = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i*)(in + 32)), &valid_b);
+    if (!valid_a || !valid_b)
+        return 0;
+
+    // packus interleaves 128 bit lanes, permute them back into order
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+    _mm256_storeu_si256((__m256i*)out, packed);
+    return 1;
+}
+
+static int hex_decode_sse2(uint8_t* out, const uint8_t* in, size_t in_len, int* carry)
+HEX_DECODE_LOOP(16, hex_kernel_sse2)
+
+__attribute__((target("avx2")))
+static int hex_decode_avx2(uint8_t* out, const uint8_t* in, size_t in_len, int* carry)
+HEX_DECODE_LOOP(64, hex_kernel_avx2)
+
+#endif
+
+int hex_decode(uint8_t* out, const uint8_t* in, size_t in_len, int* carry)
+{
+#ifdef HEX_X86
+    if (__builtin_cpu_supports("avx2"))
+        return hex_decode_avx2(out, in, in_len, carry);
+    if (__builtin_cpu_supports("sse2"))
+        return hex_decode_sse2(out, in, in_len, carry);
+#endif
+    return hex_decode_scalar(out, in, in + in_len, carry);
+}
@@ -0,0 +1,15 @@
+#ifndef HEX_H
+#define HEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Decode a block of hex text into bytes, skipping whitespace (space, \t, \r, \n).
+ * `carry` holds a dangling nibble between calls (-1 if none) so text may be split anywhere.
+ * `out` must have room for (in_len + 1) / 2 bytes.
+ * Returns the number of bytes written, or -1 if the text contains a non-hex, non-whitespace character.
+ */
+int hex_decode(uint8_t* out, const uint8_t* in, size_t in_len, int* carry);
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * Minimal in-place JSON tokenizer
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+#define JSON_MAX_DEPTH 64
+
+int json_parse(const char* js, size_t len, struct json_token* tokens, int max_tokens)
+{
+    int count = 0;
+    int stack[JSON_MAX_DEPTH];  // open containers
+    int depth = 0;
+    int expect_value = 1;
+
+    // in counting mode sizes are not tracked, only the containers need to balance
+    #define JSON_PUSH_TOKEN(kind, s, e)\
+    {\
+        if (tokens)\
+        {\
+            if (count >= max_tokens)\
+                return -1;\
+            tokens[count].type = (kind);\
+            tokens[count].start = (s);\
+            tokens[count].end = (e);\
+            tokens[count].size = 0;\
+            if (depth > 0)\
+                tokens[stack[depth - 1]].size++;\
+        }\
+        count++;\
+    }
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        char c = js[i];
+        switch (c)
+        {
+            case ' ': case '\t': case '\r': case '\n': case ',': case ':':
+                continue;
+
+            case '{': case '[':
+                if (depth >= JSON_MAX_DEPTH)
+                    return -1;
+                JSON_PUSH_TOKEN((c == '{' ? JSON_OBJECT : JSON_ARRAY), i, -1);
+                stack[depth++] = count - 1;
+                continue;
+
+            case '}': case ']':
+                if (depth == 0)
+                    return -1;
+                depth--;
+                if (tokens)
+                {
+                    struct json_token* t = &tokens[stack[depth]];
+                    if (t->type != (c == '}' ? JSON_OBJECT : JSON_ARRAY))
+                        return -1;
+                    t->end = i + 1;
+                }
+                if (depth == 0)
+                    return count;
+                continue;
+
+            case '"':
+            {
+                size_t start = ++i;
+                for (; i < len && js[i] != '"'; ++i)
+                    if (js[i] == '\\')
+                        ++i;
+                if (i >= len)
+                    return -1;
+                JSON_PUSH_TOKEN(JSON_STRING, start, i);
+                continue;
+            }
+
+            default:
+            {
+                size_t start = i;
+                for (; i < len; ++i)
+                {
+                    char p = js[i];
+                    if (p == ',' || p == ':' || p == ']' || p == '}' ||
+                        p == ' ' || p == '\t' || p == '\r' || p == '\n')
+                        break;
+                    if (p < 32 || p == '"' || p == '[' || p == '{')
+                        return -1;
+                }
+                JSON_PUSH_TOKEN(JSON_PRIMITIVE, start, i);
+                i--;
+                if (depth == 0)
+                    return count;
+                continue;
+            }
+        }
+    }
+
+    #undef JSON_PUSH_TOKEN
+
+    return (depth == 0 && count > 0 ? count : -1);
+}
+
+int json_skip(const struct json_token* tokens, int i)
+{
+    int children = tokens[i].size;
+    i++;
+    while (children-- > 0)
+        i = json_skip(tokens, i);
+    return i;
+}
+
+int json_eq(const char* js, const struct json_token* t, const char* s)
+{
+    int l = t->end - t->start;
+    return t->type == JSON_STRING && strlen(s) == l && memcmp(js + t->start, s, l) == 0;
+}
+
+int json_int(const char* js, const struct json_token* t, long long* out)
+{
+    if (t->type != JSON_PRIMITIVE)
+        return 0;
+
+    char buf[32];
+    int l = t->end - t->start;
+    if (l <= 0 || l >= sizeof(buf))
+        return 0;
+    memcpy(buf, js + t->start, l);
+    buf[l] = '\0';
+
+    char* end = 0;
+    *out = strtoll(buf, &end, 10);
+    return *end == '\0';
+}
@@ -0,0 +1,43 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+/**
+ * Minimal in-place JSON tokenizer
+ * Tokens reference the source text by offset, nothing is copied or unescaped.
+ * Each token's size is the number of tokens directly inside it (an object counts keys and values).
+ */
+enum json_type
+{
+    JSON_UNDEFINED = 0,
+    JSON_OBJECT,
+    JSON_ARRAY,
+    JSON_STRING,
+    JSON_PRIMITIVE
+};
+
+struct json_token
+{
+    int type;
+    int start;  // offset of first character (inside the quotes for strings)
+    int end;    // offset one past the last character
+    int size;
+};
+
+/**
+ * Tokenize `js`. If `tokens` is null only the count is returned.
+ * Returns the number of tokens used, or -1 on malformed input or if max_tokens is too small.
+ */
+int json_parse(const char* js, size_t len, struct json_token* tokens, int max_tokens);
+
+// index of the token following the subtree rooted at token `i`
+int json_skip(const struct json_token* tokens, int i);
+
+// compare a string token with a C string
+int json_eq(const char* js, const struct json_token* t, const char* s);
+
+// parse a primitive token as an integer, returns 0 if it is not one
+int json_int(const char* js, const struct json_token* t, long long* out);
+
+#endif
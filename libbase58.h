@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 
 extern bool (*b58_sha256_impl)(void *, const void *, size_t);
@@ -13,5 +14,12 @@ extern int b58check(const void *bin, size_t binsz, const char *b58, size_t b58sz
 extern bool b58enc(char *b58, size_t *b58sz, const void *bin, size_t binsz);
 extern bool b58check_enc(char *b58c, size_t *b58c_sz, uint8_t ver, const void *data, size_t datasz);
 
+/* fixed width variants for account payloads: version byte, 20 byte AccountID, 4 byte checksum */
+#define B58_ACCOUNT_SIZE 36 /* longest encoding plus NUL */
+extern bool b58enc_25(char *b58, size_t *b58sz, const void *bin);
+extern bool b58check_enc_account(char *b58c, size_t *b58c_sz, uint8_t ver, const void *data);
+/* `count` AccountIDs packed 20 bytes apart, outputs are B58_ACCOUNT_SIZE apart in b58c, lengths in b58c_sz[] */
+extern bool b58check_enc_account_batch(char *b58c, size_t *b58c_sz, uint8_t ver, const void *data, size_t count);
+
 
 #endif
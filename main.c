@@ -16,1219 +16,718 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 
 #include "sha-256.h"
-
-#define DEFAULT_SIZE (2048*1024)
-
-#define DEBUG 0
-
-int append(int indent_level, uint8_t** output, int* upto, int* len, int write_fd, uint8_t* append, int append_len)
+#include "sha-512.h"
+#include "hex.h"
+#include "xd.h"
+#include "field_index.h"
+#include "filter.h"
+#include "arrow.h"
+#include "csv.h"
+#include "encode.h"
+#include "pipeline.h"
+
+#define STREAM_BLOCK_SIZE (256*1024)
+
+// the builtin definitions, or those --definitions loaded, every context and writer decodes against them
+static const struct definitions* definitions = 0;
+
+// hex text is read and decoded a block at a time, the decoder is then served from the decoded block
+struct stream_reader
 {
+    uint8_t text[STREAM_BLOCK_SIZE];
+    uint8_t bytes[STREAM_BLOCK_SIZE / 2 + 1];
+    int read_fd;
+    int upto;
+    int len;
+    int carry;
+    int eof;
+};
+
+int stream_refill(void* user, uint8_t* input, int input_len, int min_bytes_to_return)
+{
+    struct stream_reader* reader = user;
 
-    if (DEBUG)
-        printf("append: `%s`\n", append);
+    // only hand back what was asked for, this keeps the decoder's own buffer (and its compaction) small
+    if (min_bytes_to_return < 1)
+        min_bytes_to_return = 1;
+    if (min_bytes_to_return > input_len)
+        min_bytes_to_return = input_len;
 
-    // stream mode
-    if (write_fd)
+    int upto = 0;
+    while (upto < min_bytes_to_return)
     {
-        char tab[1] = {'\t'};
-        for (int i = 0; i < indent_level; ++i)
-            if (write(write_fd, tab, 1) <= 0)
-                return 0;
+        if (reader->upto >= reader->len)
+        {
+            if (reader->eof)
+                break;
 
-        int l = strnlen(append, append_len);
-        if (write(write_fd, append, l) < l)
-            return 0;
+            ssize_t bytes_read = read(reader->read_fd, reader->text, STREAM_BLOCK_SIZE);
+            if (bytes_read < 0 && errno == EINTR)
+                continue;
+            if (bytes_read <= 0)
+            {
+                reader->eof = 1;
+                break;
+            }
 
-        return 1;
-    }
+            int l = hex_decode(reader->bytes, reader->text, bytes_read, &reader->carry);
+            if (l < 0)
+            {
+                fprintf(stderr, "Error: Garbage (non hex and non whitespace characters) in input stream\n");
+                return -2;
+            }
+            reader->upto = 0;
+            reader->len = l;
+            continue;
+        }
 
-    if (*len - *upto < append_len + 1 + indent_level)
-    {
-        *len *= 2;
-        *output = realloc(*output, *len + 1);
-        if (*output == 0)
-            return 0;
+        int l = reader->len - reader->upto;
+        if (l > min_bytes_to_return - upto)
+            l = min_bytes_to_return - upto;
+        memcpy(input + upto, reader->bytes + reader->upto, l);
+        reader->upto += l;
+        upto += l;
     }
 
-    // tabs for indent
-
-    for (int i = 0; i < indent_level; ++i)
-        *(*output + (*upto)++) = '\t';
-
-    for (uint8_t* x = *output + *upto, *end = *output + *upto + append_len; x < end && *append; (*upto)++)
-        *x++ = *append++;
-
-    *(*output + *upto) = '\0';
-
-    return 1;
-}
-
-#define SBUF(x) x,sizeof(x)
-#define APPENDPARAMS indent_level, output, &upto, &len, write_fd
-#define APPENDNOINDENT 0, output, &upto, &len, write_fd
-
-
-#define _REQUIRE(b,suppress)\
-{\
-    if (DEBUG) printf("\nREQUIRE CALLED AT LINE %d FOR %d bytes, remaining = %d ["\
-            "%02X %02X %02X %02X %02X]\n", __LINE__, (b), remaining,\
-            (remaining >= 1 ? n[0] : 0), \
-            (remaining >= 2 ? n[1] : 0), \
-            (remaining >= 3 ? n[2] : 0), \
-            (remaining >= 4 ? n[3] : 0), \
-            (remaining >= 5 ? n[4] : 0));\
-    if (remaining < (b) && !(!fetch_data_func && suppress))\
-    {\
-        if (!fetch_data_func)\
-            break;\
-        int upto = n - input;\
-        if (input_len - upto - remaining < 0)\
-        {\
-            fprintf(stderr, "Error: remaining past end of input len, maybe overlarge vl blob in input?\n");\
-            exit(1);\
-        }\
-        int needed = 0;\
-        do\
-        {\
-            needed = (b) - remaining;\
-            if (needed < 0) needed = 0;\
-            int bytes_read = (*fetch_data_func)(input + upto + remaining, input_len - upto - remaining, needed, read_fd);\
-            if (bytes_read < 0)\
-            {\
-                if (!suppress)\
-                    fprintf(stderr, "Error: expecting %d nibbles at nibble %d but input was short (only %d remain) code line %d\n", (b)*2, upto*2, remaining * 2,  __LINE__);\
-                break;\
-            }\
-            remaining += bytes_read;\
-        } while(remaining < (b));\
-    }\
-}
-/*
-    printf("\n");\
-    for (int i = 0; i < (n - input) + remaining; ++i)\
-        printf("%02X ", input[i]);\
-    printf("\n");\
-*/
-
-#define REQUIRE(b) _REQUIRE(b,0)
-
-#define ADVANCE(x)\
-{\
-    if (fetch_data_func)\
-        REQUIRE(x);\
-    n += (x); remaining -= (x);\
-    int upto = n - input;\
-    if (fetch_data_func &&\
-        upto > input_len / 2)\
-    {\
-        memcpy(input, n, remaining);\
-        n = input;\
-    }\
-}
+    if (upto == 0)
+        return -1;
 
-#define HEX(out_raw, in_raw, len_raw)\
-{\
-    uint8_t* out = (out_raw);\
-    uint8_t* in = (in_raw);\
-    uint64_t len = (len_raw);\
-    for (int i = 0; i < len; ++i)\
-    {\
-        unsigned char hi = in[i] >> 4U;\
-        unsigned char lo = in[i] & 0xFU;\
-        hi += (hi > 9 ? 'A' - 10 : '0');\
-        lo += (lo > 9 ? 'A' - 10 : '0');\
-        out[i*2+0] = (char)hi;\
-        out[i*2+1] = (char)lo;\
-    }\
+    return upto;
 }
 
-#define SHORTCHECK() ;/* if (upto >= len) return -1;*/
-int to_fixed_point(uint8_t* outbuf, int len, uint64_t mantissa, int64_t exponent, int negative)
-{
-    //printf("mantissa: %llu, exponent: %d\n", mantissa, exponent);
-    int upto = 0;
-    char digits[17];
-    int digitcount = snprintf(digits, 17, "%llu", mantissa);
-    int digitupto = 0;
-    int point = exponent + digitcount;
+// --arrow, every object goes through this writer instead of out as JSON
+static struct arrow_writer* arrow_output = 0;
 
-    int printed_point = 0;
+// --csv or --tsv, the separator for delimited rows instead of JSON, with their --columns and --explode
+static char csv_separator = 0;
+static const char* csv_columns = 0;
+static const char* csv_explode = 0;
 
-    outbuf[upto++] = '"';
-    SHORTCHECK();
-    if (negative)
-    {
-        outbuf[upto++] = '-';
-        SHORTCHECK();
-    }
-
-    for (; point > 0; --point)
-    {
-        outbuf[upto++] = (digitupto >= digitcount ? '0' : digits[digitupto++]);
-        SHORTCHECK();
-    }
+// --cbor and --raw-bytes, XD_CBOR and XD_RAW_BYTES for every context
+static unsigned cbor_flags = 0;
 
-    if (digitupto < digitcount) // && point != 0)
+// write a batch mode error line, anything that isn't safe inside a JSON string is dropped.
+// Arrow, delimited and CBOR output have no room for them, they go to stderr
+void batch_error(struct pipeline_job* job, const char* error, long line)
+{
+    if (arrow_output || csv_separator || cbor_flags)
     {
-        if (digitupto == 0)
-        {
-            outbuf[upto++] = '0';
-            SHORTCHECK();
-        }
-
-        outbuf[upto++] = '.';
-        SHORTCHECK();
-
-        printed_point = 1;
-
-        for (; point < 0; ++point)
-        {
-            outbuf[upto++] = '0';
-            SHORTCHECK();
-        }
-        while (digitupto < digitcount)
-        {
-            outbuf[upto++] = (digitupto >= digitcount ? '0' : digits[digitupto++]);
-            SHORTCHECK();
-        }
+        fprintf(stderr, "line %ld: %s\n", line, error);
+        return;
     }
 
-    // backtrack any trailing zeros
-    if (printed_point)
-        for (; outbuf[upto-1] == '0'; --upto);
+    char str[256];
+    int l = snprintf(str, sizeof(str), "{\"error\":\"");
+    for (const char* x = error; *x && l < 160; ++x)
+        if (*x >= ' ' && *x != '"' && *x != '\\')
+            str[l++] = *x;
+    l += snprintf(str + l, sizeof(str) - l, "\",\"line\":%ld}\n", line);
+    pipeline_out(job, str, l);
+}
 
-    outbuf[upto++] = '"';
-    SHORTCHECK();
+// --fields, null to decode everything
+static const struct xd_projection* projection = 0;
 
-    outbuf[upto++] = '\0';
+// --filter, null to keep every record
+static const struct filter* record_filter = 0;
 
+// --hash, add each object's transaction ID
+static int hash_ids = 0;
 
-    return upto;
-}
+// lines are hex decoded (and filtered) in groups so --hash can hash a group at once, four to a SIMD pass
+#define BATCH_GROUP 4
 
-int is_ascii_currency(uint8_t* y)
+struct batch_record
 {
-    for (int i = 0; i < 12; ++i)
-        if (y[i] != 0)
-            return 0;
-    for (int i = 12; i < 15; ++i)
-    {
-        char x = y[i];
-        if (x >= 'a' && x <= 'z')
-            continue;
-        if (x >= 'A' && x <= 'Z')
-            continue;
-        if (x >= '0' && x <= '9')
-            continue;
-        return 0;
-    }
-    for (int i = 15; i < 20; ++i)
-        if (y[i] != 0)
-            return 0;
-    return 1;
-}
-
-
-int deserialize(
-        uint8_t** output,
-        uint8_t* input,
-        int input_len,
-        int (*fetch_data_func)(uint8_t*, int, int, int), // may be null, refills the input buffer with whatever is available
-        int read_fd,    // may be 0 if unused, the fd to pass to fetch_data_func (if applicable)
-        int write_fd)   // may be 0 if unused, the fd to write output to, if not specified then *output buffer is used
+    uint8_t* rawbytes;
+    size_t rawbytes_capacity;
+    int len;
+    long line_number;
+    const char* error;      // reported in place of the record
+};
+
+// per decoder thread buffers, they live for the whole run
+struct batch_worker
 {
+    struct batch_record records[BATCH_GROUP];
+    struct xd_ctx ctx;
+    struct field_index* index;  // --filter only
+    struct csv_writer csv;      // --csv and --tsv only
+};
 
-    int remaining = input_len - 1;
-    if (input == 0)
+/**
+ * Batch mode, each line of input is a hex encoded object and each line of output is the compact JSON for it.
+ * A bad line produces an {"error":...,"line":N} object in its place and the run carries on.
+ * With --filter a record is indexed first and only decoded if it passes, one that can't be indexed is decoded
+ * anyway so its error is reported.
+ */
+void batch_process(void* worker, struct pipeline_job* job)
+{
+    struct batch_worker* w = worker;
+    if (!w->ctx.definitions)
     {
-
-        // stream mode
-        //
-        if (!fetch_data_func)
-        {
-            fprintf(stderr, "Error: fetch_data_func function ptr must be supplied in stream mode\n");
-            return 1;
-        }
-        input_len = DEFAULT_SIZE;
-        input = malloc(DEFAULT_SIZE);
-        remaining = (*fetch_data_func)(input, input_len, 1, read_fd);
+        xd_init(&w->ctx, definitions, XD_COMPACT | (hash_ids ? XD_TXID : 0) | cbor_flags);
+        xd_set_projection(&w->ctx, projection);
+        // the columns were checked before the run started
+        if (csv_separator)
+            csv_open(&w->csv, definitions, csv_columns, csv_explode, csv_separator);
     }
 
-    int len = DEFAULT_SIZE;
-    if (output)
+    long line_number = job->first_line;
+    char* line = job->text;
+    char* end = job->text + job->text_len;
+    while (line < end)
     {
-        *output = malloc(len);
-    }
-    int upto = 0;
-
-    uint8_t* n = input;
-    int object_level = 0;
-    int array_level = 0;
-    int indent_level = 0;
-
-
-
-
-    uint64_t parent_is_array = 0;
-
-    append(APPENDPARAMS, SBUF("{\n"));
-
-    indent_level++;
-    int nocomma = 1;
-
+        int count = 0;
+        for (; count < BATCH_GROUP && line < end; ++line_number)
+        {
+            struct batch_record* r = &w->records[count];
+            char* eol = memchr(line, '\n', end - line);
+            size_t line_len = (eol ? eol : end) - line;
 
-    while (1)
-    {
+            if (r->rawbytes_capacity < line_len / 2 + 1)
+            {
+                r->rawbytes_capacity = line_len / 2 + 1;
+                free(r->rawbytes);
+                r->rawbytes = malloc(r->rawbytes_capacity);
+                if (!r->rawbytes)
+                    r->rawbytes_capacity = 0;
+            }
 
-        if (fetch_data_func)
-        {
-            _REQUIRE(1, 1);
-            if (remaining == 0)
-                break;
+            int carry = -1;
+            int len = (r->rawbytes ? hex_decode(r->rawbytes, (uint8_t*)line, line_len, &carry) : -2);
+            line += line_len + 1;
+
+            if (len == 0 && carry < 0)
+                continue;   // blank line
+
+            r->len = len;
+            r->line_number = line_number;
+            r->error = 0;
+            if (len == -2)
+                r->error = "Could not allocate input buffer";
+            else if (len < 0)
+                r->error = "Non-hex nibble detected";
+            else if (carry >= 0)
+                r->error = "Hex length must be even";
+            else if (record_filter && !w->index && !(w->index = malloc(sizeof(*w->index))))
+                r->error = "Could not allocate field index";
+            else if (record_filter && field_index_build(w->index, definitions, r->rawbytes, len) == XD_OK &&
+                    !filter_match(record_filter, w->index))
+                continue;
+            count++;
         }
 
-        if (array_level < 0)
+        uint8_t hashes[BATCH_GROUP * 32];
+        if (hash_ids && count > 0)
         {
-            fprintf(stderr, "More close arrays than open arrays! at %d\n", upto);
-            return 0;
-        }
-        if (object_level < 0)
-        {
-            fprintf(stderr, "More close objects than open objects! at %d\n", upto);
-            return 0;
+            const void* inputs[BATCH_GROUP];
+            size_t lens[BATCH_GROUP];
+            for (int i = 0; i < BATCH_GROUP; ++i)
+            {
+                int valid = (i < count && !w->records[i].error);
+                inputs[i] = (valid ? w->records[i].rawbytes : (uint8_t*)"");
+                lens[i] = (valid ? w->records[i].len : 0);
+            }
+            sha512_half_prefixed_x4(hashes, SHA512_PREFIX_TRANSACTION_ID, inputs, lens);
         }
 
-        int field_code = -1;
-        int type_code = -1;
-
-        if (*n == 0)
+        for (int i = 0; i < count; ++i)
         {
-            REQUIRE(3);
-            // 3 byte header
-            if (remaining < 2)
+            struct batch_record* r = &w->records[i];
+            if (r->error)
             {
-                fprintf(stderr, "\nError parsing 3 byte header, not enough bytes remaining\n");
-                return 0;
+                batch_error(job, r->error, r->line_number);
+                continue;
             }
-
-            type_code = *(n+1);
-            field_code = *(n+2);
-            ADVANCE(3);
-        }
-        else if ((*n >> 4U) == 0)
-        {
-            REQUIRE(2);
-            // 2 byte header (typecode >= 16 && field code < 16)
-            if (remaining < 1)
+            if (hash_ids)
+                xd_set_txid(&w->ctx, hashes + i * 32);
+            if (arrow_output)
             {
-                fprintf(stderr, "\nError parsing 2 byte header, not enough bytes remaining\n");
-                return 0;
+                if (arrow_append(arrow_output, &w->ctx, r->rawbytes, r->len) != XD_OK)
+                    batch_error(job, w->ctx.error_message, r->line_number);
             }
-            field_code = (*n & 0xFU);
-            type_code = *(n+1);
-            ADVANCE(2);
-        }
-        else if ((*n & 0xFU) == 0)
-        {
-            REQUIRE(2);
-            // 2 byte header (typecode < 16 && field code >= 16)
-            if (remaining < 1)
+            else if (csv_separator)
             {
-                fprintf(stderr, "\nError parsing 2 byte header, not enough bytes remaining\n");
-                return 0;
+                if (csv_append(&w->csv, &w->ctx, r->rawbytes, r->len) != XD_OK)
+                    batch_error(job, w->ctx.error_message, r->line_number);
+                else
+                    pipeline_out(job, w->csv.output, w->csv.output_len);
             }
-            type_code = (*n >> 4U);
-            field_code = *(n+1);
-            ADVANCE(2);
-        }
-        else
-        {
-            // 1 byte header
-
-            type_code = (*n >> 4U);
-            field_code = (*n & 0xFU);
-            ADVANCE(1);
+            else if (xd_decode(&w->ctx, r->rawbytes, r->len) != XD_OK)
+                batch_error(job, w->ctx.error_message, r->line_number);
+            else
+                pipeline_out(job, w->ctx.output, w->ctx.output_len);
         }
+    }
+}
 
+void batch_finish(void* worker)
+{
+    struct batch_worker* w = worker;
+    for (int i = 0; i < BATCH_GROUP; ++i)
+        free(w->records[i].rawbytes);
+    free(w->index);
+    csv_free(&w->csv);
+    xd_free(&w->ctx);
+}
 
-        int end_of_object = ((type_code == 14 || type_code == 15) && field_code == 1);
+// binary stream input, the decoder's buffer is filled directly with as much as each read returns
+int binary_refill(void* user, uint8_t* input, int input_len, int min_bytes_to_return)
+{
+    int read_fd = *(int*)user;
+    if (min_bytes_to_return < 1)
+        min_bytes_to_return = 1;
 
-        int end_of_array = (parent_is_array & 1 && end_of_object);
+    int upto = 0;
+    while (upto < min_bytes_to_return && upto < input_len)
+    {
+        ssize_t bytes_read = read(read_fd, input + upto, input_len - upto);
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read < 0)
+            return -2;
+        if (bytes_read == 0)
+            break;
+        upto += bytes_read;
+    }
 
+    if (upto == 0)
+        return -1;
 
-        if (!nocomma && !end_of_array && !end_of_object)
-            append(APPENDNOINDENT, SBUF(",\n"));
+    return upto;
+}
 
-        if (end_of_array || end_of_object)
-            append(APPENDNOINDENT, SBUF("\n"));
+void print_stats(void)
+{
+    uint64_t hits, misses;
+    account_cache_stats(&hits, &misses);
+    fprintf(stderr, "account cache: %llu hits, %llu misses\n",
+            (unsigned long long)hits, (unsigned long long)misses);
+}
 
-        if (DEBUG)
-            printf("end of array: %d, end of object %d\n", end_of_array, end_of_object);
+static struct xd_ctx* main_context = 0;
 
-        if (!end_of_object && !end_of_array)
-            _REQUIRE(1,1);
+// runs before print_stats, the context's cache counters only reach --stats once it is freed
+void free_context(void)
+{
+    if (main_context)
+        xd_free(main_context);
+}
 
-        nocomma = 0;
+// exit code for a decode, printing the reason if it failed
+int decode_result(struct xd_ctx* ctx, int error)
+{
+    if (error == XD_OK)
+        return 0;
+    fprintf(stderr, "%s (at byte %zu)\nCould not deserialize\n", ctx->error_message, ctx->error_offset);
+    return 1;
+}
 
-        if (type_code == 0)
-        {
-            fprintf(stderr, "Invalid typecode 0 at %d\n", upto);
+static struct csv_writer* csv_output = 0;
 
-            return 0;
-        }
+// decode one object to stdout, from memory or through `fetch` when it is set
+int decode_one(struct xd_ctx* ctx, const uint8_t* input, size_t input_len, xd_fetch fetch, void* user)
+{
+    if (csv_output)
+    {
+        int error = (fetch ? csv_append_stream(csv_output, ctx, fetch, user) :
+                             csv_append(csv_output, ctx, input, input_len));
+        if (error != XD_OK)
+            return decode_result(ctx, error);
+        fwrite(csv_output->output, 1, csv_output->output_len, stdout);
+        return 0;
+    }
 
-        int error = 0;
-
-        int size =
-            ( type_code == 1 ? 2U : // UINT16
-            ( type_code == 2 ? 4U : // uint32
-            ( type_code == 3 ? 8U : // uint64
-            ( type_code == 4 ? 16U : // uint128
-            ( type_code == 5 ? 32U : // uint256
-            ( type_code == 6 ? 8U  : // amount (8 bytes or 48 bytes)
-            ( type_code == 7 ? 0U  : // blob vl
-            ( type_code == 8 ? 21U : // account
-            ( type_code == 16 ? 1U : // uint8
-            ( type_code == 17 ? 20U : // uint160
-            ( type_code == 18 ? 0U  : // pathset
-            ( type_code == 19 ? 0U : // vector256
-            ( type_code == 14 ? 0U : // array/object
-            ( type_code == 15 ? 0U : // array/object
-                (error=1)))))))))))))));
-
-        if (error)
-        {
-            fprintf(stderr, "Error, unknown typecode %lu at byte %d\n", type_code, (input - n));
-            return 0;
-        }
+    if (!arrow_output)
+        return decode_result(ctx,
+                (fetch ? xd_decode_stream(ctx, fetch, user, 1) : xd_decode_to_fd(ctx, input, input_len, 1)));
 
+    int error = (fetch ? arrow_append_stream(arrow_output, ctx, fetch, user) :
+                         arrow_append(arrow_output, ctx, input, input_len));
+    if (error != XD_OK)
+        return decode_result(ctx, error);
+    if (!arrow_close(arrow_output))
+        return fprintf(stderr, "Arrow output failed: %s\n", arrow_output->error);
+    return 0;
+}
 
-        uint32_t field_id = (type_code << 16U) + field_code;
+// uppercase hex of `len` bytes then a newline into `out`, which has room for len * 2 + 1
+static size_t hex_line(char* out, const uint8_t* in, size_t len)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < len; ++i)
+    {
+        out[i * 2] = digits[in[i] >> 4U];
+        out[i * 2 + 1] = digits[in[i] & 0xFU];
+    }
+    out[len * 2] = '\n';
+    return len * 2 + 1;
+}
 
-        if (DEBUG)
-            printf("field_id: %llx\n", field_id);
+// --encode --batch, per thread state
+struct encode_worker
+{
+    struct encoder encoder;
+    char* hex;
+    size_t hex_capacity;
+};
 
-        if (parent_is_array & 1 && !((type_code == 14 || type_code == 15) && field_code == 1))
-        {
-            append(APPENDPARAMS, SBUF("{\n"));
-            indent_level++;
-        }
+// each line of input is a JSON object and each line of output the hex of its binary, bad lines go to stderr
+void encode_process(void* worker, struct pipeline_job* job)
+{
+    struct encode_worker* w = worker;
+    if (!w->encoder.definitions && !encode_init(&w->encoder, definitions))
+    {
+        fprintf(stderr, "line %ld: Could not allocate the encoder\n", job->first_line);
+        return;
+    }
 
-        if (field_id == -1UL) append(APPENDPARAMS, SBUF("\"Invalid\": "));
-        else if (field_id == 0UL) append(APPENDPARAMS, SBUF("\"Generic\": "));
-        else if (field_id == 0x27120101UL) append(APPENDPARAMS, SBUF("\"LedgerEntry\": "));
-        else if (field_id == 0x27110101UL) append(APPENDPARAMS, SBUF("\"Transaction\": "));
-        else if (field_id == 0x27130101UL) append(APPENDPARAMS, SBUF("\"Validation\": "));
-        else if (field_id == 0x27140101UL) append(APPENDPARAMS, SBUF("\"Metadata\": "));
-        else if (field_id == 0x50101UL) append(APPENDPARAMS, SBUF("\"Hash\": "));
-        else if (field_id == 0x50102UL) append(APPENDPARAMS, SBUF("\"Index\": "));
-        else if (field_id == 0x100001UL) append(APPENDPARAMS, SBUF("\"CloseResolution\": "));
-        else if (field_id == 0x100002UL) append(APPENDPARAMS, SBUF("\"Method\": "));
-        else if (field_id == 0x100003UL) append(APPENDPARAMS, SBUF("\"TransactionResult\": "));
-        else if (field_id == 0x100010UL) append(APPENDPARAMS, SBUF("\"TickSize\": "));
-        else if (field_id == 0x100011UL) append(APPENDPARAMS, SBUF("\"UNLModifyDisabling\": "));
-        else if (field_id == 0x10001UL) append(APPENDPARAMS, SBUF("\"LedgerEntryType\": "));
-        else if (field_id == 0x10002UL) append(APPENDPARAMS, SBUF("\"TransactionType\": "));
-        else if (field_id == 0x10003UL) append(APPENDPARAMS, SBUF("\"SignerWeight\": "));
-        else if (field_id == 0x10010UL) append(APPENDPARAMS, SBUF("\"Version\": "));
-        else if (field_id == 0x20002UL) append(APPENDPARAMS, SBUF("\"Flags\": "));
-        else if (field_id == 0x20003UL) append(APPENDPARAMS, SBUF("\"SourceTag\": "));
-        else if (field_id == 0x20004UL) append(APPENDPARAMS, SBUF("\"Sequence\": "));
-        else if (field_id == 0x20005UL) append(APPENDPARAMS, SBUF("\"PreviousTxnLgrSeq\": "));
-        else if (field_id == 0x20006UL) append(APPENDPARAMS, SBUF("\"LedgerSequence\": "));
-        else if (field_id == 0x20007UL) append(APPENDPARAMS, SBUF("\"CloseTime\": "));
-        else if (field_id == 0x20008UL) append(APPENDPARAMS, SBUF("\"ParentCloseTime\": "));
-        else if (field_id == 0x20009UL) append(APPENDPARAMS, SBUF("\"SigningTime\": "));
-        else if (field_id == 0x2000aUL) append(APPENDPARAMS, SBUF("\"Expiration\": "));
-        else if (field_id == 0x2000bUL) append(APPENDPARAMS, SBUF("\"erRate\": "));
-        else if (field_id == 0x2000cUL) append(APPENDPARAMS, SBUF("\"WalletSize\": "));
-        else if (field_id == 0x2000dUL) append(APPENDPARAMS, SBUF("\"OwnerCount\": "));
-        else if (field_id == 0x2000eUL) append(APPENDPARAMS, SBUF("\"DestinationTag\": "));
-        else if (field_id == 0x20010UL) append(APPENDPARAMS, SBUF("\"HighQualityIn\": "));
-        else if (field_id == 0x20011UL) append(APPENDPARAMS, SBUF("\"HighQualityOut\": "));
-        else if (field_id == 0x20012UL) append(APPENDPARAMS, SBUF("\"LowQualityIn\": "));
-        else if (field_id == 0x20013UL) append(APPENDPARAMS, SBUF("\"LowQualityOut\": "));
-        else if (field_id == 0x20014UL) append(APPENDPARAMS, SBUF("\"QualityIn\": "));
-        else if (field_id == 0x20015UL) append(APPENDPARAMS, SBUF("\"QualityOut\": "));
-        else if (field_id == 0x20016UL) append(APPENDPARAMS, SBUF("\"StampEscrow\": "));
-        else if (field_id == 0x20017UL) append(APPENDPARAMS, SBUF("\"BondAmount\": "));
-        else if (field_id == 0x20018UL) append(APPENDPARAMS, SBUF("\"LoadFee\": "));
-        else if (field_id == 0x20019UL) append(APPENDPARAMS, SBUF("\"OfferSequence\": "));
-        else if (field_id == 0x2001aUL) append(APPENDPARAMS, SBUF("\"FirstLedgerSequence\": "));
-        else if (field_id == 0x2001bUL) append(APPENDPARAMS, SBUF("\"LastLedgerSequence\": "));
-        else if (field_id == 0x2001cUL) append(APPENDPARAMS, SBUF("\"TransactionIndex\": "));
-        else if (field_id == 0x2001dUL) append(APPENDPARAMS, SBUF("\"OperationLimit\": "));
-        else if (field_id == 0x2001eUL) append(APPENDPARAMS, SBUF("\"ReferenceFeeUnits\": "));
-        else if (field_id == 0x2001fUL) append(APPENDPARAMS, SBUF("\"ReserveBase\": "));
-        else if (field_id == 0x20020UL) append(APPENDPARAMS, SBUF("\"ReserveIncrement\": "));
-        else if (field_id == 0x20021UL) append(APPENDPARAMS, SBUF("\"SetFlag\": "));
-        else if (field_id == 0x20022UL) append(APPENDPARAMS, SBUF("\"ClearFlag\": "));
-        else if (field_id == 0x20023UL) append(APPENDPARAMS, SBUF("\"SignerQuorum\": "));
-        else if (field_id == 0x20024UL) append(APPENDPARAMS, SBUF("\"CancelAfter\": "));
-        else if (field_id == 0x20025UL) append(APPENDPARAMS, SBUF("\"FinishAfter\": "));
-        else if (field_id == 0x20026UL) append(APPENDPARAMS, SBUF("\"SignerListID\": "));
-        else if (field_id == 0x20027UL) append(APPENDPARAMS, SBUF("\"SettleDelay\": "));
-        else if (field_id == 0x20028UL) append(APPENDPARAMS, SBUF("\"HookStateCount\": "));
-        else if (field_id == 0x20029UL) append(APPENDPARAMS, SBUF("\"HookReserveCount\": "));
-        else if (field_id == 0x2002aUL) append(APPENDPARAMS, SBUF("\"HookDataMaxSize\": "));
-        else if (field_id == 0x2002bUL) append(APPENDPARAMS, SBUF("\"EmitGeneration\": "));
-        else if (field_id == 0x30001UL) append(APPENDPARAMS, SBUF("\"IndexNext\": "));
-        else if (field_id == 0x30002UL) append(APPENDPARAMS, SBUF("\"IndexPrevious\": "));
-        else if (field_id == 0x30003UL) append(APPENDPARAMS, SBUF("\"BookNode\": "));
-        else if (field_id == 0x30004UL) append(APPENDPARAMS, SBUF("\"OwnerNode\": "));
-        else if (field_id == 0x30005UL) append(APPENDPARAMS, SBUF("\"BaseFee\": "));
-        else if (field_id == 0x30006UL) append(APPENDPARAMS, SBUF("\"ExchangeRate\": "));
-        else if (field_id == 0x30007UL) append(APPENDPARAMS, SBUF("\"LowNode\": "));
-        else if (field_id == 0x30008UL) append(APPENDPARAMS, SBUF("\"HighNode\": "));
-        else if (field_id == 0x30009UL) append(APPENDPARAMS, SBUF("\"DestinationNode\": "));
-        else if (field_id == 0x3000aUL) append(APPENDPARAMS, SBUF("\"Cookie\": "));
-        else if (field_id == 0x3000bUL) append(APPENDPARAMS, SBUF("\"ServerVersion\": "));
-        else if (field_id == 0x3000cUL) append(APPENDPARAMS, SBUF("\"EmitBurden\": "));
-        else if (field_id == 0x30010UL) append(APPENDPARAMS, SBUF("\"HookOn\": "));
-        else if (field_id == 0x40001UL) append(APPENDPARAMS, SBUF("\"EmailHash\": "));
-        else if (field_id == 0x110001UL) append(APPENDPARAMS, SBUF("\"TakerPaysCurrency\": "));
-        else if (field_id == 0x110002UL) append(APPENDPARAMS, SBUF("\"TakerPaysIssuer\": "));
-        else if (field_id == 0x110003UL) append(APPENDPARAMS, SBUF("\"TakerGetsCurrency\": "));
-        else if (field_id == 0x110004UL) append(APPENDPARAMS, SBUF("\"TakerGetsIssuer\": "));
-        else if (field_id == 0x50001UL) append(APPENDPARAMS, SBUF("\"LedgerHash\": "));
-        else if (field_id == 0x50002UL) append(APPENDPARAMS, SBUF("\"ParentHash\": "));
-        else if (field_id == 0x50003UL) append(APPENDPARAMS, SBUF("\"TransactionHash\": "));
-        else if (field_id == 0x50004UL) append(APPENDPARAMS, SBUF("\"AccountHash\": "));
-        else if (field_id == 0x50005UL) append(APPENDPARAMS, SBUF("\"PreviousTxnID\": "));
-        else if (field_id == 0x50006UL) append(APPENDPARAMS, SBUF("\"LedgerIndex\": "));
-        else if (field_id == 0x50007UL) append(APPENDPARAMS, SBUF("\"WalletLocator\": "));
-        else if (field_id == 0x50008UL) append(APPENDPARAMS, SBUF("\"RootIndex\": "));
-        else if (field_id == 0x50009UL) append(APPENDPARAMS, SBUF("\"AccountTxnID\": "));
-        else if (field_id == 0x5000aUL) append(APPENDPARAMS, SBUF("\"EmitParentTxnID\": "));
-        else if (field_id == 0x5000bUL) append(APPENDPARAMS, SBUF("\"EmitNonce\": "));
-        else if (field_id == 0x50010UL) append(APPENDPARAMS, SBUF("\"BookDirectory\": "));
-        else if (field_id == 0x50011UL) append(APPENDPARAMS, SBUF("\"InvoiceID\": "));
-        else if (field_id == 0x50012UL) append(APPENDPARAMS, SBUF("\"Nickname\": "));
-        else if (field_id == 0x50013UL) append(APPENDPARAMS, SBUF("\"Amendment\": "));
-        else if (field_id == 0x50014UL) append(APPENDPARAMS, SBUF("\"TicketID\": "));
-        else if (field_id == 0x50015UL) append(APPENDPARAMS, SBUF("\"Digest\": "));
-        else if (field_id == 0x50016UL) append(APPENDPARAMS, SBUF("\"PayChannel\": "));
-        else if (field_id == 0x50017UL) append(APPENDPARAMS, SBUF("\"ConsensusHash\": "));
-        else if (field_id == 0x50018UL) append(APPENDPARAMS, SBUF("\"CheckID\": "));
-        else if (field_id == 0x50019UL) append(APPENDPARAMS, SBUF("\"ValidatedHash\": "));
-        else if (field_id == 0x60001UL) append(APPENDPARAMS, SBUF("\"Amount\": "));
-        else if (field_id == 0x60002UL) append(APPENDPARAMS, SBUF("\"Balance\": "));
-        else if (field_id == 0x60003UL) append(APPENDPARAMS, SBUF("\"LimitAmount\": "));
-        else if (field_id == 0x60004UL) append(APPENDPARAMS, SBUF("\"TakerPays\": "));
-        else if (field_id == 0x60005UL) append(APPENDPARAMS, SBUF("\"TakerGets\": "));
-        else if (field_id == 0x60006UL) append(APPENDPARAMS, SBUF("\"LowLimit\": "));
-        else if (field_id == 0x60007UL) append(APPENDPARAMS, SBUF("\"HighLimit\": "));
-        else if (field_id == 0x60008UL) append(APPENDPARAMS, SBUF("\"Fee\": "));
-        else if (field_id == 0x60009UL) append(APPENDPARAMS, SBUF("\"SendMax\": "));
-        else if (field_id == 0x6000aUL) append(APPENDPARAMS, SBUF("\"DeliverMin\": "));
-        else if (field_id == 0x60010UL) append(APPENDPARAMS, SBUF("\"MinimumOffer\": "));
-        else if (field_id == 0x60011UL) append(APPENDPARAMS, SBUF("\"RippleEscrow\": "));
-        else if (field_id == 0x60012UL) append(APPENDPARAMS, SBUF("\"DeliveredAmount\": "));
-        else if (field_id == 0x70001UL) append(APPENDPARAMS, SBUF("\"PublicKey\": "));
-        else if (field_id == 0x70002UL) append(APPENDPARAMS, SBUF("\"MessageKey\": "));
-        else if (field_id == 0x70003UL) append(APPENDPARAMS, SBUF("\"SigningPubKey\": "));
-        else if (field_id == 0x70004UL) append(APPENDPARAMS, SBUF("\"TxnSignature\": "));
-        else if (field_id == 0x70006UL) append(APPENDPARAMS, SBUF("\"Signature\": "));
-        else if (field_id == 0x70007UL) append(APPENDPARAMS, SBUF("\"Domain\": "));
-        else if (field_id == 0x70008UL) append(APPENDPARAMS, SBUF("\"FundCode\": "));
-        else if (field_id == 0x70009UL) append(APPENDPARAMS, SBUF("\"RemoveCode\": "));
-        else if (field_id == 0x7000aUL) append(APPENDPARAMS, SBUF("\"ExpireCode\": "));
-        else if (field_id == 0x7000bUL) append(APPENDPARAMS, SBUF("\"CreateCode\": "));
-        else if (field_id == 0x7000cUL) append(APPENDPARAMS, SBUF("\"MemoType\": "));
-        else if (field_id == 0x7000dUL) append(APPENDPARAMS, SBUF("\"MemoData\": "));
-        else if (field_id == 0x7000eUL) append(APPENDPARAMS, SBUF("\"MemoFormat\": "));
-        else if (field_id == 0x70010UL) append(APPENDPARAMS, SBUF("\"Fulfillment\": "));
-        else if (field_id == 0x70011UL) append(APPENDPARAMS, SBUF("\"Condition\": "));
-        else if (field_id == 0x70012UL) append(APPENDPARAMS, SBUF("\"MasterSignature\": "));
-        else if (field_id == 0x70013UL) append(APPENDPARAMS, SBUF("\"UNLModifyValidator\": "));
-        else if (field_id == 0x70014UL) append(APPENDPARAMS, SBUF("\"NegativeUNLToDisable\": "));
-        else if (field_id == 0x70015UL) append(APPENDPARAMS, SBUF("\"NegativeUNLToReEnable\": "));
-        else if (field_id == 0x70016UL) append(APPENDPARAMS, SBUF("\"HookData\": "));
-        else if (field_id == 0x80001UL) append(APPENDPARAMS, SBUF("\"Account\": "));
-        else if (field_id == 0x80002UL) append(APPENDPARAMS, SBUF("\"Owner\": "));
-        else if (field_id == 0x80003UL) append(APPENDPARAMS, SBUF("\"Destination\": "));
-        else if (field_id == 0x80004UL) append(APPENDPARAMS, SBUF("\"Issuer\": "));
-        else if (field_id == 0x80005UL) append(APPENDPARAMS, SBUF("\"Authorize\": "));
-        else if (field_id == 0x80006UL) append(APPENDPARAMS, SBUF("\"Unauthorize\": "));
-        else if (field_id == 0x80007UL) append(APPENDPARAMS, SBUF("\"Target\": "));
-        else if (field_id == 0x80008UL) append(APPENDPARAMS, SBUF("\"RegularKey\": "));
-        else if (field_id == 0x120001UL) append(APPENDPARAMS, SBUF("\"Paths\": "));
-        else if (field_id == 0x130001UL) append(APPENDPARAMS, SBUF("\"Indexes\": "));
-        else if (field_id == 0x130002UL) append(APPENDPARAMS, SBUF("\"Hashes\": "));
-        else if (field_id == 0x130003UL) append(APPENDPARAMS, SBUF("\"Amendments\": "));
-        else if (field_id == 0xe0002UL) append(APPENDPARAMS, SBUF("\"TransactionMetaData\": "));
-        else if (field_id == 0xe0003UL) append(APPENDPARAMS, SBUF("\"CreatedNode\": "));
-        else if (field_id == 0xe0004UL) append(APPENDPARAMS, SBUF("\"DeletedNode\": "));
-        else if (field_id == 0xe0005UL) append(APPENDPARAMS, SBUF("\"ModifiedNode\": "));
-        else if (field_id == 0xe0006UL) append(APPENDPARAMS, SBUF("\"PreviousFields\": "));
-        else if (field_id == 0xe0007UL) append(APPENDPARAMS, SBUF("\"FinalFields\": "));
-        else if (field_id == 0xe0008UL) append(APPENDPARAMS, SBUF("\"NewFields\": "));
-        else if (field_id == 0xe0009UL) append(APPENDPARAMS, SBUF("\"TemplateEntry\": "));
-        else if (field_id == 0xe000aUL) append(APPENDPARAMS, SBUF("\"Memo\": "));
-        else if (field_id == 0xe000bUL) append(APPENDPARAMS, SBUF("\"SignerEntry\": "));
-        else if (field_id == 0xe000cUL) append(APPENDPARAMS, SBUF("\"EmitDetails\": "));
-        else if (field_id == 0xe0010UL) append(APPENDPARAMS, SBUF("\"Signer\": "));
-        else if (field_id == 0xe0012UL) append(APPENDPARAMS, SBUF("\"Majority\": "));
-        else if (field_id == 0xe0013UL) append(APPENDPARAMS, SBUF("\"NegativeUNLEntry\": "));
-        else if (field_id == 0xf0002UL) append(APPENDPARAMS, SBUF("\"SigningAccounts\": "));
-        else if (field_id == 0xf0003UL) append(APPENDPARAMS, SBUF("\"Signers\": "));
-        else if (field_id == 0xf0004UL) append(APPENDPARAMS, SBUF("\"SignerEntries\": "));
-        else if (field_id == 0xf0005UL) append(APPENDPARAMS, SBUF("\"Template\": "));
-        else if (field_id == 0xf0006UL) append(APPENDPARAMS, SBUF("\"Necessary\": "));
-        else if (field_id == 0xf0007UL) append(APPENDPARAMS, SBUF("\"Sufficient\": "));
-        else if (field_id == 0xf0008UL) append(APPENDPARAMS, SBUF("\"AffectedNodes\": "));
-        else if (field_id == 0xf0009UL) append(APPENDPARAMS, SBUF("\"Memos\": "));
-        else if (field_id == 0xf0010UL) append(APPENDPARAMS, SBUF("\"Majorities\": "));
-        else if (field_id == 0xf0011UL) append(APPENDPARAMS, SBUF("\"NegativeUNL\": "));
-        else if (field_id == 0xE0001UL || field_id == 0xF0001UL)
-        {
-            // do nothing (end of object/array)
-        }
-        else
-        {
-            fprintf(stderr, "Error: Unknown field_id %05X\n", field_id);
-            break;
-        }
+    long line_number = job->first_line;
+    for (char* line = job->text; line < job->text + job->text_len; ++line_number)
+    {
+        char* eol = memchr(line, '\n', job->text + job->text_len - line);
+        size_t line_len = (eol ? eol : job->text + job->text_len) - line;
+        char* text = line;
+        line += line_len + 1;
+        // blank line, the job's text isn't NUL terminated so the scan stops at the line's end
+        size_t blank = 0;
+        while (blank < line_len && (text[blank] == ' ' || text[blank] == '\t' || text[blank] == '\r'))
+            blank++;
+        if (blank == line_len)
+            continue;
 
-        if (type_code == 18)
+        struct encoder* e = &w->encoder;
+        if (encode_json(e, text, line_len) != XD_OK)
         {
-            append(APPENDNOINDENT, SBUF("[\n"));
-            indent_level++;
-            append(APPENDPARAMS, SBUF("[\n"));
-            indent_level++;
-
-            for (int path_count = 0; 1; ++path_count)
-            {
-                uint8_t path_type = *n;
-                ADVANCE(1);
-
-                //printf("\nPATH TYPE: %02X\n", path_type);
-                if (path_type == 0x00U)
-                    break;
-
-
-                if (path_type == 0xFFU)
-                {
-                    append(APPENDNOINDENT, SBUF("\n"));
-                    indent_level--;
-                    append(APPENDPARAMS, SBUF("],\n"));
-                    append(APPENDPARAMS, SBUF("[\n"));
-                    indent_level++;
-                    path_count = -1;
-                    continue;
-                }
-
-                if (path_count > 0)
-                    append(APPENDNOINDENT, SBUF(",\n"));
-
-                append(APPENDPARAMS, SBUF("{\n"));
-                indent_level++;
-
-                char path_type_str[128];
-                int l = snprintf(path_type_str, 128, "\"type\": %d,\n", path_type);
-                append(APPENDPARAMS, path_type_str, l);
-
-
-                if (path_type & 0x01U)
-                {
-                    REQUIRE(20);
-                    path_type -= 0x01U;
-
-                    // account
-                    append(APPENDPARAMS, SBUF("\"account\": \""));
-                    char acc[64];
-                    size_t acc_size = 64;
-                    if (!b58check_enc(acc, &acc_size, 0, n, 20))
-                    {
-                        fprintf(stderr, "Error: could not base58 encode\n");
-                        return 0;
-                    }
-                    acc[0] = 'r';
-                    append(APPENDNOINDENT, acc, acc_size);
-                    if (path_type)
-                        append(APPENDNOINDENT, SBUF("\",\n"));
-                    else
-                        append(APPENDNOINDENT, SBUF("\"\n"));
-
-                    ADVANCE(20);
-               }
-
-                if (path_type & 0x10U)
-                {
-                    // currency
-                    path_type -= 0x10U;
-
-                    append(APPENDPARAMS, SBUF("\"currency\": \""));
-
-                    REQUIRE(20);
-                    char currency[41];
-                    uint64_t* c = (void*)(n);
-
-                    if (!c[0] && !c[1] && !*((uint32_t*)(n + 16)))
-                    {
-                        currency[0] = 'X';
-                        currency[1] = 'R';
-                        currency[2] = 'P';
-                        currency[3] = '\0';
-                    }
-                    else if (is_ascii_currency(n))
-                    {
-                        currency[0] = n[12];
-                        currency[1] = n[13];
-                        currency[2] = n[14];
-                        currency[3] = '\0';
-                    }
-                    else
-                        HEX(currency, n, 20);
-
-                    currency[40] = '\0';
-
-                    append(APPENDNOINDENT, currency, 40);
-
-                    if (path_type)
-                        append(APPENDNOINDENT, SBUF("\",\n"));
-                    else
-                        append(APPENDNOINDENT, SBUF("\"\n"));
-
-                    ADVANCE(20);
-                }
-
-                if (path_type & 0x20U)
-                {
-                    // issuer
-                    REQUIRE(20);
-
-                    // account
-                    append(APPENDPARAMS, SBUF("\"issuer\": \""));
-                    char acc[64];
-                    size_t acc_size = 64;
-                    if (!b58check_enc(acc, &acc_size, 0, n, 20))
-                    {
-                        fprintf(stderr, "Error: could not base58 encode\n");
-                        return 0;
-                    }
-                    acc[0] = 'r';
-                    append(APPENDNOINDENT, acc, acc_size);
-                    append(APPENDNOINDENT, SBUF("\"\n"));
-                    ADVANCE(20);
-                }
-
-                indent_level--;
-                append(APPENDPARAMS, SBUF("}"));
-
-            }
-            append(APPENDNOINDENT, SBUF("\n"));
-            indent_level--;
-            append(APPENDPARAMS, SBUF("]\n"));
-            indent_level--;
-            append(APPENDPARAMS, SBUF("]\n"));
-
-        }
-        else if (type_code == 14)
-        {   // object
-            if (field_code == 1)
-            {
-                indent_level--;
-                object_level--;
-                append(APPENDPARAMS, SBUF("}"));
-                parent_is_array >>= 1U;
-                if (parent_is_array & 1)
-                {
-                    indent_level--;
-                    append(APPENDNOINDENT, SBUF("\n"));
-                    append(APPENDPARAMS, SBUF("}"));
-                }
-            }
-            else
-            {
-                append(APPENDNOINDENT, SBUF("{\n"));
-                object_level++;
-                indent_level++;
-                nocomma = 1;
-                parent_is_array <<= 1U;
-            }
-        }
-        else if (type_code == 15)
-        {   // array
-            if (field_code == 1)
-            {
-                indent_level--;
-                array_level--;
-                append(APPENDPARAMS, SBUF("]"));
-                parent_is_array >>= 1U;
-                if (parent_is_array & 1)
-                {
-                    indent_level--;
-                    append(APPENDNOINDENT, SBUF("\n"));
-                    append(APPENDPARAMS, SBUF("}"));
-                }
-            }
-            else
-            {
-                append(APPENDNOINDENT, SBUF("[\n"));
-                array_level++;
-                indent_level++;
-                nocomma = 1;
-                parent_is_array <<= 1U;
-                parent_is_array |= 1U;
-            }
+            fprintf(stderr, "line %ld: %s\n", line_number, e->error_message);
+            continue;
         }
-        else if (type_code == 8) // account
+        if (w->hex_capacity < e->output_len * 2 + 1)
         {
-
-         //   printf("upto: %d, remaining: %d\n", upto, remaining);
-            REQUIRE(1);
-            uint8_t acc_size = *n;
-            ADVANCE(1);
-            // special case where account is null
-            if (acc_size == 0)
+            free(w->hex);
+            w->hex_capacity = e->output_len * 2 + 1;
+            if (!(w->hex = malloc(w->hex_capacity)))
             {
-                append(APPENDNOINDENT, SBUF("\"\""));
-            }
-            else
-            {
-                REQUIRE(20);
-
-                char acc[64];
-                size_t acc_size = 64;
-                if (!b58check_enc(acc, &acc_size, 0, n, 20))
-                {
-                    fprintf(stderr, "Error: could not base58 encode\n");
-                    return 0;
-                }
-                acc[0] = 'r';
-                append(APPENDNOINDENT, SBUF("\""));
-                append(APPENDNOINDENT, acc, acc_size);
-                append(APPENDNOINDENT, SBUF("\""));
-                ADVANCE(20);
+                w->hex_capacity = 0;
+                fprintf(stderr, "line %ld: Could not allocate output buffer\n", line_number);
+                continue;
             }
         }
-        else if (type_code == 4 || type_code == 5 || type_code == 17)
-        {
-            // uint128, uint256, uint160
-            REQUIRE(size);
-
-            append(APPENDNOINDENT, SBUF("\""));
-            char hexout[513];
-            HEX(hexout, n, size);
-            append(APPENDNOINDENT, hexout, size*2);
-            append(APPENDNOINDENT, SBUF("\""));
-
-            ADVANCE(size);
-        }
-        else if (type_code == 7 || type_code == 19) // blob
-        {
-            int64_t field_len = *n;
-            if (field_len <= 192)
-            {
-                // one byte size
-                ADVANCE(1);
-            }
-            else if (field_len <= 12480)
-            {
-                // two byte size
-                REQUIRE(2);
-                field_len = 193 + ((field_len - 193) * 256) + *(n+1);
-                ADVANCE(2);
-            }
-            else
-            {
-                // three byte size
-                REQUIRE(3);
-                field_len = 12481 + ((field_len - 241) * 0xFFFFU) + ((*(n+1)) * 256) + *(n+2);
-                ADVANCE(3);
-            }
-
-            //printf("vl len: %d\n", field_len);
-            REQUIRE(field_len);
-
-            append(APPENDNOINDENT, SBUF("\""));
-            char hexout[1024];
-            int already_printed = 0;
-            int to_print = field_len - already_printed;
-            do
-            {
-                if (to_print > sizeof(hexout)/2)
-                    to_print = sizeof(hexout)/2;
-                HEX(hexout, n + already_printed, to_print);
-                append(APPENDNOINDENT, hexout, to_print*2);
-                already_printed += to_print;
-                to_print = field_len - already_printed;
-            } while (to_print > 0);
+        pipeline_out(job, w->hex, hex_line(w->hex, e->output, e->output_len));
+    }
+}
 
-            append(APPENDNOINDENT, SBUF("\""));
+void encode_finish(void* worker)
+{
+    struct encode_worker* w = worker;
+    encode_free(&w->encoder);
+    free(w->hex);
+}
 
-            ADVANCE(field_len);
-        }
-        else if (type_code == 6) // amount
+// the whole of `fd`, null if it could not be read
+static char* read_all(int fd, size_t* len)
+{
+    size_t capacity = STREAM_BLOCK_SIZE;
+    char* text = malloc(capacity);
+    *len = 0;
+    while (text)
+    {
+        if (*len == capacity)
         {
-            if ((*n) >> 7U)
-            {
-                size = 48U;
-                REQUIRE(48);
-                uint16_t exponent = (((uint16_t)(*n)) << 8U) +
-                                    (uint16_t)(*(n+1));
-                exponent &= 0b0011111111000000;
-                exponent >>= 6U;
-                char str[1024];
-                int is_neg = (((*n) >> 6U) & 1U == 0);
-                uint64_t mantissa =
-                    (((uint64_t)((*(n+1) & 0b111111))) << 48U) +
-                    (((uint64_t)((*(n+2)))) << 40U) +
-                    (((uint64_t)((*(n+3)))) << 32U) +
-                    (((uint64_t)((*(n+4)))) << 24U) +
-                    (((uint64_t)((*(n+5)))) << 16U) +
-                    (((uint64_t)((*(n+6)))) <<  8U) +
-                    (((uint64_t)((*(n+7)))) <<  0U);
-                int ascii = is_ascii_currency(n+8);
-                char issuer[64];
-                size_t issuer_size = 64;
-                if (!b58check_enc(issuer, &issuer_size, 0, n + 28, 20))
-                {
-                    fprintf(stderr, "Error: could not base58 encode\n");
-                    return 0;
-                }
-                issuer[0] = 'r';
-                char currency[41];
-                currency[40] = '\0';
-                uint64_t* c = (void*)(n + 8);
-                if (!c[0] && !c[1] && !*((uint32_t*)(n + 8 + 16)))
-                {
-                    currency[0] = 'X';
-                    currency[1] = 'R';
-                    currency[2] = 'P';
-                    currency[3] = '\0';
-                }
-                else if (ascii)
-                {
-                    for (int i = 0; i < 3; ++i)
-                        currency[i] = (char)(*(n + 8 + 12 + i));
-                    currency[3] = '\0';
-                }
-                else
-                {
-                    for (int i = 0; i < 20; ++i)
-                    {
-                        unsigned char hi = (*(n+8+i)) >> 4U;
-                        unsigned char lo = (*(n+8+i)) & 0xFU;
-                        hi += (hi > 9 ? 'A' - 10 : '0');
-                        lo += (lo > 9 ? 'A' - 10 : '0');
-                        currency[i*2+0] = (char)hi;
-                        currency[i*2+1] = (char)lo;
-                    }
-                }
-                int32_t exp = (int32_t)(exponent);
-                exp -= 97;
-                append(APPENDNOINDENT, SBUF("{\n"));
-//                snprintf(str, 1024, "\t\"value\": \"%s%lluE%d\",\n", (is_neg ? "-" : ""), mantissa, exp);
-                {
-                    uint8_t fixed[128];
-
-                    if (to_fixed_point(fixed, 128, mantissa, exp, is_neg) == -1)
-                        return fprintf(stderr, "Error: could not convert mantissa/exp to fixed point %lluE%d\n", mantissa, exp);
-
-                    snprintf(str, 1024, "\t\"value\": %s,\n", fixed);
-                    append(APPENDPARAMS, str, 1024);
-                }
-
-                append(APPENDPARAMS, SBUF("\t\"currency\": \""));
-                append(APPENDNOINDENT, SBUF(currency));
-                append(APPENDNOINDENT, SBUF("\",\n"));
-                append(APPENDPARAMS, SBUF("\t\"issuer\": \""));
-                append(APPENDNOINDENT, SBUF(issuer));
-                append(APPENDNOINDENT, SBUF("\"\n"));
-                append(APPENDPARAMS, SBUF("}"));
-                ADVANCE(48);
-            }
-            else
-            {
-                REQUIRE(8);
-                char str[24];
-                int negative =  ((*n) >> 6U == 0);
-                uint64_t number =
-                    ((uint64_t)((*n) & 0b111111U) << 56U) +
-                    ((uint64_t)(*(n+1)) << 48U) +
-                    ((uint64_t)(*(n+2)) << 40U) +
-                    ((uint64_t)(*(n+3)) << 32U) +
-                    ((uint64_t)(*(n+4)) << 24U) +
-                    ((uint64_t)(*(n+5)) << 16U) +
-                    ((uint64_t)(*(n+6)) <<  8U) +
-                    ((uint64_t)(*(n+7)) <<  0U);
-                int l = snprintf(str, 23, "\"%s%llu\"", (negative ? "-" : ""), number);
-                append(APPENDNOINDENT, str, l);
-                ADVANCE(8);
-            }
+            char* grown = realloc(text, capacity *= 2);
+            if (!grown)
+                free(text);
+            text = grown;
+            continue;
         }
-        else if (type_code == 1 || type_code == 2 || type_code == 3 || type_code == 16) // uint16
+        ssize_t bytes_read = read(fd, text + *len, capacity - *len);
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read < 0)
         {
-            uint64_t number = 0;
-            if (type_code == 1) // uint16
-            {
-                REQUIRE(2);
-                number =  (((uint64_t)(*(n+0))) << 8U) +
-                          (((uint64_t)(*(n+1))) << 0U);
-                ADVANCE(2);
-
-                int skip_print = 1;
-                if (field_code == 2)
-                {
-                    // transaction type
-                    if (number == 21) append(APPENDNOINDENT, SBUF("\"AccountDelete\""));
-                    else if (number == 3) append(APPENDNOINDENT, SBUF("\"AccountSet\""));
-                    else if (number == 18) append(APPENDNOINDENT, SBUF("\"CheckCancel\""));
-                    else if (number == 17) append(APPENDNOINDENT, SBUF("\"CheckCash\""));
-                    else if (number == 16) append(APPENDNOINDENT, SBUF("\"CheckCreate\""));
-                    else if (number == 9) append(APPENDNOINDENT, SBUF("\"Contract\""));
-                    else if (number == 19) append(APPENDNOINDENT, SBUF("\"DepositPreauth\""));
-                    else if (number == 100) append(APPENDNOINDENT, SBUF("\"EnableAmendment\""));
-                    else if (number == 4) append(APPENDNOINDENT, SBUF("\"EscrowCancel\""));
-                    else if (number == 1) append(APPENDNOINDENT, SBUF("\"EscrowCreate\""));
-                    else if (number == 2) append(APPENDNOINDENT, SBUF("\"EscrowFinish\""));
-                    else if (number == 6) append(APPENDNOINDENT, SBUF("\"NickNameSet\""));
-                    else if (number == 8) append(APPENDNOINDENT, SBUF("\"OfferCancel\""));
-                    else if (number == 7) append(APPENDNOINDENT, SBUF("\"OfferCreate\""));
-                    else if (number == 0) append(APPENDNOINDENT, SBUF("\"Payment\""));
-                    else if (number == 15) append(APPENDNOINDENT, SBUF("\"PaymentChannelClaim\""));
-                    else if (number == 13) append(APPENDNOINDENT, SBUF("\"PaymentChannelCreate\""));
-                    else if (number == 14) append(APPENDNOINDENT, SBUF("\"PaymentChannelFund\""));
-                    else if (number == 101) append(APPENDNOINDENT, SBUF("\"SetFee\""));
-                    else if (number == 5) append(APPENDNOINDENT, SBUF("\"SetRegularKey\""));
-                    else if (number == 12) append(APPENDNOINDENT, SBUF("\"SignerListSet\""));
-                    else if (number == 11) append(APPENDNOINDENT, SBUF("\"TicketCancel\""));
-                    else if (number == 10) append(APPENDNOINDENT, SBUF("\"TicketCreate\""));
-                    else if (number == 20) append(APPENDNOINDENT, SBUF("\"TrustSet\""));
-                    else if (number == 102) append(APPENDNOINDENT, SBUF("\"UNLModify\""));
-                    else
-                        skip_print = 0;
-
-                }
-                else if (field_code == 1)
-                {
-                    // ledger type
-                    if (number == (uint16_t)('a')) append(APPENDNOINDENT, SBUF("\"AccountRoot\""));
-                    else if (number == (uint16_t)('f')) append(APPENDNOINDENT, SBUF("\"Ammendments\""));
-                    else if (number == (uint16_t)('C')) append(APPENDNOINDENT, SBUF("\"Check\""));
-                    else if (number == (uint16_t)('p')) append(APPENDNOINDENT, SBUF("\"DepositPreauth\""));
-                    else if (number == (uint16_t)('d')) append(APPENDNOINDENT, SBUF("\"DirectoryNode\""));
-                    else if (number == (uint16_t)('u')) append(APPENDNOINDENT, SBUF("\"Escrow\""));
-                    else if (number == (uint16_t)('s')) append(APPENDNOINDENT, SBUF("\"FeeSettings\""));
-                    else if (number == (uint16_t)('h')) append(APPENDNOINDENT, SBUF("\"LedgerHashes\""));
-                    else if (number == (uint16_t)('N')) append(APPENDNOINDENT, SBUF("\"NegativeUNL\""));
-                    else if (number == (uint16_t)('o')) append(APPENDNOINDENT, SBUF("\"Offer\""));
-                    else if (number == (uint16_t)('x')) append(APPENDNOINDENT, SBUF("\"PayChan\""));
-                    else if (number == (uint16_t)('r')) append(APPENDNOINDENT, SBUF("\"RippleState\""));
-                    else if (number == (uint16_t)('S')) append(APPENDNOINDENT, SBUF("\"SignerList\""));
-                    else if (number == (uint16_t)('T')) append(APPENDNOINDENT, SBUF("\"Ticket\""));
-                    else
-                        skip_print = 0;
-                }
-                else
-                    skip_print = 0;
-
-                if (skip_print)
-                    continue;
-            }
-            else if (type_code == 2) // uint32
-            {
-                REQUIRE(4);
-                number =
-                    (((uint64_t)(*(n+0))) << 24U) +
-                    (((uint64_t)(*(n+1))) << 16U) +
-                    (((uint64_t)(*(n+2))) << 8U ) +
-                    (((uint64_t)(*(n+3))) << 0U );
-
-                ADVANCE(4);
-            }
-            else if (type_code == 3) // uint64
-            {
-                REQUIRE(8);
-                number =
-                    (((uint64_t)(*(n+0))) << 56U) +
-                    (((uint64_t)(*(n+1))) << 48U) +
-                    (((uint64_t)(*(n+2))) << 40U ) +
-                    (((uint64_t)(*(n+3))) << 32U ) +
-                    (((uint64_t)(*(n+4))) << 24U) +
-                    (((uint64_t)(*(n+5))) << 16U) +
-                    (((uint64_t)(*(n+6))) << 8U ) +
-                    (((uint64_t)(*(n+7))) << 0U );
-                ADVANCE(8);
-            }
-            else // uint8
-            {
-                REQUIRE(1);
-                number = *n;
-                ADVANCE(1);
-
-                int skip_print = 1;
-
-                if (field_code == 3)
-                {
-                    // tx result
-                    if (number == 100) append(APPENDNOINDENT, SBUF("\"tecCLAIM\""));
-                    else if (number == 146) append(APPENDNOINDENT, SBUF("\"tecCRYPTOCONDITION_ERROR\""));
-                    else if (number == 121) append(APPENDNOINDENT, SBUF("\"tecDIR_FULL\""));
-                    else if (number == 143) append(APPENDNOINDENT, SBUF("\"tecDST_TAG_NEEDED\""));
-                    else if (number == 149) append(APPENDNOINDENT, SBUF("\"tecDUPLICATE\""));
-                    else if (number == 148) append(APPENDNOINDENT, SBUF("\"tecEXPIRED\""));
-                    else if (number == 105) append(APPENDNOINDENT, SBUF("\"tecFAILED_PROCESSING\""));
-                    else if (number == 137) append(APPENDNOINDENT, SBUF("\"tecFROZEN\""));
-                    else if (number == 151) append(APPENDNOINDENT, SBUF("\"tecHAS_OBLIGATIONS\""));
-                    else if (number == 136) append(APPENDNOINDENT, SBUF("\"tecINSUFF_FEE\""));
-                    else if (number == 141) append(APPENDNOINDENT, SBUF("\"tecINSUFFICIENT_RESERVE\""));
-                    else if (number == 122) append(APPENDNOINDENT, SBUF("\"tecINSUF_RESERVE_LINE\""));
-                    else if (number == 123) append(APPENDNOINDENT, SBUF("\"tecINSUF_RESERVE_OFFER\""));
-                    else if (number == 144) append(APPENDNOINDENT, SBUF("\"tecINTERNAL\""));
-                    else if (number == 147) append(APPENDNOINDENT, SBUF("\"tecINVARIANT_FAILED\""));
-                    else if (number == 150) append(APPENDNOINDENT, SBUF("\"tecKILLED\""));
-                    else if (number == 142) append(APPENDNOINDENT, SBUF("\"tecNEED_MASTER_KEY\""));
-                    else if (number == 130) append(APPENDNOINDENT, SBUF("\"tecNO_ALTERNATIVE_KEY\""));
-                    else if (number == 134) append(APPENDNOINDENT, SBUF("\"tecNO_AUTH\""));
-                    else if (number == 124) append(APPENDNOINDENT, SBUF("\"tecNO_DST\""));
-                    else if (number == 125) append(APPENDNOINDENT, SBUF("\"tecNO_DST_INSUF_XRP\""));
-                    else if (number == 140) append(APPENDNOINDENT, SBUF("\"tecNO_ENTRY\""));
-                    else if (number == 133) append(APPENDNOINDENT, SBUF("\"tecNO_ISSUER\""));
-                    else if (number == 135) append(APPENDNOINDENT, SBUF("\"tecNO_LINE\""));
-                    else if (number == 126) append(APPENDNOINDENT, SBUF("\"tecNO_LINE_INSUF_RESERVE\""));
-                    else if (number == 127) append(APPENDNOINDENT, SBUF("\"tecNO_LINE_REDUNDANT\""));
-                    else if (number == 139) append(APPENDNOINDENT, SBUF("\"tecNO_PERMISSION\""));
-                    else if (number == 131) append(APPENDNOINDENT, SBUF("\"tecNO_REGULAR_KEY\""));
-                    else if (number == 138) append(APPENDNOINDENT, SBUF("\"tecNO_TARGET\""));
-                    else if (number == 145) append(APPENDNOINDENT, SBUF("\"tecOVERSIZE\""));
-                    else if (number == 132) append(APPENDNOINDENT, SBUF("\"tecOWNERS\""));
-                    else if (number == 128) append(APPENDNOINDENT, SBUF("\"tecPATH_DRY\""));
-                    else if (number == 101) append(APPENDNOINDENT, SBUF("\"tecPATH_PARTIAL\""));
-                    else if (number == 152) append(APPENDNOINDENT, SBUF("\"tecTOO_SOON\""));
-                    else if (number == 129) append(APPENDNOINDENT, SBUF("\"tecUNFUNDED\""));
-                    else if (number == 102) append(APPENDNOINDENT, SBUF("\"tecUNFUNDED_ADD\""));
-                    else if (number == 103) append(APPENDNOINDENT, SBUF("\"tecUNFUNDED_OFFER\""));
-                    else if (number == 104) append(APPENDNOINDENT, SBUF("\"tecUNFUNDED_PAYMENT\""));
-                    else if (number == 0) append(APPENDNOINDENT, SBUF("\"tesSUCCESS\""));
-                    else
-                        skip_print = 0;
-                }
-                else
-                    skip_print = 0;
-
-                if (skip_print)
-                    continue;
-            }
-            char str[16];
-            int l = snprintf(str, 16, "%lu", number);
-            append(APPENDNOINDENT, str, l);
+            free(text);
+            return 0;
         }
+        if (bytes_read == 0)
+            break;
+        *len += bytes_read;
     }
+    return text;
+}
 
+// --encode, JSON in and the serialized object out as hex, or as raw bytes with --binary
+int encode_main(const char* input_arg, int batch_mode, int binary, int threads)
+{
+    if (batch_mode)
+    {
+        int fd = (strcmp(input_arg, "-") == 0 ? 0 : open(input_arg, O_RDONLY));
+        if (fd < 0)
+            return fprintf(stderr, "Could not open file `%s`\n", input_arg);
+        if (!pipeline_run(fd, 1, threads, sizeof(struct encode_worker), encode_process, encode_finish))
+            return fprintf(stderr, "Batch failed on a read, write or allocation error\n");
+        return 0;
+    }
 
+    // JSON given as the argument itself, otherwise a file or stdin
+    const char* json = input_arg;
+    size_t len = strlen(input_arg);
+    if (input_arg[strspn(input_arg, " \t\r\n")] != '{')
+    {
+        int fd = (strcmp(input_arg, "-") == 0 ? 0 : open(input_arg, O_RDONLY));
+        if (fd < 0)
+            return fprintf(stderr, "Could not open file `%s`\n", input_arg);
+        if (!(json = read_all(fd, &len)))
+            return fprintf(stderr, "Could not read `%s`\n", input_arg);
+    }
 
-    indent_level--;
-    append(APPENDNOINDENT, SBUF("\n"));
-    append(APPENDPARAMS, SBUF("}\n"));
+    static struct encoder encoder;
+    if (!encode_init(&encoder, definitions))
+        return fprintf(stderr, "Could not allocate the encoder\n");
+    if (encode_json(&encoder, json, len) != XD_OK)
+        return fprintf(stderr, "%s\nCould not serialize\n", encoder.error_message);
 
-    return 1;
+    if (binary)
+        fwrite(encoder.output, 1, encoder.output_len, stdout);
+    else
+    {
+        char* hex = malloc(encoder.output_len * 2 + 1);
+        if (!hex)
+            return fprintf(stderr, "Could not allocate output buffer\n");
+        fwrite(hex, 1, hex_line(hex, encoder.output, encoder.output_len), stdout);
+    }
+    return 0;
 }
 
-
-int stream_refill(uint8_t* input, int input_len, int min_bytes_to_return, int read_fd)
+int main(int argc, char** argv)
 {
-    int upto = 0;
-    char byte[2];
-    int bytes_read = 0;
-    do
-    {
-//        printf("\n  A:\n");
-        bytes_read = read(read_fd, &(byte[0]), 1);
-        if (bytes_read > 0)
-        {
-            if (byte[0] == ' ' || byte[0] == '\n' || byte[0] == '\r' || byte[0] == '\t')
-                continue;
-        }
-        else
-            break;
+    b58_sha256_impl = calc_sha_256;
 
-        half_continue:
-//        printf("\n  B:\n");
-        bytes_read = read(read_fd, &(byte[1]), 1);
-        if (bytes_read > 0)
+    static struct definitions loaded_definitions;
+    definitions_builtin(&loaded_definitions);
+    definitions = &loaded_definitions;
+
+    char* input_arg = 0;
+    char* definitions_path = 0;
+    char* save_definitions_path = 0;
+    char* fields = 0;
+    char* filter_expression = 0;
+    char* columns = 0;
+    int arrow = 0;
+    int arrow_rows = ARROW_BATCH_ROWS;
+    int header = 1;
+    int encode = 0;
+    int batch_mode = 0;
+    int binary = 0;
+    int compact = 0;
+    int threads = 1;
+    int print_help = 0;
+    for (int i = 1; i < argc && !print_help; ++i)
+    {
+        if (strcmp(argv[i], "--definitions") == 0 && i + 1 < argc)
+            definitions_path = argv[++i];
+        else if (strcmp(argv[i], "--save-definitions") == 0 && i + 1 < argc)
+            save_definitions_path = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0)
+            batch_mode = 1;
+        else if (strcmp(argv[i], "--binary") == 0)
+            binary = 1;
+        else if (strcmp(argv[i], "--compact") == 0)
+            compact = 1;
+        else if (strcmp(argv[i], "--hash") == 0)
+            hash_ids = 1;
+        else if (strcmp(argv[i], "--fields") == 0 && i + 1 < argc)
+            fields = argv[++i];
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter_expression = argv[++i];
+        else if (strcmp(argv[i], "--arrow") == 0)
+            arrow = 1;
+        else if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc)
+            columns = argv[++i];
+        else if (strcmp(argv[i], "--arrow-rows") == 0 && i + 1 < argc)
+            arrow_rows = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0)
+            csv_separator = ',';
+        else if (strcmp(argv[i], "--tsv") == 0)
+            csv_separator = '\t';
+        else if (strcmp(argv[i], "--explode") == 0 && i + 1 < argc)
+            csv_explode = argv[++i];
+        else if (strcmp(argv[i], "--no-header") == 0)
+            header = 0;
+        else if (strcmp(argv[i], "--encode") == 0)
+            encode = 1;
+        else if (strcmp(argv[i], "--cbor") == 0)
+            cbor_flags |= XD_CBOR;
+        else if (strcmp(argv[i], "--raw-bytes") == 0)
+            cbor_flags |= XD_RAW_BYTES;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
         {
-            if (byte[1] == ' ' || byte[1] == '\n' || byte[1] == '\r' || byte[1] == '\t')
-                goto half_continue;
+            threads = atoi(argv[++i]);
+            if (threads < 1)
+                threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
         }
+        else if (strcmp(argv[i], "--stats") == 0)
+            atexit(print_stats);
+        else if (!input_arg && strncmp(argv[i], "--", 2) != 0)
+            input_arg = argv[i];
         else
-            break;
+            print_help = 1;
+    }
 
-        // execution to here means two bytes
+    if (print_help || (!input_arg && !save_definitions_path) || (batch_mode && binary) ||
+            (filter_expression && !batch_mode) ||
+            (columns && !arrow && !csv_separator) || (arrow && csv_separator) || (csv_explode && !csv_separator) ||
+            (cbor_flags && (arrow || csv_separator)) || cbor_flags == XD_RAW_BYTES ||
+            (encode && (arrow || csv_separator || cbor_flags || fields || filter_expression || hash_ids)))
+        return fprintf(stderr,
+                "Usage: %s [--definitions definitions.json | cache] [--save-definitions cache] [--stats] [--compact] [--hash] "
+                "[--fields Name,Name.Name,...] "
+                "[--arrow [--columns Name,Name.value,...] [--arrow-rows N]] "
+                "[--csv | --tsv [--columns Name,Name.Name,Name.currency,...] [--explode ArrayName] [--no-header]] "
+                "[--cbor [--raw-bytes]] "
+                "HEXBLOB | hex file | - for stdin\n"
+                "       %s --binary [options] binary file | - for stdin\n"
+                "       %s --batch [--threads N (0 for one per core)] [--filter 'Name==value && ...'] [options] hex lines file | - for stdin\n"
+                "       %s --encode [--binary | --batch [--threads N]] JSON | JSON file | - for stdin\n", argv[0], argv[0], argv[0], argv[0]);
+
+    if (definitions_path)
+    {
+        // a cache written by --save-definitions is mmapped, anything else is parsed as definitions.json
+        definitions = definitions_map(definitions_path);
+        if (!definitions && !definitions_load_json(&loaded_definitions, definitions_path))
+            return fprintf(stderr, "Could not load definitions from `%s`\n", definitions_path);
+        if (!definitions)
+            definitions = &loaded_definitions;
+    }
 
-        uint8_t hi = byte[0];
-        uint8_t lo = byte[1];
+    if (save_definitions_path && !definitions_save(definitions, save_definitions_path))
+        return fprintf(stderr, "Could not save definitions to `%s`\n", save_definitions_path);
 
-        int error = 0;
-        hi =    (hi >= 'A' && hi <= 'F' ? hi - 'A' + 10 :
-                (hi >= 'a' && hi <= 'f' ? hi - 'a' + 10 :
-                (hi >= '0' && hi <= '9' ? hi - '0' :
-                 (error=1) )));
+    if (!input_arg)
+        return 0;
 
-        lo =    (lo >= 'A' && lo <= 'F' ? lo - 'A' + 10 :
-                (lo >= 'a' && lo <= 'f' ? lo - 'a' + 10 :
-                (lo >= '0' && lo <= '9' ? lo - '0' :
-                 (error=1) )));
+    if (encode)
+        return encode_main(input_arg, batch_mode, binary, threads);
 
+    static struct xd_projection compiled_fields;
+    if (fields)
+    {
+        int error = xd_projection_compile(&compiled_fields, definitions, fields);
+        if (error != XD_OK)
+            return fprintf(stderr, "Invalid --fields `%s`: %s\n", fields, xd_strerror(error));
+        projection = &compiled_fields;
+    }
 
-        if (error)
-        {
-            fprintf(stderr, "Error: Garbage (non hex and non whitespace characters) in input stream\n");
-            exit(1);
-        }
+    static struct filter compiled_filter;
+    if (filter_expression)
+    {
+        if (!filter_compile(&compiled_filter, definitions, filter_expression))
+            return fprintf(stderr, "Invalid --filter `%s`: %s\n", filter_expression, compiled_filter.error);
+        record_filter = &compiled_filter;
+    }
 
-        input[upto++] = (hi << 4U) + lo;
+    static struct arrow_writer arrow_writer;
+    if (arrow)
+    {
+        if (!columns)
+            columns = (hash_ids ? "hash," ARROW_DEFAULT_COLUMNS : ARROW_DEFAULT_COLUMNS);
+        if (!arrow_open(&arrow_writer, definitions, columns, 1, arrow_rows))
+            return fprintf(stderr, "Invalid --columns `%s`: %s\n", columns, arrow_writer.error);
+        arrow_output = &arrow_writer;
     }
-    while (upto < min_bytes_to_return);
 
-    //printf("upto: %d bytes read: %d\n", upto, bytes_read);
-    if (bytes_read<= 0 && upto == 0)
-        return -1;
+    static struct csv_writer csv_writer;
+    if (csv_separator)
+    {
+        if (!columns)
+            columns = (hash_ids ? "hash," CSV_DEFAULT_COLUMNS : CSV_DEFAULT_COLUMNS);
+        if (!csv_open(&csv_writer, definitions, columns, csv_explode, csv_separator))
+            return fprintf(stderr, "Invalid --columns or --explode: %s\n", csv_writer.error);
+        if (header && !csv_header(&csv_writer))
+            return fprintf(stderr, "Could not allocate the CSV header\n");
+        if (header)
+            fwrite(csv_writer.output, 1, csv_writer.output_len, stdout);
+        // the batch pipeline writes to fd 1 directly
+        fflush(stdout);
+        csv_columns = columns;
+        csv_output = &csv_writer;
+    }
 
-    return upto;
-}
+    if (batch_mode)
+    {
+        int fd = (strcmp(input_arg, "-") == 0 ? 0 : open(input_arg, O_RDONLY));
+        if (fd < 0)
+            return fprintf(stderr, "Could not open file `%s`\n", input_arg);
+        // rows go into the one writer in input order, so Arrow output is decoded on a single thread
+        if (!pipeline_run(fd, 1, (arrow ? 1 : threads), sizeof(struct batch_worker), batch_process, batch_finish))
+            return fprintf(stderr, "Batch failed on a read, write or allocation error\n");
+        if (arrow && !arrow_close(&arrow_writer))
+            return fprintf(stderr, "Arrow output failed: %s\n", arrow_writer.error);
+        return 0;
+    }
 
-int main(int argc, char** argv)
-{
-    b58_sha256_impl = calc_sha_256;
+    static struct xd_ctx ctx;
+    xd_init(&ctx, definitions, (compact ? XD_COMPACT : 0) | (hash_ids ? XD_TXID : 0) | cbor_flags);
+    xd_set_projection(&ctx, projection);
+    main_context = &ctx;
+    atexit(free_context);
 
-    int print_help =
-        (argc != 2) ||
-        (argc == 2 && (strcmp(argv[1], "--help") == 0));
+    if (binary && strcmp(input_arg, "-") == 0)
+    {
+        int fd = 0;
+        return decode_one(&ctx, 0, 0, binary_refill, &fd);
+    }
 
-    if (print_help)
-        return fprintf(stderr, "Usage: %s HEXBLOB | hex file | - for stdin\n", argv[0]);
+    if (binary)
+    {
+        // the mapped file is the decoder's input buffer as it is, nothing is copied
+        int fd = open(input_arg, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+            return fprintf(stderr, "Could not open file `%s`\n", input_arg);
+        if (st.st_size == 0)
+            return fprintf(stderr, "File `%s` is empty\n", input_arg);
+
+        uint8_t* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            return fprintf(stderr, "Could not mmap file `%s`\n", input_arg);
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+        return decode_one(&ctx, map, st.st_size, 0, 0);
+    }
 
-    if (strcmp(argv[1], "-") == 0)
+    static struct stream_reader reader = { .carry = -1 };
+    if (strcmp(input_arg, "-") == 0)
     {
         // stream mode
-        return deserialize(0, 0, 0, stream_refill, 0, 1);
+        return decode_one(&ctx, 0, 0, stream_refill, &reader);
     }
     struct stat dummy;
-    if (lstat(argv[1], &dummy) != -1)
+    if (lstat(input_arg, &dummy) != -1)
     {
         // stream mode but from file
-        int fd = open(argv[1], O_RDONLY);
-        if (fd < 0)
-            return fprintf(stderr, "Could not open file `%s`\n", argv[1]);
-        return deserialize(0, 0, 0, stream_refill, fd, 1);
+        reader.read_fd = open(input_arg, O_RDONLY);
+        if (reader.read_fd < 0)
+            return fprintf(stderr, "Could not open file `%s`\n", input_arg);
+        return decode_one(&ctx, 0, 0, stream_refill, &reader);
     }
 
 
     // hex conversion
-    int hexlen = strlen(argv[1]);
+    int hexlen = strlen(input_arg);
     if (hexlen % 2 == 1)
         return fprintf(stderr, "Hex length must be even\n");
 
-    int len = hexlen/2 + 1;
+    int len = hexlen/2;
     uint8_t* rawbytes = malloc(len);
     uint8_t* rawupto = rawbytes;
     int error = 0;
-    for (char* x = argv[1]; *x;  x+=2)
+    for (char* x = input_arg; *x;  x+=2)
     {
         uint8_t hi = *x;
         uint8_t lo = *(x+1);
@@ -1245,16 +744,19 @@ int main(int argc, char** argv)
 
         *rawupto++ = (hi << 4U) + lo;
     }
-    *rawupto++ = 0; // hacky :(
 
     if (error)
         return fprintf(stderr, "Non-hex nibble detected\n");
 
-    uint8_t* output = 0;
-    if (!deserialize(&output, rawbytes, len, 0, 0, 0))
-        return fprintf(stderr, "Could not deserialize\n");
+    if (arrow_output || csv_output)
+        return decode_one(&ctx, rawbytes, len, 0, 0);
+
+    if (xd_decode(&ctx, rawbytes, len) != XD_OK)
+        return decode_result(&ctx, ctx.error);
 
-    printf("%s\n", output);
+    fwrite(ctx.output, 1, ctx.output_len, stdout);
+    if (!compact && !cbor_flags)
+        putchar('\n');
 
     return 0;
 }
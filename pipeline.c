@@ -0,0 +1,505 @@
+/**
+ * Order preserving parallel line processing
+ * Reader (calling thread) -> per decoder queues (with stealing) -> decoder threads -> done queue -> writer thread
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "pipeline.h"
+
+#define PIPELINE_JOBS_PER_THREAD 4
+
+/**
+ * Bounded MPMC queue (Vyukov). Each cell's sequence says whose turn it is: pos for the producer at pos,
+ * pos + 1 for the consumer at pos. Producers and consumers only contend on their own position counter.
+ */
+struct pipeline_cell
+{
+    uint64_t sequence;
+    struct pipeline_job* job;
+};
+
+struct pipeline_queue
+{
+    struct pipeline_cell* cells;
+    uint64_t mask;
+    uint64_t enqueue_pos __attribute__((aligned(64)));
+    uint64_t dequeue_pos __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+static int queue_init(struct pipeline_queue* q, uint64_t size)
+{
+    q->cells = malloc(size * sizeof(*q->cells));
+    if (!q->cells)
+        return 0;
+    for (uint64_t i = 0; i < size; ++i)
+        q->cells[i].sequence = i;
+    q->mask = size - 1;
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    return 1;
+}
+
+// returns 0 if the queue is full
+static int queue_push(struct pipeline_queue* q, struct pipeline_job* job)
+{
+    struct pipeline_cell* cell;
+    uint64_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    while (1)
+    {
+        cell = &q->cells[pos & q->mask];
+        int64_t diff = (int64_t)__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (int64_t)pos;
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return 0;
+        else
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    }
+    cell->job = job;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// returns 0 if the queue is empty
+static struct pipeline_job* queue_pop(struct pipeline_queue* q)
+{
+    struct pipeline_cell* cell;
+    uint64_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    while (1)
+    {
+        cell = &q->cells[pos & q->mask];
+        int64_t diff = (int64_t)__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (int64_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return 0;
+        else
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    }
+    struct pipeline_job* job = cell->job;
+    __atomic_store_n(&cell->sequence, pos + q->mask + 1, __ATOMIC_RELEASE);
+    return job;
+}
+
+// nothing to do, yield for a while then start sleeping so idle stages don't burn a core
+static void pipeline_backoff(int* spins)
+{
+    if (++*spins < 64)
+        sched_yield();
+    else
+    {
+        struct timespec ts = { 0, 50000 };
+        nanosleep(&ts, 0);
+    }
+}
+
+struct pipeline
+{
+    int threads;
+    uint64_t jobs;
+    int write_fd;
+    size_t worker_size;
+    void (*process)(void* worker, struct pipeline_job* job);
+    void (*finish)(void* worker);
+
+    struct pipeline_queue free_jobs;
+    struct pipeline_queue* work;    // one per decoder
+    struct pipeline_queue done;
+
+    uint64_t total;                 // jobs produced, valid once reading_done is set
+    int reading_done;
+    int failed;
+};
+
+struct pipeline_worker
+{
+    struct pipeline* p;
+    int id;
+    void* state;
+    pthread_t thread;
+};
+
+int pipeline_out(struct pipeline_job* job, const void* data, size_t len)
+{
+    if (job->out_capacity - job->out_len < len)
+    {
+        size_t capacity = (job->out_capacity ? job->out_capacity : PIPELINE_CHUNK_SIZE);
+        while (capacity - job->out_len < len)
+            capacity *= 2;
+        char* out = realloc(job->out, capacity);
+        if (!out)
+            return 0;
+        job->out = out;
+        job->out_capacity = capacity;
+    }
+    memcpy(job->out + job->out_len, data, len);
+    job->out_len += len;
+    return 1;
+}
+
+static int write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+            return 0;
+        data += written;
+        len -= written;
+    }
+    return 1;
+}
+
+static void* pipeline_decoder(void* arg)
+{
+    struct pipeline_worker* w = arg;
+    struct pipeline* p = w->p;
+    void* state = w->state;
+
+    int spins = 0;
+    while (1)
+    {
+        // own queue first, then steal from the others
+        struct pipeline_job* job = queue_pop(&p->work[w->id]);
+        for (int i = 1; !job && i < p->threads; ++i)
+            job = queue_pop(&p->work[(w->id + i) % p->threads]);
+
+        if (job)
+        {
+            p->process(state, job);
+            // the done queue holds every job so this can't fail
+            queue_push(&p->done, job);
+            spins = 0;
+            continue;
+        }
+
+        // everything is queued before reading_done is set, so one more empty pass after seeing it means finished
+        if (__atomic_load_n(&p->reading_done, __ATOMIC_ACQUIRE))
+        {
+            for (int i = 0; !job && i < p->threads; ++i)
+                job = queue_pop(&p->work[i]);
+            if (!job)
+                break;
+            p->process(state, job);
+            queue_push(&p->done, job);
+            continue;
+        }
+
+        pipeline_backoff(&spins);
+    }
+
+    if (p->finish)
+        p->finish(state);
+    return 0;
+}
+
+static void* pipeline_writer(void* arg)
+{
+    struct pipeline* p = arg;
+
+    // at most p->jobs are in flight, so each slot is only ever wanted by one of them
+    struct pipeline_job** pending = calloc(p->jobs, sizeof(*pending));
+    if (!pending)
+        __atomic_store_n(&p->failed, 1, __ATOMIC_RELEASE);
+
+    uint64_t next = 0;
+    int spins = 0;
+    while (1)
+    {
+        if (__atomic_load_n(&p->reading_done, __ATOMIC_ACQUIRE) && next == p->total)
+            break;
+
+        struct pipeline_job* job = queue_pop(&p->done);
+        if (!job)
+        {
+            pipeline_backoff(&spins);
+            continue;
+        }
+        spins = 0;
+
+        if (!pending)
+        {
+            // nowhere to reorder, keep the jobs moving so the other stages can finish
+            next++;
+            queue_push(&p->free_jobs, job);
+            continue;
+        }
+
+        pending[job->seq % p->jobs] = job;
+        while ((job = pending[next % p->jobs]) && job->seq == next)
+        {
+            if (!__atomic_load_n(&p->failed, __ATOMIC_ACQUIRE) && !write_all(p->write_fd, job->out, job->out_len))
+                __atomic_store_n(&p->failed, 1, __ATOMIC_RELEASE);
+            pending[next % p->jobs] = 0;
+            job->out_len = 0;
+            queue_push(&p->free_jobs, job);
+            next++;
+        }
+    }
+
+    free(pending);
+    return 0;
+}
+
+/**
+ * Fill `job` with whole lines, starting with the partial line left over from the last job. It is handed on when the
+ * buffer is full or a read comes up short at the end of a line, whichever is first.
+ * Returns 0 at the end of input (job->text_len is then 0), -1 on a read or allocation failure.
+ */
+static int pipeline_fill(struct pipeline_job* job, int read_fd, char** carry, size_t* carry_len, int* eof)
+{
+    if (job->text_capacity < *carry_len + PIPELINE_CHUNK_SIZE)
+    {
+        size_t capacity = *carry_len + PIPELINE_CHUNK_SIZE;
+        char* text = realloc(job->text, capacity);
+        if (!text)
+            return -1;
+        job->text = text;
+        job->text_capacity = capacity;
+    }
+
+    if (*carry_len > 0)
+        memcpy(job->text, *carry, *carry_len);
+    job->text_len = *carry_len;
+    *carry_len = 0;
+
+    size_t scanned = 0;
+    while (!*eof)
+    {
+        if (job->text_len == job->text_capacity)
+        {
+            // a single line longer than the buffer
+            char* text = realloc(job->text, job->text_capacity * 2);
+            if (!text)
+                return -1;
+            job->text = text;
+            job->text_capacity *= 2;
+        }
+
+        size_t wanted = job->text_capacity - job->text_len;
+        ssize_t bytes_read = read(read_fd, job->text + job->text_len, wanted);
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read < 0)
+            return -1;
+        if (bytes_read == 0)
+        {
+            *eof = 1;
+            break;
+        }
+        job->text_len += bytes_read;
+
+        // a short read that ends on a newline means nothing more is waiting (a pipe or a terminal), the lines go now
+        // so line at a time input gets line at a time output
+        if ((size_t)bytes_read < wanted && job->text[job->text_len - 1] == '\n')
+            break;
+
+        // otherwise stop once the buffer is full and holds at least one complete line
+        if (job->text_len < job->text_capacity)
+            continue;
+        char* last = memrchr(job->text + scanned, '\n', job->text_len - scanned);
+        scanned = job->text_len;
+        if (!last)
+            continue;
+
+        size_t tail = job->text + job->text_len - (last + 1);
+        if (tail > 0)
+        {
+            char* c = realloc(*carry, tail);
+            if (!c)
+                return -1;
+            *carry = c;
+            memcpy(*carry, last + 1, tail);
+        }
+        *carry_len = tail;
+        job->text_len -= tail;
+        break;
+    }
+
+    return (job->text_len > 0 ? 1 : 0);
+}
+
+static long count_lines(const char* text, size_t len)
+{
+    long lines = 0;
+    for (const char* end = text + len; (text = memchr(text, '\n', end - text)); ++text)
+        lines++;
+    return lines;
+}
+
+static void pipeline_free_job(struct pipeline_job* job)
+{
+    free(job->text);
+    free(job->out);
+}
+
+// the jobs, queues and worker states of a run, any of which may be missing after a failed allocation
+static void pipeline_free(struct pipeline* p, struct pipeline_job* jobs, struct pipeline_worker* workers)
+{
+    for (uint64_t i = 0; jobs && i < p->jobs; ++i)
+        pipeline_free_job(&jobs[i]);
+    for (int i = 0; p->work && i < p->threads; ++i)
+        free(p->work[i].cells);
+    free(p->free_jobs.cells);
+    free(p->done.cells);
+    for (int i = 0; workers && i < p->threads; ++i)
+        free(workers[i].state);
+    free(p->work);
+    free(workers);
+    free(jobs);
+}
+
+// everything on the calling thread, one job reused for the whole input
+static int pipeline_run_inline(int read_fd, int write_fd, size_t worker_size,
+        void (*process)(void* worker, struct pipeline_job* job), void (*finish)(void* worker))
+{
+    struct pipeline_job job = { 0 };
+    char* carry = 0;
+    size_t carry_len = 0;
+    int eof = 0;
+    int ok = 1;
+
+    void* state = calloc(1, worker_size);
+    if (!state)
+        return 0;
+
+    long line = 1;
+    int filled;
+    while ((filled = pipeline_fill(&job, read_fd, &carry, &carry_len, &eof)) > 0)
+    {
+        job.first_line = line;
+        line += count_lines(job.text, job.text_len);
+        process(state, &job);
+        if (!write_all(write_fd, job.out, job.out_len))
+        {
+            ok = 0;
+            break;
+        }
+        job.out_len = 0;
+        job.seq++;
+    }
+
+    if (filled < 0)
+        ok = 0;
+    if (finish)
+        finish(state);
+    free(state);
+    free(carry);
+    pipeline_free_job(&job);
+    return ok;
+}
+
+int pipeline_run(
+        int read_fd,
+        int write_fd,
+        int threads,
+        size_t worker_size,
+        void (*process)(void* worker, struct pipeline_job* job),
+        void (*finish)(void* worker))
+{
+    if (threads <= 1)
+        return pipeline_run_inline(read_fd, write_fd, worker_size, process, finish);
+
+    struct pipeline p = {
+        .threads = threads,
+        .write_fd = write_fd,
+        .worker_size = worker_size,
+        .process = process,
+        .finish = finish
+    };
+
+    // queues are sized to hold every job, so only the free list can ever make a stage wait
+    p.jobs = 1;
+    while (p.jobs < (uint64_t)threads * PIPELINE_JOBS_PER_THREAD)
+        p.jobs <<= 1U;
+
+    struct pipeline_job* jobs = calloc(p.jobs, sizeof(*jobs));
+    struct pipeline_worker* workers = calloc(threads, sizeof(*workers));
+    if ((p.work = aligned_alloc(64, threads * sizeof(*p.work))))
+        memset(p.work, 0, threads * sizeof(*p.work));
+    int ok = (jobs && workers && p.work && queue_init(&p.free_jobs, p.jobs) && queue_init(&p.done, p.jobs));
+    for (int i = 0; ok && i < threads; ++i)
+        ok = (queue_init(&p.work[i], p.jobs) && (workers[i].state = calloc(1, worker_size)));
+
+    // nothing is running yet, so a failure up to here only has to free what was allocated
+    pthread_t writer;
+    if (!ok || pthread_create(&writer, 0, pipeline_writer, &p) != 0)
+    {
+        pipeline_free(&p, jobs, workers);
+        return 0;
+    }
+    for (uint64_t i = 0; i < p.jobs; ++i)
+        queue_push(&p.free_jobs, &jobs[i]);
+    int started = 0;
+    for (; started < threads; ++started)
+    {
+        workers[started].p = &p;
+        workers[started].id = started;
+        if (pthread_create(&workers[started].thread, 0, pipeline_decoder, &workers[started]) != 0)
+            break;
+    }
+    if (started < threads)
+        __atomic_store_n(&p.failed, 1, __ATOMIC_RELEASE);
+
+    // reader stage
+    char* carry = 0;
+    size_t carry_len = 0;
+    int eof = 0;
+    long line = 1;
+    uint64_t seq = 0;
+    int spins = 0;
+    while (!__atomic_load_n(&p.failed, __ATOMIC_ACQUIRE))
+    {
+        struct pipeline_job* job = queue_pop(&p.free_jobs);
+        if (!job)
+        {
+            pipeline_backoff(&spins);
+            continue;
+        }
+        spins = 0;
+
+        int filled = pipeline_fill(job, read_fd, &carry, &carry_len, &eof);
+        if (filled <= 0)
+        {
+            if (filled < 0)
+                __atomic_store_n(&p.failed, 1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        job->seq = seq;
+        job->first_line = line;
+        line += count_lines(job->text, job->text_len);
+
+        // round robin, the decoder queues hold every job so the first choice always has room
+        queue_push(&p.work[seq % started], job);
+        seq++;
+    }
+
+    p.total = seq;
+    __atomic_store_n(&p.reading_done, 1, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < started; ++i)
+        pthread_join(workers[i].thread, 0);
+    pthread_join(writer, 0);
+
+    pipeline_free(&p, jobs, workers);
+    free(carry);
+
+    return !p.failed;
+}
@@ -0,0 +1,44 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Order preserving parallel line processing
+ * A reader stage cuts the input into jobs of whole lines, a pool of decoder threads processes them and a writer
+ * stage puts the results back into input order. The stages are connected by lock-free bounded queues, every
+ * decoder has its own queue and steals from the others' when it runs dry.
+ * Jobs and their buffers are recycled, the number in flight is fixed for the whole run.
+ */
+#define PIPELINE_CHUNK_SIZE (256*1024)
+
+struct pipeline_job
+{
+    uint64_t seq;           // position of the job in the input
+    long first_line;        // line number of the first line in text, counting from 1
+    char* text;             // whole lines (the last may lack its newline at the end of input)
+    size_t text_len;
+    size_t text_capacity;
+    char* out;              // filled by the process callback, written out in input order
+    size_t out_len;
+    size_t out_capacity;
+};
+
+// append to a job's output, returns 0 if the buffer could not grow
+int pipeline_out(struct pipeline_job* job, const void* data, size_t len);
+
+/**
+ * Process `read_fd` to `write_fd` with `threads` decoder threads (0 or 1 runs everything on the calling thread).
+ * `process` is called with the worker's own `worker_size` bytes of zeroed scratch state, which `finish` may
+ * release when that worker is done. Returns 1 on success, 0 on a read, write or allocation failure.
+ */
+int pipeline_run(
+        int read_fd,
+        int write_fd,
+        int threads,
+        size_t worker_size,
+        void (*process)(void* worker, struct pipeline_job* job),
+        void (*finish)(void* worker));
+
+#endif
@@ -31,6 +31,14 @@ static const uint32_t k[] = {
 	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
 };
 
+/*
+ * Initial hash values:
+ * (first 32 bits of the fractional parts of the square roots of the first 8 primes 2..19):
+ */
+static const uint32_t sha256_initial[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
 static inline uint32_t right_rot(uint32_t value, unsigned int count)
 {
 	/*
@@ -40,6 +48,225 @@ static inline uint32_t right_rot(uint32_t value, unsigned int count)
 	return value >> count | value << (32 - count);
 }
 
+static void sha256_blocks_scalar(uint32_t h[8], const uint8_t *p, size_t blocks)
+{
+	unsigned i, j;
+
+	while (blocks--) {
+		uint32_t ah[8];
+
+		/* Initialize working variables to current hash value: */
+		for (i = 0; i < 8; i++)
+			ah[i] = h[i];
+
+		/* Compression function main loop: */
+		for (i = 0; i < 4; i++) {
+			/*
+			 * The w-array is really w[64], but since we only need
+			 * 16 of them at a time, we save stack by calculating
+			 * 16 at a time.
+			 *
+			 * This optimization was not there initially and the
+			 * rest of the comments about w[64] are kept in their
+			 * initial state.
+			 */
+
+			/*
+			 * create a 64-entry message schedule array w[0..63] of 32-bit words
+			 * (The initial values in w[0..63] don't matter, so many implementations zero them here)
+			 * copy chunk into first 16 words w[0..15] of the message schedule array
+			 */
+			uint32_t w[16];
+
+			for (j = 0; j < 16; j++) {
+				if (i == 0) {
+					w[j] = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+						(uint32_t) p[2] << 8 | (uint32_t) p[3];
+					p += 4;
+				} else {
+					/* Extend the first 16 words into the remaining 48 words w[16..63] of the message schedule array: */
+					const uint32_t s0 = right_rot(w[(j + 1) & 0xf], 7) ^ right_rot(w[(j + 1) & 0xf], 18) ^ (w[(j + 1) & 0xf] >> 3);
+					const uint32_t s1 = right_rot(w[(j + 14) & 0xf], 17) ^ right_rot(w[(j + 14) & 0xf], 19) ^ (w[(j + 14) & 0xf] >> 10);
+					w[j] = w[j] + s0 + w[(j + 9) & 0xf] + s1;
+				}
+				const uint32_t s1 = right_rot(ah[4], 6) ^ right_rot(ah[4], 11) ^ right_rot(ah[4], 25);
+				const uint32_t ch = (ah[4] & ah[5]) ^ (~ah[4] & ah[6]);
+				const uint32_t temp1 = ah[7] + s1 + ch + k[i << 4 | j] + w[j];
+				const uint32_t s0 = right_rot(ah[0], 2) ^ right_rot(ah[0], 13) ^ right_rot(ah[0], 22);
+				const uint32_t maj = (ah[0] & ah[1]) ^ (ah[0] & ah[2]) ^ (ah[1] & ah[2]);
+				const uint32_t temp2 = s0 + maj;
+
+				ah[7] = ah[6];
+				ah[6] = ah[5];
+				ah[5] = ah[4];
+				ah[4] = ah[3] + temp1;
+				ah[3] = ah[2];
+				ah[2] = ah[1];
+				ah[1] = ah[0];
+				ah[0] = temp1 + temp2;
+			}
+		}
+
+		/* Add the compressed chunk to the current hash value: */
+		for (i = 0; i < 8; i++)
+			h[i] += ah[i];
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHA256_X86 1
+
+/*
+ * SHA-NI compression, message schedule via sha256msg1/sha256msg2.
+ * State is kept in the ABEF / CDGH lane order the sha256rnds2 instruction expects.
+ */
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(uint32_t h[8], const uint8_t *p, size_t blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &h[0]), 0xB1); /* CDAB */
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &h[4]), 0x1B); /* EFGH */
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8); /* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0); /* CDGH */
+
+	while (blocks--) {
+		__m128i abef = state0, cdgh = state1;
+		__m128i msg[4];
+		unsigned r;
+
+		for (r = 0; r < 4; r++)
+			msg[r] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + r * 16)), mask);
+
+		/* 16 groups of 4 rounds, the schedule for group r + 4 replaces the words of group r */
+		for (r = 0; r < 16; r++) {
+			__m128i wk = _mm_add_epi32(msg[r & 3], _mm_loadu_si128((const __m128i *) &k[r * 4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+
+			if (r < 12) {
+				__m128i t = _mm_sha256msg1_epu32(msg[r & 3], msg[(r + 1) & 3]);
+				t = _mm_add_epi32(t, _mm_alignr_epi8(msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+				msg[r & 3] = _mm_sha256msg2_epu32(t, msg[(r + 3) & 3]);
+			}
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+		p += CHUNK_SIZE;
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B); /* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1); /* DCHG */
+	_mm_storeu_si128((__m128i *) &h[0], _mm_blend_epi16(tmp, state1, 0xF0)); /* DCBA */
+	_mm_storeu_si128((__m128i *) &h[4], _mm_alignr_epi8(state1, tmp, 8)); /* HGFE */
+}
+
+/*
+ * AVX2 multi-buffer compression, eight independent single block messages, one per 32 bit lane.
+ * w holds each message's 16 words already in big-endian word order, h the eight lanes' state.
+ */
+#define ROTR8(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+__attribute__((target("avx2")))
+static void sha256_block_x8_avx2(__m256i h[8], __m256i w[16])
+{
+	__m256i ah[8];
+	unsigned i, j;
+
+	for (i = 0; i < 8; i++)
+		ah[i] = h[i];
+
+	for (i = 0; i < 64; i++) {
+		j = i & 0xf;
+		if (i >= 16) {
+			const __m256i w1 = w[(j + 1) & 0xf], w14 = w[(j + 14) & 0xf];
+			const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(w1, 7), ROTR8(w1, 18)), _mm256_srli_epi32(w1, 3));
+			const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(w14, 17), ROTR8(w14, 19)), _mm256_srli_epi32(w14, 10));
+			w[j] = _mm256_add_epi32(_mm256_add_epi32(w[j], s0), _mm256_add_epi32(w[(j + 9) & 0xf], s1));
+		}
+		const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(ah[4], 6), ROTR8(ah[4], 11)), ROTR8(ah[4], 25));
+		const __m256i ch = _mm256_xor_si256(_mm256_and_si256(ah[4], ah[5]), _mm256_andnot_si256(ah[4], ah[6]));
+		const __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(ah[7], s1), _mm256_add_epi32(ch, w[j])),
+			_mm256_set1_epi32(k[i]));
+		const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(ah[0], 2), ROTR8(ah[0], 13)), ROTR8(ah[0], 22));
+		const __m256i maj = _mm256_xor_si256(_mm256_and_si256(ah[0], _mm256_xor_si256(ah[1], ah[2])), _mm256_and_si256(ah[1], ah[2]));
+		const __m256i temp2 = _mm256_add_epi32(s0, maj);
+
+		ah[7] = ah[6];
+		ah[6] = ah[5];
+		ah[5] = ah[4];
+		ah[4] = _mm256_add_epi32(ah[3], temp1);
+		ah[3] = ah[2];
+		ah[2] = ah[1];
+		ah[1] = ah[0];
+		ah[0] = _mm256_add_epi32(temp1, temp2);
+	}
+
+	for (i = 0; i < 8; i++)
+		h[i] = _mm256_add_epi32(h[i], ah[i]);
+}
+
+/* double SHA-256 of eight 21 byte inputs, both passes are single blocks so everything stays in lanes */
+__attribute__((target("avx2")))
+static void sha256d_21_x8_avx2(uint8_t *hashes, const uint8_t *inputs)
+{
+	uint32_t words[6][8];
+	__m256i h[8], w[16];
+	unsigned i, j;
+
+	for (j = 0; j < 8; j++) {
+		const uint8_t *in = inputs + j * 21;
+		for (i = 0; i < 5; i++)
+			words[i][j] = (uint32_t) in[i * 4] << 24 | (uint32_t) in[i * 4 + 1] << 16 |
+				(uint32_t) in[i * 4 + 2] << 8 | in[i * 4 + 3];
+		words[5][j] = (uint32_t) in[20] << 24 | 0x800000U; /* last byte, then the '1' bit */
+	}
+
+	for (i = 0; i < 8; i++)
+		h[i] = _mm256_set1_epi32(sha256_initial[i]);
+	for (i = 0; i < 6; i++)
+		w[i] = _mm256_loadu_si256((const __m256i *) words[i]);
+	for (; i < 15; i++)
+		w[i] = _mm256_setzero_si256();
+	w[15] = _mm256_set1_epi32(21 * 8);
+	sha256_block_x8_avx2(h, w);
+
+	/* second pass hashes the 32 byte digest, which is already in word order */
+	for (i = 0; i < 8; i++) {
+		w[i] = h[i];
+		h[i] = _mm256_set1_epi32(sha256_initial[i]);
+	}
+	w[8] = _mm256_set1_epi32(0x80000000U);
+	for (i = 9; i < 15; i++)
+		w[i] = _mm256_setzero_si256();
+	w[15] = _mm256_set1_epi32(32 * 8);
+	sha256_block_x8_avx2(h, w);
+
+	uint32_t out[8][8];
+	for (i = 0; i < 8; i++)
+		_mm256_storeu_si256((__m256i *) out[i], h[i]);
+	for (j = 0; j < 8; j++)
+		for (i = 0; i < 8; i++) {
+			hashes[j * 32 + i * 4 + 0] = (uint8_t) (out[i][j] >> 24);
+			hashes[j * 32 + i * 4 + 1] = (uint8_t) (out[i][j] >> 16);
+			hashes[j * 32 + i * 4 + 2] = (uint8_t) (out[i][j] >> 8);
+			hashes[j * 32 + i * 4 + 3] = (uint8_t) out[i][j];
+		}
+}
+#endif
+
+/* the compression function, SHA-NI where the CPU has it */
+static void sha256_blocks(uint32_t h[8], const uint8_t *p, size_t blocks)
+{
+#ifdef SHA256_X86
+	if (__builtin_cpu_supports("sha"))
+		return sha256_blocks_shani(h, p, blocks);
+#endif
+	sha256_blocks_scalar(h, p, blocks);
+}
+
 /*
  * Limitations:
  * - Since input is a pointer in RAM, the data to hash should be in RAM, which could be a problem
@@ -67,11 +294,9 @@ bool calc_sha_256(void* hash_raw, const void * input, size_t len)
 	for (i = 0; i < INT64_SIZE; i++)
 		total_len[i] = (uint8_t) ((len << 3) >> ((INT64_SIZE - i - 1) * 8));
 
-	/*
-	 * Initialize hash values:
-	 * (first 32 bits of the fractional parts of the square roots of the first 8 primes 2..19):
-	 */
-	uint32_t h[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	/* Initialize hash values */
+	uint32_t h[8];
+	memcpy(h, sha256_initial, sizeof(h));
 
 	/* Reserve a chunk for Pre-processing */
 	uint8_t processed_chunk[CHUNK_SIZE];
@@ -107,63 +332,7 @@ bool calc_sha_256(void* hash_raw, const void * input, size_t len)
 			p = processed_chunk;
 		}
 
-		uint32_t ah[8];
-
-		/* Initialize working variables to current hash value: */
-		for (i = 0; i < 8; i++)
-			ah[i] = h[i];
-
-		/* Compression function main loop: */
-		for (i = 0; i < 4; i++) {
-			/*
-			 * The w-array is really w[64], but since we only need
-			 * 16 of them at a time, we save stack by calculating
-			 * 16 at a time.
-			 *
-			 * This optimization was not there initially and the
-			 * rest of the comments about w[64] are kept in their
-			 * initial state.
-			 */
-
-			/*
-			 * create a 64-entry message schedule array w[0..63] of 32-bit words
-			 * (The initial values in w[0..63] don't matter, so many implementations zero them here)
-			 * copy chunk into first 16 words w[0..15] of the message schedule array
-			 */
-			uint32_t w[16];
-
-			for (j = 0; j < 16; j++) {
-				if (i == 0) {
-					w[j] = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
-						(uint32_t) p[2] << 8 | (uint32_t) p[3];
-					p += 4;
-				} else {
-					/* Extend the first 16 words into the remaining 48 words w[16..63] of the message schedule array: */
-					const uint32_t s0 = right_rot(w[(j + 1) & 0xf], 7) ^ right_rot(w[(j + 1) & 0xf], 18) ^ (w[(j + 1) & 0xf] >> 3);
-					const uint32_t s1 = right_rot(w[(j + 14) & 0xf], 17) ^ right_rot(w[(j + 14) & 0xf], 19) ^ (w[(j + 14) & 0xf] >> 10);
-					w[j] = w[j] + s0 + w[(j + 9) & 0xf] + s1;
-				}
-				const uint32_t s1 = right_rot(ah[4], 6) ^ right_rot(ah[4], 11) ^ right_rot(ah[4], 25);
-				const uint32_t ch = (ah[4] & ah[5]) ^ (~ah[4] & ah[6]);
-				const uint32_t temp1 = ah[7] + s1 + ch + k[i << 4 | j] + w[j];
-				const uint32_t s0 = right_rot(ah[0], 2) ^ right_rot(ah[0], 13) ^ right_rot(ah[0], 22);
-				const uint32_t maj = (ah[0] & ah[1]) ^ (ah[0] & ah[2]) ^ (ah[1] & ah[2]);
-				const uint32_t temp2 = s0 + maj;
-
-				ah[7] = ah[6];
-				ah[6] = ah[5];
-				ah[5] = ah[4];
-				ah[4] = ah[3] + temp1;
-				ah[3] = ah[2];
-				ah[2] = ah[1];
-				ah[1] = ah[0];
-				ah[0] = temp1 + temp2;
-			}
-		}
-
-		/* Add the compressed chunk to the current hash value: */
-		for (i = 0; i < 8; i++)
-			h[i] += ah[i];
+		sha256_blocks(h, p, 1);
 	}
 
 	/* Produce the final hash value (big-endian): */
@@ -176,3 +345,57 @@ bool calc_sha_256(void* hash_raw, const void * input, size_t len)
 	}
     return true;
 }
+
+/*
+ * Double SHA-256 of a 21 byte input (version byte + AccountID), the base58check checksum of every
+ * account. Both passes fit a single block, so the padding is laid down directly instead of going
+ * through the generic chunking in calc_sha_256().
+ */
+void sha256d_21(void *hash_raw, const void *input)
+{
+	uint8_t *hash = (uint8_t *) hash_raw;
+	uint8_t block[CHUNK_SIZE];
+	uint32_t h[8];
+	unsigned i;
+
+	memcpy(block, input, 21);
+	block[21] = 0x80;
+	memset(block + 22, 0, CHUNK_SIZE - 22);
+	block[CHUNK_SIZE - 1] = 21 * 8;
+	memcpy(h, sha256_initial, sizeof(h));
+	sha256_blocks(h, block, 1);
+
+	for (i = 0; i < 8; i++) {
+		block[i * 4 + 0] = (uint8_t) (h[i] >> 24);
+		block[i * 4 + 1] = (uint8_t) (h[i] >> 16);
+		block[i * 4 + 2] = (uint8_t) (h[i] >> 8);
+		block[i * 4 + 3] = (uint8_t) h[i];
+	}
+	block[32] = 0x80;
+	memset(block + 33, 0, CHUNK_SIZE - 33);
+	block[CHUNK_SIZE - 2] = (32 * 8) >> 8;
+	memcpy(h, sha256_initial, sizeof(h));
+	sha256_blocks(h, block, 1);
+
+	for (i = 0; i < 8; i++) {
+		hash[i * 4 + 0] = (uint8_t) (h[i] >> 24);
+		hash[i * 4 + 1] = (uint8_t) (h[i] >> 16);
+		hash[i * 4 + 2] = (uint8_t) (h[i] >> 8);
+		hash[i * 4 + 3] = (uint8_t) h[i];
+	}
+}
+
+/*
+ * Eight at a time. The AVX2 lanes beat SHA-NI here since a single SHA-NI stream is latency bound,
+ * SHA-NI (through sha256d_21) covers CPUs without AVX2.
+ */
+void sha256d_21_x8(void *hashes, const void *inputs)
+{
+	unsigned i;
+#ifdef SHA256_X86
+	if (__builtin_cpu_supports("avx2"))
+		return sha256d_21_x8_avx2(hashes, inputs);
+#endif
+	for (i = 0; i < 8; i++)
+		sha256d_21((uint8_t *) hashes + i * 32, (const uint8_t *) inputs + i * 21);
+}
@@ -1 +1,3 @@
 bool calc_sha_256(void* hash, const void *input, size_t len);
+void sha256d_21(void* hash, const void *input);
+void sha256d_21_x8(void* hashes, const void *inputs);
@@ -0,0 +1,322 @@
+/*
+ * SHA-512, laid out like sha-256.c: a portable compression function, an AVX2 multi-buffer variant
+ * selected at runtime, and the XRPL SHA-512Half helpers built on them.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sha-512.h"
+
+#define CHUNK_SIZE 128
+#define INT128_SIZE 16
+
+/*
+ * Round constants:
+ * (first 64 bits of the fractional parts of the cube roots of the first 80 primes 2..409):
+ */
+static const uint64_t k[] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/*
+ * Initial hash values:
+ * (first 64 bits of the fractional parts of the square roots of the first 8 primes 2..19):
+ */
+static const uint64_t sha512_initial[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static inline uint64_t right_rot(uint64_t value, unsigned int count)
+{
+	return value >> count | value << (64 - count);
+}
+
+static inline uint64_t load_be64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return __builtin_bswap64(v);
+}
+
+static void sha512_blocks(uint64_t h[8], const uint8_t *p, size_t blocks)
+{
+	unsigned i, j;
+
+	while (blocks--) {
+		uint64_t ah[8], w[16];
+
+		for (i = 0; i < 8; i++)
+			ah[i] = h[i];
+
+		for (i = 0; i < 16; i++)
+			w[i] = load_be64(p + i * 8);
+
+		/* 80 rounds, the message schedule is kept as a 16 word ring */
+		for (i = 0; i < 80; i++) {
+			j = i & 0xf;
+			if (i >= 16) {
+				const uint64_t w1 = w[(j + 1) & 0xf], w14 = w[(j + 14) & 0xf];
+				const uint64_t s0 = right_rot(w1, 1) ^ right_rot(w1, 8) ^ (w1 >> 7);
+				const uint64_t s1 = right_rot(w14, 19) ^ right_rot(w14, 61) ^ (w14 >> 6);
+				w[j] = w[j] + s0 + w[(j + 9) & 0xf] + s1;
+			}
+			const uint64_t s1 = right_rot(ah[4], 14) ^ right_rot(ah[4], 18) ^ right_rot(ah[4], 41);
+			const uint64_t ch = (ah[4] & ah[5]) ^ (~ah[4] & ah[6]);
+			const uint64_t temp1 = ah[7] + s1 + ch + k[i] + w[j];
+			const uint64_t s0 = right_rot(ah[0], 28) ^ right_rot(ah[0], 34) ^ right_rot(ah[0], 39);
+			const uint64_t maj = (ah[0] & ah[1]) ^ (ah[0] & ah[2]) ^ (ah[1] & ah[2]);
+			const uint64_t temp2 = s0 + maj;
+
+			ah[7] = ah[6];
+			ah[6] = ah[5];
+			ah[5] = ah[4];
+			ah[4] = ah[3] + temp1;
+			ah[3] = ah[2];
+			ah[2] = ah[1];
+			ah[1] = ah[0];
+			ah[0] = temp1 + temp2;
+		}
+
+		for (i = 0; i < 8; i++)
+			h[i] += ah[i];
+		p += CHUNK_SIZE;
+	}
+}
+
+void sha512_init(struct sha512_ctx *ctx)
+{
+	memcpy(ctx->h, sha512_initial, sizeof(ctx->h));
+	ctx->total = 0;
+	ctx->buffered = 0;
+}
+
+void sha512_update(struct sha512_ctx *ctx, const void *input, size_t len)
+{
+	const uint8_t *p = input;
+	ctx->total += len;
+
+	if (ctx->buffered > 0) {
+		size_t take = CHUNK_SIZE - ctx->buffered;
+		if (take > len)
+			take = len;
+		memcpy(ctx->buffer + ctx->buffered, p, take);
+		ctx->buffered += take;
+		p += take;
+		len -= take;
+		if (ctx->buffered < CHUNK_SIZE)
+			return;
+		sha512_blocks(ctx->h, ctx->buffer, 1);
+		ctx->buffered = 0;
+	}
+
+	/* whole blocks straight from the input */
+	sha512_blocks(ctx->h, p, len / CHUNK_SIZE);
+	p += len - len % CHUNK_SIZE;
+	len %= CHUNK_SIZE;
+
+	memcpy(ctx->buffer, p, len);
+	ctx->buffered = len;
+}
+
+void sha512_final(struct sha512_ctx *ctx, void *hash_raw)
+{
+	uint8_t *hash = (uint8_t *) hash_raw;
+	unsigned i;
+
+	/* a single '1' bit, zeros, then the 128-bit message length (the top 64 bits are always zero here) */
+	uint64_t bits = ctx->total << 3;
+	ctx->buffer[ctx->buffered++] = 0x80;
+	if (ctx->buffered > CHUNK_SIZE - INT128_SIZE) {
+		memset(ctx->buffer + ctx->buffered, 0, CHUNK_SIZE - ctx->buffered);
+		sha512_blocks(ctx->h, ctx->buffer, 1);
+		ctx->buffered = 0;
+	}
+	memset(ctx->buffer + ctx->buffered, 0, CHUNK_SIZE - ctx->buffered);
+	for (i = 0; i < 8; i++)
+		ctx->buffer[CHUNK_SIZE - 1 - i] = (uint8_t) (bits >> (i * 8));
+	sha512_blocks(ctx->h, ctx->buffer, 1);
+
+	for (i = 0; i < 64; i++)
+		hash[i] = (uint8_t) (ctx->h[i / 8] >> (56 - (i % 8) * 8));
+}
+
+bool calc_sha_512(void *hash, const void *input, size_t len)
+{
+	struct sha512_ctx ctx;
+	sha512_init(&ctx);
+	sha512_update(&ctx, input, len);
+	sha512_final(&ctx, hash);
+	return true;
+}
+
+void sha512_half_final(struct sha512_ctx *ctx, void *hash)
+{
+	uint8_t full[64];
+	sha512_final(ctx, full);
+	memcpy(hash, full, 32);
+}
+
+void sha512_half_prefixed(void *hash, uint32_t prefix, const void *input, size_t len)
+{
+	uint8_t p[4] = { prefix >> 24, prefix >> 16, prefix >> 8, prefix };
+	struct sha512_ctx ctx;
+	sha512_init(&ctx);
+	sha512_update(&ctx, p, sizeof(p));
+	sha512_update(&ctx, input, len);
+	sha512_half_final(&ctx, hash);
+}
+
+/*
+ * Block `block` of the padded message prefix || input, for the multi-buffer path where the lanes are
+ * fed one block at a time. Returns 0 once the message has no such block.
+ */
+static int sha512_prefixed_block(uint8_t out[CHUNK_SIZE], uint32_t prefix, const uint8_t *input, size_t len,
+	size_t block)
+{
+	size_t total = len + 4;
+	size_t blocks = (total + 1 + INT128_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	size_t start = block * CHUNK_SIZE, at;
+	unsigned i;
+
+	if (block >= blocks)
+		return 0;
+
+	memset(out, 0, CHUNK_SIZE);
+	at = start;
+	if (at < 4) {
+		for (; at < 4; at++)
+			out[at] = (uint8_t) (prefix >> (24 - at * 8));
+	}
+	if (at < total) {
+		size_t take = total - at;
+		if (take > start + CHUNK_SIZE - at)
+			take = start + CHUNK_SIZE - at;
+		memcpy(out + (at - start), input + (at - 4), take);
+	}
+	if (total >= start && total < start + CHUNK_SIZE)
+		out[total - start] = 0x80;
+	if (block == blocks - 1)
+		for (i = 0; i < 8; i++)
+			out[CHUNK_SIZE - 1 - i] = (uint8_t) ((uint64_t) total << 3 >> (i * 8));
+	return 1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHA512_X86 1
+
+/*
+ * AVX2 multi-buffer compression, four independent messages, one per 64 bit lane.
+ * w holds each lane's 16 words already in big-endian word order. Lanes that are not in `active`
+ * (all ones per live lane) keep their state, so messages of different lengths share the loop.
+ */
+#define ROTR4(x, n) _mm256_or_si256(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+
+__attribute__((target("avx2")))
+static void sha512_block_x4_avx2(__m256i h[8], __m256i w[16], __m256i active)
+{
+	__m256i ah[8];
+	unsigned i, j;
+
+	for (i = 0; i < 8; i++)
+		ah[i] = h[i];
+
+	for (i = 0; i < 80; i++) {
+		j = i & 0xf;
+		if (i >= 16) {
+			const __m256i w1 = w[(j + 1) & 0xf], w14 = w[(j + 14) & 0xf];
+			const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR4(w1, 1), ROTR4(w1, 8)), _mm256_srli_epi64(w1, 7));
+			const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR4(w14, 19), ROTR4(w14, 61)), _mm256_srli_epi64(w14, 6));
+			w[j] = _mm256_add_epi64(_mm256_add_epi64(w[j], s0), _mm256_add_epi64(w[(j + 9) & 0xf], s1));
+		}
+		const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR4(ah[4], 14), ROTR4(ah[4], 18)), ROTR4(ah[4], 41));
+		const __m256i ch = _mm256_xor_si256(_mm256_and_si256(ah[4], ah[5]), _mm256_andnot_si256(ah[4], ah[6]));
+		const __m256i temp1 = _mm256_add_epi64(_mm256_add_epi64(_mm256_add_epi64(ah[7], s1), _mm256_add_epi64(ch, w[j])),
+			_mm256_set1_epi64x((long long) k[i]));
+		const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR4(ah[0], 28), ROTR4(ah[0], 34)), ROTR4(ah[0], 39));
+		const __m256i maj = _mm256_xor_si256(_mm256_and_si256(ah[0], _mm256_xor_si256(ah[1], ah[2])), _mm256_and_si256(ah[1], ah[2]));
+		const __m256i temp2 = _mm256_add_epi64(s0, maj);
+
+		ah[7] = ah[6];
+		ah[6] = ah[5];
+		ah[5] = ah[4];
+		ah[4] = _mm256_add_epi64(ah[3], temp1);
+		ah[3] = ah[2];
+		ah[2] = ah[1];
+		ah[1] = ah[0];
+		ah[0] = _mm256_add_epi64(temp1, temp2);
+	}
+
+	for (i = 0; i < 8; i++)
+		h[i] = _mm256_blendv_epi8(h[i], _mm256_add_epi64(h[i], ah[i]), active);
+}
+
+__attribute__((target("avx2")))
+static void sha512_half_prefixed_x4_avx2(uint8_t *hashes, uint32_t prefix, const uint8_t *const *inputs,
+	const size_t *lens)
+{
+	uint8_t blocks[4][CHUNK_SIZE];
+	uint64_t words[16][4], live[4], out[8][4];
+	__m256i h[8], w[16];
+	unsigned i, j;
+	size_t block;
+
+	for (i = 0; i < 8; i++)
+		h[i] = _mm256_set1_epi64x((long long) sha512_initial[i]);
+
+	for (block = 0;; block++) {
+		int any = 0;
+		for (j = 0; j < 4; j++) {
+			live[j] = (sha512_prefixed_block(blocks[j], prefix, inputs[j], lens[j], block) ? ~0ULL : 0);
+			any |= (live[j] != 0);
+			for (i = 0; i < 16; i++)
+				words[i][j] = load_be64(blocks[j] + i * 8);
+		}
+		if (!any)
+			break;
+		for (i = 0; i < 16; i++)
+			w[i] = _mm256_loadu_si256((const __m256i *) words[i]);
+		sha512_block_x4_avx2(h, w, _mm256_loadu_si256((const __m256i *) live));
+	}
+
+	/* SHA-512Half keeps the first four words */
+	for (i = 0; i < 4; i++)
+		_mm256_storeu_si256((__m256i *) out[i], h[i]);
+	for (j = 0; j < 4; j++)
+		for (i = 0; i < 32; i++)
+			hashes[j * 32 + i] = (uint8_t) (out[i / 8][j] >> (56 - (i % 8) * 8));
+}
+#endif
+
+void sha512_half_prefixed_x4(void *hashes, uint32_t prefix, const void *const *inputs, const size_t *lens)
+{
+	unsigned i;
+#ifdef SHA512_X86
+	if (__builtin_cpu_supports("avx2"))
+		return sha512_half_prefixed_x4_avx2(hashes, prefix, (const uint8_t *const *) inputs, lens);
+#endif
+	for (i = 0; i < 4; i++)
+		sha512_half_prefixed((uint8_t *) hashes + i * 32, prefix, inputs[i], lens[i]);
+}
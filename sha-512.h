@@ -0,0 +1,33 @@
+#ifndef SHA_512_H
+#define SHA_512_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* XRPL hash prefixes, hashed ahead of the object, "TXN\0" gives a transaction's ID */
+#define SHA512_PREFIX_TRANSACTION_ID 0x54584E00U
+
+struct sha512_ctx
+{
+	uint64_t h[8];
+	uint64_t total;
+	size_t buffered;
+	uint8_t buffer[128];
+};
+
+bool calc_sha_512(void* hash, const void *input, size_t len);
+
+/* incremental, for input that arrives in pieces */
+void sha512_init(struct sha512_ctx *ctx);
+void sha512_update(struct sha512_ctx *ctx, const void *input, size_t len);
+void sha512_final(struct sha512_ctx *ctx, void *hash);
+void sha512_half_final(struct sha512_ctx *ctx, void *hash);
+
+/* SHA-512Half (the first 32 bytes of SHA-512) of the 4 byte big-endian prefix followed by the input */
+void sha512_half_prefixed(void* hash, uint32_t prefix, const void *input, size_t len);
+
+/* four at a time in AVX2 lanes where the CPU has them, hashes are written 32 bytes apart */
+void sha512_half_prefixed_x4(void* hashes, uint32_t prefix, const void *const *inputs, const size_t *lens);
+
+#endif
@@ -32,7 +32,18 @@ do
     RESULT2="`cat $f | ../xd - | jq empty 2>&1 | wc -c`"
     ../xd $f
     RESULT3="`../xd $f | jq empty 2>&1 | wc -c`"
-    RESULT="`echo $RESULT1 + $RESULT2 + $RESULT3 | bc`"
+    ../xd --batch $f
+    RESULT4="`../xd --batch $f | jq 'select(has("error"))' 2>&1 | wc -c`"
+    RESULT5="`../xd --fields TransactionType,AffectedNodes $TEST | jq -c . | cmp - <(../xd $TEST | jq -c 'with_entries(select(.key == "TransactionType" or .key == "AffectedNodes"))') 2>&1 | wc -c`"
+    RESULT6="`../xd --batch --filter 'TransactionType!=Payment' $f | jq -c . | cmp - <(../xd --batch $f | jq -c 'select(.TransactionType != "Payment")') 2>&1 | wc -c`"
+    RESULT7="`(../xd --hash $TEST; cat $f | ../xd --hash -; ../xd --batch --hash $f) | jq -r .hash | uniq | wc -l | grep -v '^1$' | wc -c`"
+    RESULT8="`../xd --batch --arrow $f | (head -c 6; tail -c 6) | grep -vx ARROW1ARROW1 | wc -c`"
+    RESULT9="`../xd --batch --tsv --no-header --columns TransactionType,Account,Fee,Sequence $f | cmp - <(../xd --batch $f | jq -r '[.TransactionType, .Account, .Fee, .Sequence] | @tsv') 2>&1 | wc -c`"
+    RESULT10="`cmp <(../xd --cbor --hash $TEST) <(../xd --batch --cbor --hash $f) 2>&1 | wc -c`"
+    RESULT11="`../xd $TEST | ../xd --encode - | cmp - <(echo $TEST) 2>&1 | wc -c`"
+    RESULT12="`../xd --batch --compact $f | grep '"-0\.\?"' | wc -c`"
+    RESULT13="`((../xd --hash --fields TransactionType ${TEST:0:-2} || ../xd --hash --fields TransactionType ${TEST:0:${#TEST}/2}) > /dev/null 2>&1 && echo accepted truncated input) | wc -c`"
+    RESULT="`echo $RESULT1 + $RESULT2 + $RESULT3 + $RESULT4 + $RESULT5 + $RESULT6 + $RESULT7 + $RESULT8 + $RESULT9 + $RESULT10 + $RESULT11 + $RESULT12 + $RESULT13 | bc`"
     if [ "$RESULT" -eq "0" ]; then
         echo "TEST $COUNTER/$COUNT :: PASS :: $f"
     else
@@ -0,0 +1,2305 @@
+/**
+ * XRPL Deserializer
+ * Author: Richard Holland
+ * Date: 21/5/21
+ * libxd: parses a serialized xrpl object into visitor events and decodes it to JSON, see xd.h
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#include "libbase58.h"
+#include "sha-512.h"
+#include "xd.h"
+
+#define DEBUG 0
+
+// write out the buffered output, followed by an optional fragment too large to be worth copying in
+static int flush_output(int write_fd, uint8_t* buffer, int* upto, uint8_t* extra, int extra_len)
+{
+    struct iovec iov[2] = { { buffer, *upto }, { extra, extra_len } };
+    struct iovec* v = iov;
+    int iovcnt = (extra_len > 0 ? 2 : 1);
+    while (iovcnt > 0)
+    {
+        ssize_t written = writev(write_fd, v, iovcnt);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+            return 0;
+
+        for (; iovcnt > 0 && written >= v->iov_len; --iovcnt)
+            written -= (v++)->iov_len;
+
+        if (iovcnt > 0)
+        {
+            v->iov_base = (uint8_t*)v->iov_base + written;
+            v->iov_len -= written;
+        }
+    }
+    *upto = 0;
+    return 1;
+}
+
+/**
+ * Where the JSON (or CBOR) goes, one of:
+ *  - stream mode: `output` is the context's write buffer, flushed to write_fd whenever it fills;
+ *  - chunked (XD_CHUNKED): `output` is the bytes of `chunk`, a full chunk is left as it is and the next is taken;
+ *  - otherwise: `output` is ctx->output, doubled when it fills unless it is the caller's (`fixed`).
+ * A buffer mode result is NUL terminated once at the end, so `len` excludes a byte kept for it.
+ */
+struct xd_chunk
+{
+    struct xd_chunk* next;
+    int len;
+    uint8_t bytes[XD_OUTPUT_CHUNK_SIZE];
+};
+
+struct xd_sink
+{
+    uint8_t* output;
+    int upto;
+    int len;
+    int write_fd;
+    int fixed;
+    struct xd_chunk* chunk;
+};
+
+// move on to the chunk after the current one, allocated the first time the arena grows this far
+static int next_chunk(struct xd_sink* sink)
+{
+    struct xd_chunk* chunk = sink->chunk;
+    chunk->len = sink->upto;
+    if (!chunk->next)
+    {
+        if (!(chunk->next = malloc(sizeof(*chunk->next))))
+            return 0;
+        chunk->next->next = 0;
+    }
+    sink->chunk = chunk->next;
+    sink->output = sink->chunk->bytes;
+    sink->upto = 0;
+    sink->len = XD_OUTPUT_CHUNK_SIZE;
+    return 1;
+}
+
+// a fragment that doesn't fit the current chunk spills into the next ones, `bytes` null for `len` tabs
+static int append_chunked(struct xd_sink* sink, const uint8_t* bytes, int len)
+{
+    while (len > 0)
+    {
+        if (sink->upto == sink->len && !next_chunk(sink))
+            return 0;
+        int room = sink->len - sink->upto;
+        int part = (len < room ? len : room);
+        if (bytes)
+        {
+            memcpy(sink->output + sink->upto, bytes, part);
+            bytes += part;
+        }
+        else
+            memset(sink->output + sink->upto, '\t', part);
+        sink->upto += part;
+        len -= part;
+    }
+    return 1;
+}
+
+// `append_len` is the exact length of the fragment, it need not be NUL terminated
+static int append(struct xd_sink* sink, int indent_level, const uint8_t* append, int append_len)
+{
+
+    if (DEBUG)
+        printf("append: `%.*s`\n", append_len, append);
+
+    if (sink->len - sink->upto < indent_level + append_len)
+    {
+        if (sink->chunk)
+            return append_chunked(sink, 0, indent_level) && append_chunked(sink, append, append_len);
+
+        if (sink->write_fd)
+        {
+            if (!flush_output(sink->write_fd, sink->output, &sink->upto, 0, 0))
+                return 0;
+
+            // too large to be worth copying in, it goes out straight after its indent
+            if (sink->len < indent_level + append_len)
+            {
+                memset(sink->output, '\t', indent_level);
+                sink->upto = indent_level;
+                return flush_output(sink->write_fd, sink->output, &sink->upto, (uint8_t*)append, append_len);
+            }
+        }
+        else
+        {
+            if (sink->fixed)
+                return 0;
+            int len = sink->len;
+            while (len - sink->upto < indent_level + append_len)
+                len *= 2;
+            uint8_t* grown = realloc(sink->output, len + 1);
+            if (grown == 0)
+                return 0;
+            sink->output = grown;
+            sink->len = len;
+        }
+    }
+
+    // tabs for indent
+    memset(sink->output + sink->upto, '\t', indent_level);
+    sink->upto += indent_level;
+    memcpy(sink->output + sink->upto, append, append_len);
+    sink->upto += append_len;
+    return 1;
+}
+
+// record a failure on the context, returns 0 so callbacks can `return xd_error(...)`
+static int xd_error(struct xd_ctx* ctx, int code, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    ctx->error = code;
+    vsnprintf(ctx->error_message, sizeof(ctx->error_message), format, args);
+    va_end(args);
+    return 0;
+}
+
+// record the error and where it happened (counting from the start of the input) then stop
+#define FAIL(code, ...)\
+{\
+    xd_error(ctx, (code), __VA_ARGS__);\
+    ctx->error_offset = consumed + (n - input);\
+    return 0;\
+}
+
+// hand an event to the visitor, a callback that returns 0 stops the parse
+#define EMIT(event, ...)\
+{\
+    if (visitor->event && !visitor->event(__VA_ARGS__))\
+    {\
+        if (ctx->error == XD_OK)\
+            xd_error(ctx, XD_ERR_VISITOR, "Error: stopped by the visitor");\
+        ctx->error_offset = consumed + (n - input);\
+        return 0;\
+    }\
+}
+
+#define _REQUIRE(b,suppress)\
+{\
+    if (DEBUG) printf("\nREQUIRE CALLED AT LINE %d FOR %d bytes, remaining = %d ["\
+            "%02X %02X %02X %02X %02X]\n", __LINE__, (b), remaining,\
+            (remaining >= 1 ? n[0] : 0), \
+            (remaining >= 2 ? n[1] : 0), \
+            (remaining >= 3 ? n[2] : 0), \
+            (remaining >= 4 ? n[3] : 0), \
+            (remaining >= 5 ? n[4] : 0));\
+    if (remaining < (b) && !(!fetch_data_func && suppress))\
+    {\
+        if (!fetch_data_func)\
+            FAIL(XD_ERR_TRUNCATED, "Error: expecting %d bytes but input was short (only %d remain)", (int)(b), remaining);\
+        /* a mirrored buffer has room for a whole buffer's worth from wherever n is */\
+        int room = (mirrored ? input_len : input_len - (int)(n - input));\
+        if (room < (b))\
+            FAIL(XD_ERR_OVERSIZE, "Error: %d byte field does not fit the %d byte input buffer", (int)(b), input_len);\
+        /* a mirrored fetch may write over bytes already passed, they are hashed first */\
+        if (mirrored && hashing)\
+        {\
+            sha512_update(&txid, hashed, n - hashed);\
+            hashed = n;\
+        }\
+        int needed = 0;\
+        do\
+        {\
+            needed = (b) - remaining;\
+            if (needed < 0) needed = 0;\
+            int bytes_read = (*fetch_data_func)(fetch_arg, n + remaining, room - remaining, needed);\
+            if (bytes_read < -1)\
+                FAIL(XD_ERR_INPUT, "Error: input could not be read");\
+            if (bytes_read < 0)\
+            {\
+                if (!suppress)\
+                    FAIL(XD_ERR_TRUNCATED, "Error: expecting %d bytes but input was short (only %d remain)", (int)(b), remaining);\
+                break;\
+            }\
+            remaining += bytes_read;\
+        } while(remaining < (b));\
+    }\
+}
+
+#define REQUIRE(b) _REQUIRE(b,0)
+
+#define ADVANCE(x)\
+{\
+    if (fetch_data_func)\
+        REQUIRE(x);\
+    n += (x); remaining -= (x);\
+    if (fetch_data_func && mirrored &&\
+        n - input >= input_len)\
+    {\
+        /* n has run onto the second mapping, which is the first one again */\
+        if (hashing)\
+            sha512_update(&txid, hashed, input + input_len - hashed);\
+        hashed = input;\
+        consumed += input_len;\
+        n -= input_len;\
+    }\
+    else if (fetch_data_func && !mirrored &&\
+        n - input > input_len / 2)\
+    {\
+        if (hashing)\
+            sha512_update(&txid, input, n - input);\
+        consumed += n - input;\
+        memmove(input, n, remaining);\
+        n = input;\
+    }\
+}
+
+void xd_amount_read(struct xd_amount* amount, const uint8_t* n)
+{
+    memset(amount, 0, sizeof(*amount));
+    if ((*n) >> 7U)
+    {
+        uint16_t exponent = (((uint16_t)(*n)) << 8U) +
+                            (uint16_t)(*(n+1));
+        exponent &= 0b0011111111000000;
+        exponent >>= 6U;
+        amount->mantissa =
+            (((uint64_t)((*(n+1) & 0b111111))) << 48U) +
+            (((uint64_t)((*(n+2)))) << 40U) +
+            (((uint64_t)((*(n+3)))) << 32U) +
+            (((uint64_t)((*(n+4)))) << 24U) +
+            (((uint64_t)((*(n+5)))) << 16U) +
+            (((uint64_t)((*(n+6)))) <<  8U) +
+            (((uint64_t)((*(n+7)))) <<  0U);
+        // bit 62 is set for a positive amount, and clear for the canonical zero too
+        amount->negative = (((*n) >> 6U) & 1U) == 0 && amount->mantissa != 0;
+        amount->exponent = (int)exponent - 97;
+        amount->currency = n + 8;
+        amount->issuer = n + 28;
+        return;
+    }
+
+    amount->native = 1;
+    amount->negative =  ((*n) >> 6U == 0);
+    amount->mantissa =
+        ((uint64_t)((*n) & 0b111111U) << 56U) +
+        ((uint64_t)(*(n+1)) << 48U) +
+        ((uint64_t)(*(n+2)) << 40U) +
+        ((uint64_t)(*(n+3)) << 32U) +
+        ((uint64_t)(*(n+4)) << 24U) +
+        ((uint64_t)(*(n+5)) << 16U) +
+        ((uint64_t)(*(n+6)) <<  8U) +
+        ((uint64_t)(*(n+7)) <<  0U);
+}
+
+static int xd_projection_child(const struct xd_projection* projection, int node, uint32_t field_id)
+{
+    for (int child = projection->nodes[node].first_child; child >= 0; child = projection->nodes[child].next)
+        if (projection->nodes[child].field_id == field_id)
+            return child;
+    return -1;
+}
+
+int xd_projection_compile(struct xd_projection* projection, const struct definitions* definitions, const char* fields)
+{
+    memset(projection, 0, sizeof(*projection));
+    projection->nodes[0].first_child = -1;
+    projection->nodes[0].next = -1;
+    projection->count = 1;
+
+    const char* p = fields;
+    while (*p)
+    {
+        // one dotted path
+        int node = 0;
+        int depth = 0;
+        while (1)
+        {
+            while (*p == ' ')
+                p++;
+            int len = strcspn(p, ".,");
+            int name_len = len;
+            while (name_len > 0 && p[name_len - 1] == ' ')
+                name_len--;
+
+            uint32_t field_id = (name_len > 0 ? definitions_field_id(definitions, p, name_len) : 0);
+            if (!field_id)
+                return XD_ERR_UNKNOWN_FIELD;
+            if (++depth > XD_PROJECTION_DEPTH)
+                return XD_ERR_INDEX_FULL;
+
+            int child = xd_projection_child(projection, node, field_id);
+            if (child < 0)
+            {
+                if (projection->count >= XD_PROJECTION_SIZE)
+                    return XD_ERR_INDEX_FULL;
+                child = projection->count++;
+                projection->nodes[child].field_id = field_id;
+                projection->nodes[child].first_child = -1;
+                projection->nodes[child].next = projection->nodes[node].first_child;
+                projection->nodes[node].first_child = child;
+            }
+            node = child;
+
+            p += len;
+            if (*p != '.')
+                break;
+            p++;
+        }
+
+        // a path that ends here selects everything below it, even where a longer path also goes through it
+        projection->nodes[node].whole = 1;
+
+        if (*p == ',')
+            p++;
+    }
+
+    return (projection->count > 1 ? XD_OK : XD_ERR_UNKNOWN_FIELD);
+}
+
+/**
+ * Where a parse is between fields: how deep in objects and arrays, and where in the projection. xd_parse keeps it
+ * on its stack, the push parser in the context between chunks
+ */
+struct xd_nesting
+{
+    int object_level;
+    int array_level;
+
+    // the trie node of each selected object or array we are inside,
+    // how deep into a wholly selected one and how deep into an unselected (skipped) one
+    int16_t path[XD_PROJECTION_DEPTH + 1];
+    int projected;
+    int whole;
+    int skip;
+};
+
+// a field header is 1 - 3 bytes, its first says how many
+static inline int xd_header_len(uint8_t first)
+{
+    if (first == 0)
+        return 3;
+    if ((first >> 4U) == 0 || (first & 0xFU) == 0)
+        return 2;
+    return 1;
+}
+
+static inline void xd_header(const uint8_t* n, int* type_code, int* field_code)
+{
+    if (*n == 0)
+    {
+        // 3 byte header
+        *type_code = *(n+1);
+        *field_code = *(n+2);
+    }
+    else if ((*n >> 4U) == 0)
+    {
+        // 2 byte header (typecode >= 16 && field code < 16)
+        *field_code = (*n & 0xFU);
+        *type_code = *(n+1);
+    }
+    else if ((*n & 0xFU) == 0)
+    {
+        // 2 byte header (typecode < 16 && field code >= 16)
+        *type_code = (*n >> 4U);
+        *field_code = *(n+1);
+    }
+    else
+    {
+        // 1 byte header
+        *type_code = (*n >> 4U);
+        *field_code = (*n & 0xFU);
+    }
+}
+
+/**
+ * Take in the field whose header was just read: check its type, fill in `field`, track the nesting and apply the
+ * projection. Returns 1 if its events are emitted, 0 if it is skipped and -1 with ctx->error set if it is invalid.
+ * `end` is set for the end marker of an object or array, whose end event is then emitted or not the same way
+ */
+static inline int xd_open_field(struct xd_ctx* ctx, struct xd_nesting* s, struct xd_field* field,
+        int type_code, int field_code, int* end)
+{
+    const struct definitions* definitions = ctx->definitions;
+
+    if (type_code == 0)
+        return (xd_error(ctx, XD_ERR_UNKNOWN_TYPE, "Invalid typecode 0"), -1);
+
+    int kind = definitions->type_kind[type_code];
+    if (kind == KIND_UNKNOWN)
+        return (xd_error(ctx, XD_ERR_UNKNOWN_TYPE, "Error, unknown typecode %d", type_code), -1);
+
+    *field = (struct xd_field){ (type_code << 16U) + field_code, type_code, field_code, kind, 0, 0 };
+    int container = (kind == KIND_OBJECT || kind == KIND_ARRAY);
+
+    if (DEBUG)
+        printf("field_id: %x\n", field->field_id);
+
+    *end = (container && field_code == 1);
+    if (*end)
+    {
+        if (kind == KIND_OBJECT && s->object_level-- == 0)
+            return (xd_error(ctx, XD_ERR_UNBALANCED, "More close objects than open objects!"), -1);
+        if (kind == KIND_ARRAY && s->array_level-- == 0)
+            return (xd_error(ctx, XD_ERR_UNBALANCED, "More close arrays than open arrays!"), -1);
+        if (s->skip)
+        {
+            s->skip--;
+            return 0;
+        }
+        if (s->whole)
+            s->whole--;
+        else if (ctx->projection)
+            s->projected--;
+        return 1;
+    }
+
+    if (kind == KIND_OBJECT)
+        s->object_level++;
+    else if (kind == KIND_ARRAY)
+        s->array_level++;
+
+    // with a projection, fields off every selected path are skipped by length and never emitted
+    const struct xd_projection* projection = ctx->projection;
+    int emit = !s->skip;
+    if (emit && projection && !s->whole)
+    {
+        int node = xd_projection_child(projection, s->path[s->projected], field->field_id);
+        if (node < 0)
+            emit = 0;
+        else if (!container)
+            ;
+        else if (projection->nodes[node].whole)
+            s->whole = 1;
+        else
+            s->path[++s->projected] = node;
+    }
+    else if (emit && container && s->whole)
+        s->whole++;
+
+    if (container && !emit)
+        s->skip++;
+
+    // keys are stored as `"Name": `
+    const struct definitions_name* key = definitions_field_key(definitions, type_code, field_code);
+    if (emit && key && key->offset)
+    {
+        field->name = DEFINITIONS_STR(definitions, *key) + 1;
+        field->name_len = key->len - 4;
+    }
+
+    return emit;
+}
+
+/**
+ * The stream input buffer as a ring: `size` bytes of memory mapped twice back to back, so the bytes from any
+ * offset in the first mapping read on contiguously into the second. The parser then never compacts its input, when
+ * it reaches the second mapping it just steps back by `size`. Returns 0 if the system can't do it (no memfd)
+ */
+static uint8_t* xd_mirror_alloc(size_t size)
+{
+    int fd = memfd_create("xd_input", MFD_CLOEXEC);
+    if (fd < 0)
+        return 0;
+
+    uint8_t* base = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        base = mmap(0, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED &&
+        (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+         mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED))
+    {
+        munmap(base, size * 2);
+        base = MAP_FAILED;
+    }
+
+    close(fd);
+    return (base == MAP_FAILED ? 0 : base);
+}
+
+static void xd_free_input(struct xd_ctx* ctx)
+{
+    if (ctx->owns_input && ctx->input_mirrored)
+        munmap(ctx->input_buffer, (size_t)ctx->input_buffer_size * 2);
+    else if (ctx->owns_input)
+        free(ctx->input_buffer);
+    ctx->input_mirrored = 0;
+}
+
+/**
+ * The parser proper, it turns the serialized object into events for `visitor` and formats nothing itself.
+ * Buffer mode when fetch_data_func is null: `input` holds the whole object.
+ * Stream mode otherwise: input is read through fetch_data_func into the context's input buffer. Every event's
+ * bytes are REQUIREd before it is emitted, so the pointers it carries stay put until the callback returns.
+ * Returns 1 on success, 0 with ctx->error set on failure.
+ */
+static int xd_parse(
+        struct xd_ctx* ctx,
+        const uint8_t* input_bytes,
+        int input_len,
+        xd_fetch fetch_data_func,
+        void* fetch_arg,
+        const struct xd_visitor* visitor,
+        void* user)
+{
+    const struct definitions* definitions = ctx->definitions;
+    size_t consumed = 0;    // bytes dropped from the front of the stream buffer
+
+    uint8_t* input = (uint8_t*)input_bytes;   // only stream mode writes, and then to its own buffer
+    uint8_t* n = input;
+
+    // stream mode hashes the bytes as they leave the buffer, buffer mode all at once at the end
+    struct sha512_ctx txid;
+    const uint8_t* hashed = input;  // bytes before this are hashed
+    int hashing = ((ctx->flags & XD_TXID) && !ctx->txid_given);
+    if (hashing)
+    {
+        sha512_init(&txid);
+        sha512_update(&txid, (const uint8_t[]){ 'T', 'X', 'N', 0 }, 4);
+    }
+    ctx->txid_given = 0;
+
+    int remaining = input_len;
+    int mirrored = 0;
+    if (fetch_data_func)
+    {
+        // stream mode
+        if (!ctx->input_buffer)
+        {
+            if ((ctx->input_buffer = xd_mirror_alloc(XD_INPUT_SIZE)))
+                ctx->input_mirrored = 1;
+            else if (!(ctx->input_buffer = malloc(XD_INPUT_SIZE)))
+                FAIL(XD_ERR_MEMORY, "Error: could not allocate the input buffer");
+            ctx->input_buffer_size = XD_INPUT_SIZE;
+            ctx->owns_input = 1;
+        }
+        mirrored = ctx->input_mirrored;
+        input_len = ctx->input_buffer_size;
+        input = n = ctx->input_buffer;
+        hashed = input;
+        remaining = (*fetch_data_func)(fetch_arg, input, input_len, 1);
+        if (remaining < -1)
+            FAIL(XD_ERR_INPUT, "Error: input could not be read");
+        if (remaining < 0)
+            remaining = 0;
+    }
+
+    struct xd_nesting nesting = { 0 };
+
+    EMIT(begin_object, user, 0);
+
+    while (1)
+    {
+
+        if (fetch_data_func)
+        {
+            _REQUIRE(1, 1);
+            if (remaining == 0)
+                break;
+        }
+        else if (remaining <= 0)
+            break;
+
+        int header_len = xd_header_len(*n);
+        REQUIRE(header_len);
+        int type_code, field_code;
+        xd_header(n, &type_code, &field_code);
+        ADVANCE(header_len);
+
+        struct xd_field field;
+        int end;
+        int emit = xd_open_field(ctx, &nesting, &field, type_code, field_code, &end);
+        if (emit < 0)
+        {
+            ctx->error_offset = consumed + (n - input);
+            return 0;
+        }
+
+        if (end)
+        {
+            if (!emit)
+                continue;
+            if (field.kind == KIND_OBJECT)
+                EMIT(end_object, user)
+            else
+                EMIT(end_array, user)
+            continue;
+        }
+
+        int kind = field.kind;
+        int size = definitions->type_size[type_code];
+
+        if (kind == KIND_PATHSET)
+        {
+            if (emit)
+                EMIT(begin_pathset, user, &field);
+
+            while (1)
+            {
+                REQUIRE(1);
+                uint8_t path_type = *n;
+
+                if (path_type == 0x00U)
+                {
+                    ADVANCE(1);
+                    break;
+                }
+
+                if (path_type == 0xFFU)
+                {
+                    ADVANCE(1);
+                    if (emit)
+                        EMIT(next_path, user);
+                    continue;
+                }
+
+                // the whole step is brought in before any of it is handed over
+                int step_len = 1 + 20 * ((path_type & 0x01U) + ((path_type >> 4U) & 1U) + ((path_type >> 5U) & 1U));
+                REQUIRE(step_len);
+
+                if (emit)
+                {
+                    struct xd_path_step step = { path_type, 0, 0, 0 };
+                    const uint8_t* s = n + 1;
+                    if (path_type & 0x01U)
+                    {
+                        step.account = s;
+                        s += 20;
+                    }
+                    if (path_type & 0x10U)
+                    {
+                        step.currency = s;
+                        s += 20;
+                    }
+                    if (path_type & 0x20U)
+                        step.issuer = s;
+
+                    EMIT(path_step, user, &step);
+                }
+                ADVANCE(step_len);
+            }
+
+            if (emit)
+                EMIT(end_pathset, user);
+        }
+        else if (kind == KIND_OBJECT)
+        {   // object
+            if (emit)
+                EMIT(begin_object, user, &field);
+        }
+        else if (kind == KIND_ARRAY)
+        {   // array
+            if (emit)
+                EMIT(begin_array, user, &field);
+        }
+        else if (kind == KIND_ACCOUNT)
+        {
+            REQUIRE(1);
+            uint8_t acc_size = *n;
+            ADVANCE(1);
+            // special case where account is null
+            if (acc_size == 0)
+            {
+                if (emit)
+                    EMIT(account, user, &field, 0);
+            }
+            else
+            {
+                REQUIRE(20);
+                if (emit)
+                    EMIT(account, user, &field, n);
+                ADVANCE(20);
+            }
+        }
+        else if (kind == KIND_HASH)
+        {
+            // uint128, uint256, uint160 etc
+            REQUIRE(size);
+            if (emit)
+                EMIT(hash, user, &field, n, size);
+            ADVANCE(size);
+        }
+        else if (kind == KIND_BLOB || kind == KIND_VECTOR256)
+        {
+            REQUIRE(1);
+            int64_t field_len = *n;
+            if (field_len <= 192)
+            {
+                // one byte size
+                ADVANCE(1);
+            }
+            else if (field_len <= 240)
+            {
+                // two byte size
+                REQUIRE(2);
+                field_len = 193 + ((field_len - 193) * 256) + *(n+1);
+                ADVANCE(2);
+            }
+            else
+            {
+                // three byte size
+                REQUIRE(3);
+                field_len = 12481 + ((field_len - 241) * 65536) + ((*(n+1)) * 256) + *(n+2);
+                ADVANCE(3);
+            }
+
+            if (emit && visitor->blob_part && fetch_data_func && field_len > input_len / 2)
+            {
+                // too large to hold whole, it goes to the visitor in pieces as it streams through
+                for (int offset = 0; offset < field_len;)
+                {
+                    int part = (field_len - offset < input_len / 2 ? field_len - offset : input_len / 2);
+                    REQUIRE(part);
+                    EMIT(blob_part, user, &field, n, part, offset, field_len);
+                    ADVANCE(part);
+                    offset += part;
+                }
+            }
+            else if (emit)
+            {
+                REQUIRE(field_len);
+                EMIT(blob, user, &field, n, field_len);
+                ADVANCE(field_len);
+            }
+            else
+            {
+                // a skipped blob never needs to fit the stream buffer whole, but in buffer mode it must all be there
+                if (!fetch_data_func)
+                    REQUIRE(field_len);
+                while (field_len > 0)
+                {
+                    int chunk = (!fetch_data_func || field_len < input_len / 2 ? field_len : input_len / 2);
+                    ADVANCE(chunk);
+                    field_len -= chunk;
+                }
+            }
+        }
+        else if (kind == KIND_AMOUNT)
+        {
+            REQUIRE(1);
+            int amount_len = ((*n) >> 7U ? 48 : 8);
+            REQUIRE(amount_len);
+            if (emit)
+            {
+                struct xd_amount amount;
+                xd_amount_read(&amount, n);
+                EMIT(amount, user, &field, &amount);
+            }
+            ADVANCE(amount_len);
+        }
+        else if (kind == KIND_UINT) // uint8, uint16, uint32, uint64
+        {
+            REQUIRE(size);
+            if (emit)
+            {
+                uint64_t number = 0;
+                for (int i = 0; i < size; ++i)
+                    number = (number << 8U) + *(n+i);
+                EMIT(integer, user, &field, number);
+            }
+            ADVANCE(size);
+        }
+    }
+
+    // don't pass off a partial object as a result
+    if (nesting.object_level != 0 || nesting.array_level != 0)
+        FAIL(XD_ERR_TRUNCATED, "Error: input ended inside an object or array");
+
+    if (hashing)
+    {
+        // every path checks lengths before advancing, this only makes sure the hash can never read past the input
+        if (n > input + input_len)
+            FAIL(XD_ERR_TRUNCATED, "Error: input ended inside a field");
+        sha512_update(&txid, hashed, n - hashed);
+        sha512_half_final(&txid, ctx->txid);
+    }
+
+    EMIT(end_object, user);
+    return 1;
+}
+
+#define HEX(out_raw, in_raw, len_raw)\
+{\
+    uint8_t* hex_out_ = (uint8_t*)(out_raw);\
+    const uint8_t* hex_in_ = (in_raw);\
+    uint64_t hex_len_ = (len_raw);\
+    for (uint64_t hex_i_ = 0; hex_i_ < hex_len_; ++hex_i_)\
+    {\
+        unsigned char hi = hex_in_[hex_i_] >> 4U;\
+        unsigned char lo = hex_in_[hex_i_] & 0xFU;\
+        hi += (hi > 9 ? 'A' - 10 : '0');\
+        lo += (lo > 9 ? 'A' - 10 : '0');\
+        hex_out_[hex_i_*2+0] = (char)hi;\
+        hex_out_[hex_i_*2+1] = (char)lo;\
+    }\
+}
+
+#define SHORTCHECK() ;/* if (upto >= len) return -1;*/
+static int to_fixed_point(uint8_t* outbuf, int len, uint64_t mantissa, int64_t exponent, int negative)
+{
+    //printf("mantissa: %llu, exponent: %d\n", mantissa, exponent);
+    int upto = 0;
+    char digits[17];
+    int digitcount = snprintf(digits, 17, "%llu", mantissa);
+    int digitupto = 0;
+    int point = exponent + digitcount;
+
+    int printed_point = 0;
+
+    outbuf[upto++] = '"';
+    SHORTCHECK();
+    if (negative)
+    {
+        outbuf[upto++] = '-';
+        SHORTCHECK();
+    }
+
+    for (; point > 0; --point)
+    {
+        outbuf[upto++] = (digitupto >= digitcount ? '0' : digits[digitupto++]);
+        SHORTCHECK();
+    }
+
+    if (digitupto < digitcount) // && point != 0)
+    {
+        if (digitupto == 0)
+        {
+            outbuf[upto++] = '0';
+            SHORTCHECK();
+        }
+
+        outbuf[upto++] = '.';
+        SHORTCHECK();
+
+        printed_point = 1;
+
+        for (; point < 0; ++point)
+        {
+            outbuf[upto++] = '0';
+            SHORTCHECK();
+        }
+        while (digitupto < digitcount)
+        {
+            outbuf[upto++] = (digitupto >= digitcount ? '0' : digits[digitupto++]);
+            SHORTCHECK();
+        }
+    }
+
+    // backtrack any trailing zeros
+    if (printed_point)
+        for (; outbuf[upto-1] == '0'; --upto);
+
+    outbuf[upto++] = '"';
+    SHORTCHECK();
+
+    outbuf[upto++] = '\0';
+
+
+    return upto;
+}
+
+static int is_ascii_currency(const uint8_t* y)
+{
+    for (int i = 0; i < 12; ++i)
+        if (y[i] != 0)
+            return 0;
+    for (int i = 12; i < 15; ++i)
+    {
+        char x = y[i];
+        if (x >= 'a' && x <= 'z')
+            continue;
+        if (x >= 'A' && x <= 'Z')
+            continue;
+        if (x >= '0' && x <= '9')
+            continue;
+        return 0;
+    }
+    for (int i = 15; i < 20; ++i)
+        if (y[i] != 0)
+            return 0;
+    return 1;
+}
+
+
+// the AccountID's r-address, from the context's cache when it has one
+const char* xd_address(struct xd_ctx* ctx, const uint8_t* id, size_t* len)
+{
+    if (ctx->accounts)
+        return account_cache_lookup(ctx->accounts, id, len);
+
+    *len = sizeof(ctx->address);
+    return (b58check_enc_account(ctx->address, len, 0, id) ? ctx->address : 0);
+}
+
+
+// 3 letter ISO code, XRP for all zeros, otherwise hex
+int xd_currency_code(char* out, const uint8_t* currency)
+{
+    const uint64_t* c = (const void*)currency;
+    if (!c[0] && !c[1] && !*((const uint32_t*)(currency + 16)))
+    {
+        memcpy(out, "XRP", 3);
+        return 3;
+    }
+    if (is_ascii_currency(currency))
+    {
+        memcpy(out, currency + 12, 3);
+        return 3;
+    }
+    HEX(out, currency, 20);
+    return 40;
+}
+
+int xd_amount_value(char* out, const struct xd_amount* amount)
+{
+    if (amount->native)
+        return snprintf(out, XD_AMOUNT_VALUE_SIZE, "%s%llu", (amount->negative ? "-" : ""),
+                (unsigned long long)amount->mantissa);
+
+    // the JSON form without its quotes
+    int len = to_fixed_point((uint8_t*)out, XD_AMOUNT_VALUE_SIZE, amount->mantissa, amount->exponent,
+            amount->negative);
+    memmove(out, out + 1, len - 3);
+    out[len - 3] = '\0';
+    return len - 3;
+}
+
+/**
+ * JSON output, the visitor behind xd_decode*
+ * Output goes to write_fd when it is set (through the context's write buffer), otherwise into ctx->output or with
+ * XD_CHUNKED into the context's chunks.
+ */
+struct xd_json
+{
+    struct xd_ctx* ctx;
+    int compact;
+    struct xd_sink out;
+    int indent_level;
+    int nocomma;
+    int depth;                  // open objects and arrays inside the outermost object
+    int path_count;             // steps so far in the current path
+    uint64_t parent_is_array;
+};
+
+// fragments, the compact form of a literal drops its newlines, tabs and the space after a colon
+#define LIT(x) (uint8_t*)(x), sizeof(x) - 1
+#define TEXT(pretty, compact_form) (uint8_t*)(j->compact ? (compact_form) : (pretty)), (j->compact ? sizeof(compact_form) - 1 : sizeof(pretty) - 1)
+#define APPENDPARAMS &j->out, (j->compact ? 0 : j->indent_level)
+#define APPENDNOINDENT &j->out, 0
+#define APPEND(...)\
+do\
+{\
+    if (!append(__VA_ARGS__))\
+        return xd_error(j->ctx, XD_ERR_OUTPUT, "Error: output buffer full or output could not be written");\
+} while (0)
+
+// separator, the element wrapper inside an array, then the key
+static int json_key(struct xd_json* j, const struct xd_field* field)
+{
+    if (!j->nocomma)
+        APPEND(APPENDNOINDENT, TEXT(",\n", ","));
+    j->nocomma = 0;
+
+    if (j->parent_is_array & 1)
+    {
+        APPEND(APPENDPARAMS, TEXT("{\n", "{"));
+        j->indent_level++;
+    }
+
+    if (!field->name)
+        return xd_error(j->ctx, XD_ERR_UNKNOWN_FIELD, "Error: Unknown field_id %05X", field->field_id);
+
+    // keys end in ": "
+    APPEND(APPENDPARAMS, (uint8_t*)field->name - 1, field->name_len + 4 - j->compact);
+    return 1;
+}
+
+static int json_begin(struct xd_json* j, const struct xd_field* field, int is_array)
+{
+    if (!field)
+    {
+        APPEND(APPENDPARAMS, TEXT("{\n", "{"));
+        j->indent_level++;
+        j->nocomma = 1;
+        return 1;
+    }
+
+    if (!json_key(j, field))
+        return 0;
+    if (is_array)
+        APPEND(APPENDNOINDENT, TEXT("[\n", "["));
+    else
+        APPEND(APPENDNOINDENT, TEXT("{\n", "{"));
+    j->indent_level++;
+    j->nocomma = 1;
+    j->parent_is_array <<= 1U;
+    j->parent_is_array |= (unsigned)is_array;
+    j->depth++;
+    return 1;
+}
+
+static int json_end(struct xd_json* j, int is_array)
+{
+    // the computed transaction ID goes after the outermost object's last field
+    if (j->depth == 0 && (j->ctx->flags & XD_TXID))
+    {
+        uint8_t hex[64];
+        HEX(hex, j->ctx->txid, 32);
+        if (!j->nocomma)
+            APPEND(APPENDNOINDENT, TEXT(",\n", ","));
+        APPEND(APPENDPARAMS, TEXT("\"hash\": \"", "\"hash\":\""));
+        APPEND(APPENDNOINDENT, hex, 64);
+        APPEND(APPENDNOINDENT, LIT("\""));
+    }
+
+    j->indent_level--;
+    APPEND(APPENDNOINDENT, TEXT("\n", ""));
+
+    if (j->depth == 0)
+    {
+        APPEND(APPENDPARAMS, LIT("}\n"));
+        return 1;
+    }
+
+    j->nocomma = 0;
+    APPEND(APPENDPARAMS, (uint8_t*)(is_array ? "]" : "}"), 1);
+    j->parent_is_array >>= 1U;
+    if (j->parent_is_array & 1)
+    {
+        j->indent_level--;
+        APPEND(APPENDNOINDENT, TEXT("\n", ""));
+        APPEND(APPENDPARAMS, LIT("}"));
+    }
+    j->depth--;
+    return 1;
+}
+
+static int json_begin_object(void* user, const struct xd_field* field)
+{
+    return json_begin(user, field, 0);
+}
+
+static int json_end_object(void* user)
+{
+    return json_end(user, 0);
+}
+
+static int json_begin_array(void* user, const struct xd_field* field)
+{
+    return json_begin(user, field, 1);
+}
+
+static int json_end_array(void* user)
+{
+    return json_end(user, 1);
+}
+
+static int json_integer(void* user, const struct xd_field* field, uint64_t number)
+{
+    struct xd_json* j = user;
+    const struct definitions* definitions = j->ctx->definitions;
+    if (!json_key(j, field))
+        return 0;
+
+    // named codes
+    const struct definitions_name* name = 0;
+    if (field->type_code == 1 && field->field_code == 2)
+        name = &definitions->transaction_types[number & 0xFFU];
+    else if (field->type_code == 1 && field->field_code == 1)
+        name = &definitions->ledger_entry_types[number & 0xFFU];
+    else if (field->type_code == 16 && field->field_code == 3)
+        name = &definitions->transaction_results[number & 0xFFU];
+
+    if (name && number < 256 && name->offset)
+    {
+        APPEND(APPENDNOINDENT, DEFINITIONS_STR(definitions, *name), name->len);
+        return 1;
+    }
+
+    char str[24];
+    int l = snprintf(str, 24, "%lu", number);
+    APPEND(APPENDNOINDENT, str, l);
+    return 1;
+}
+
+static int json_hash(void* user, const struct xd_field* field, const uint8_t* bytes, int size)
+{
+    struct xd_json* j = user;
+    if (!json_key(j, field))
+        return 0;
+
+    APPEND(APPENDNOINDENT, LIT("\""));
+    char hexout[513];
+    HEX(hexout, bytes, size);
+    APPEND(APPENDNOINDENT, hexout, size*2);
+    APPEND(APPENDNOINDENT, LIT("\""));
+    return 1;
+}
+
+// hex of a blob or of a piece of one, in blocks
+static int json_hex(struct xd_json* j, const uint8_t* bytes, int len)
+{
+    char hexout[1024];
+    for (int done = 0; done < len;)
+    {
+        int to_print = (len - done > (int)sizeof(hexout) / 2 ? (int)sizeof(hexout) / 2 : len - done);
+        HEX(hexout, bytes + done, to_print);
+        APPEND(APPENDNOINDENT, hexout, to_print*2);
+        done += to_print;
+    }
+    return 1;
+}
+
+static int json_blob(void* user, const struct xd_field* field, const uint8_t* bytes, int field_len)
+{
+    struct xd_json* j = user;
+    if (!json_key(j, field))
+        return 0;
+
+    APPEND(APPENDNOINDENT, LIT("\""));
+    if (!json_hex(j, bytes, field_len))
+        return 0;
+    APPEND(APPENDNOINDENT, LIT("\""));
+    return 1;
+}
+
+// the same text as json_blob, a piece at a time
+static int json_blob_part(void* user, const struct xd_field* field, const uint8_t* bytes, int len, int offset, int total)
+{
+    struct xd_json* j = user;
+    if (offset == 0)
+    {
+        if (!json_key(j, field))
+            return 0;
+        APPEND(APPENDNOINDENT, LIT("\""));
+    }
+
+    if (!json_hex(j, bytes, len))
+        return 0;
+    if (offset + len == total)
+        APPEND(APPENDNOINDENT, LIT("\""));
+    return 1;
+}
+
+static int json_account(void* user, const struct xd_field* field, const uint8_t* id)
+{
+    struct xd_json* j = user;
+    if (!json_key(j, field))
+        return 0;
+
+    if (!id)
+    {
+        APPEND(APPENDNOINDENT, LIT("\"\""));
+        return 1;
+    }
+
+    size_t acc_size = 0;
+    const char* acc = xd_address(j->ctx, id, &acc_size);
+    if (!acc)
+        return xd_error(j->ctx, XD_ERR_ENCODE, "Error: could not base58 encode");
+    APPEND(APPENDNOINDENT, LIT("\""));
+    APPEND(APPENDNOINDENT, acc, acc_size - 1);
+    APPEND(APPENDNOINDENT, LIT("\""));
+    return 1;
+}
+
+static int json_amount(void* user, const struct xd_field* field, const struct xd_amount* amount)
+{
+    struct xd_json* j = user;
+    if (!json_key(j, field))
+        return 0;
+
+    if (amount->native)
+    {
+        char str[24];
+        int l = snprintf(str, 23, "\"%s%llu\"", (amount->negative ? "-" : ""), amount->mantissa);
+        APPEND(APPENDNOINDENT, str, l);
+        return 1;
+    }
+
+    size_t issuer_size = 0;
+    const char* issuer = xd_address(j->ctx, amount->issuer, &issuer_size);
+    if (!issuer)
+        return xd_error(j->ctx, XD_ERR_ENCODE, "Error: could not base58 encode");
+
+    char currency[40];
+    int currency_len = xd_currency_code(currency, amount->currency);
+
+    uint8_t fixed[128];
+    if (to_fixed_point(fixed, 128, amount->mantissa, amount->exponent, amount->negative) == -1)
+        return xd_error(j->ctx, XD_ERR_AMOUNT, "Error: could not convert mantissa/exp to fixed point %lluE%d",
+                amount->mantissa, amount->exponent);
+
+    char str[1024];
+    int l = snprintf(str, 1024, (j->compact ? "\"value\":%s," : "\t\"value\": %s,\n"), fixed);
+
+    APPEND(APPENDNOINDENT, TEXT("{\n", "{"));
+    APPEND(APPENDPARAMS, str, l);
+    APPEND(APPENDPARAMS, TEXT("\t\"currency\": \"", "\"currency\":\""));
+    APPEND(APPENDNOINDENT, currency, currency_len);
+    APPEND(APPENDNOINDENT, TEXT("\",\n", "\","));
+    APPEND(APPENDPARAMS, TEXT("\t\"issuer\": \"", "\"issuer\":\""));
+    APPEND(APPENDNOINDENT, issuer, issuer_size - 1);
+    APPEND(APPENDNOINDENT, TEXT("\"\n", "\""));
+    APPEND(APPENDPARAMS, LIT("}"));
+    return 1;
+}
+
+static int json_begin_pathset(void* user, const struct xd_field* field)
+{
+    struct xd_json* j = user;
+    if (!json_key(j, field))
+        return 0;
+
+    APPEND(APPENDNOINDENT, TEXT("[\n", "["));
+    j->indent_level++;
+    APPEND(APPENDPARAMS, TEXT("[\n", "["));
+    j->indent_level++;
+    j->path_count = 0;
+    return 1;
+}
+
+static int json_path_step(void* user, const struct xd_path_step* step)
+{
+    struct xd_json* j = user;
+    uint8_t path_type = step->type;
+
+    if (j->path_count++ > 0)
+        APPEND(APPENDNOINDENT, TEXT(",\n", ","));
+
+    APPEND(APPENDPARAMS, TEXT("{\n", "{"));
+    j->indent_level++;
+
+    char path_type_str[128];
+    int l = snprintf(path_type_str, 128, (j->compact ? "\"type\":%d," : "\"type\": %d,\n"), path_type);
+    APPEND(APPENDPARAMS, path_type_str, l);
+
+    if (step->account)
+    {
+        path_type -= 0x01U;
+
+        APPEND(APPENDPARAMS, TEXT("\"account\": \"", "\"account\":\""));
+        size_t acc_size = 0;
+        const char* acc = xd_address(j->ctx, step->account, &acc_size);
+        if (!acc)
+            return xd_error(j->ctx, XD_ERR_ENCODE, "Error: could not base58 encode");
+        APPEND(APPENDNOINDENT, acc, acc_size - 1);
+        if (path_type)
+            APPEND(APPENDNOINDENT, TEXT("\",\n", "\","));
+        else
+            APPEND(APPENDNOINDENT, TEXT("\"\n", "\""));
+    }
+
+    if (step->currency)
+    {
+        path_type -= 0x10U;
+
+        APPEND(APPENDPARAMS, TEXT("\"currency\": \"", "\"currency\":\""));
+        char currency[40];
+        APPEND(APPENDNOINDENT, currency, xd_currency_code(currency, step->currency));
+        if (path_type)
+            APPEND(APPENDNOINDENT, TEXT("\",\n", "\","));
+        else
+            APPEND(APPENDNOINDENT, TEXT("\"\n", "\""));
+    }
+
+    if (step->issuer)
+    {
+        APPEND(APPENDPARAMS, TEXT("\"issuer\": \"", "\"issuer\":\""));
+        size_t acc_size = 0;
+        const char* acc = xd_address(j->ctx, step->issuer, &acc_size);
+        if (!acc)
+            return xd_error(j->ctx, XD_ERR_ENCODE, "Error: could not base58 encode");
+        APPEND(APPENDNOINDENT, acc, acc_size - 1);
+        APPEND(APPENDNOINDENT, TEXT("\"\n", "\""));
+    }
+
+    j->indent_level--;
+    APPEND(APPENDPARAMS, LIT("}"));
+    return 1;
+}
+
+static int json_next_path(void* user)
+{
+    struct xd_json* j = user;
+    APPEND(APPENDNOINDENT, TEXT("\n", ""));
+    j->indent_level--;
+    APPEND(APPENDPARAMS, TEXT("],\n", "],"));
+    APPEND(APPENDPARAMS, TEXT("[\n", "["));
+    j->indent_level++;
+    j->path_count = 0;
+    return 1;
+}
+
+static int json_end_pathset(void* user)
+{
+    struct xd_json* j = user;
+    APPEND(APPENDNOINDENT, TEXT("\n", ""));
+    j->indent_level--;
+    APPEND(APPENDPARAMS, TEXT("]\n", "]"));
+    j->indent_level--;
+    APPEND(APPENDPARAMS, TEXT("]\n", "]"));
+    return 1;
+}
+
+static const struct xd_visitor json_visitor =
+{
+    .begin_object = json_begin_object,
+    .end_object = json_end_object,
+    .begin_array = json_begin_array,
+    .end_array = json_end_array,
+    .integer = json_integer,
+    .hash = json_hash,
+    .account = json_account,
+    .amount = json_amount,
+    .blob = json_blob,
+    .blob_part = json_blob_part,
+    .begin_pathset = json_begin_pathset,
+    .path_step = json_path_step,
+    .next_path = json_next_path,
+    .end_pathset = json_end_pathset
+};
+
+/**
+ * CBOR output (RFC 8949), the visitor behind xd_decode* with XD_CBOR
+ * It writes the same tree as the JSON visitor: maps keyed by field name, each array element a map of one field,
+ * UInts as integers, named codes, amounts, addresses and hex as text. With XD_RAW_BYTES hashes, blobs and the
+ * transaction ID are byte strings instead of hex. Objects and arrays are indefinite length so they can be streamed
+ * to an fd before their size is known. It shares the JSON visitor's output state.
+ */
+#define CBOR_UINT 0U
+#define CBOR_BYTES 2U
+#define CBOR_TEXT 3U
+#define CBOR_ARRAY 4U
+#define CBOR_MAP 5U
+#define CBOR_INDEFINITE 31U
+#define CBOR_BREAK 0xFFU
+
+// a data item's head, the major type and its argument big endian in the fewest bytes
+static int cbor_head(uint8_t* out, unsigned major, uint64_t value)
+{
+    major <<= 5U;
+    if (value < 24)
+    {
+        out[0] = (uint8_t)(major | value);
+        return 1;
+    }
+    int size = (value <= 0xFFU ? 1 : value <= 0xFFFFU ? 2 : value <= 0xFFFFFFFFU ? 4 : 8);
+    out[0] = (uint8_t)(major | (size == 1 ? 24U : size == 2 ? 25U : size == 4 ? 26U : 27U));
+    for (int i = 0; i < size; ++i)
+        out[1 + i] = (uint8_t)(value >> ((size - 1 - i) * 8U));
+    return 1 + size;
+}
+
+static int cbor_item(struct xd_json* j, unsigned major, const void* data, int len)
+{
+    uint8_t head[9];
+    APPEND(APPENDNOINDENT, head, cbor_head(head, major, len));
+    if (len > 0)
+        APPEND(APPENDNOINDENT, data, len);
+    return 1;
+}
+
+static int cbor_marker(struct xd_json* j, uint8_t marker)
+{
+    APPEND(APPENDNOINDENT, &marker, 1);
+    return 1;
+}
+
+// hex text, or a byte string with XD_RAW_BYTES: the head for `len` bytes, then the bytes, which may come in pieces
+static int cbor_binary_head(struct xd_json* j, int len)
+{
+    uint8_t head[9];
+    if (j->ctx->flags & XD_RAW_BYTES)
+        APPEND(APPENDNOINDENT, head, cbor_head(head, CBOR_BYTES, len));
+    else
+        APPEND(APPENDNOINDENT, head, cbor_head(head, CBOR_TEXT, len * 2ULL));
+    return 1;
+}
+
+static int cbor_binary_body(struct xd_json* j, const uint8_t* bytes, int len)
+{
+    if (j->ctx->flags & XD_RAW_BYTES)
+    {
+        if (len > 0)
+            APPEND(APPENDNOINDENT, bytes, len);
+        return 1;
+    }
+
+    uint8_t hexout[1024];
+    for (int done = 0; done < len;)
+    {
+        int chunk = (len - done > (int)sizeof(hexout) / 2 ? (int)sizeof(hexout) / 2 : len - done);
+        HEX(hexout, bytes + done, chunk);
+        APPEND(APPENDNOINDENT, hexout, chunk * 2);
+        done += chunk;
+    }
+    return 1;
+}
+
+static int cbor_binary(struct xd_json* j, const uint8_t* bytes, int len)
+{
+    return cbor_binary_head(j, len) && cbor_binary_body(j, bytes, len);
+}
+
+static int cbor_address(struct xd_json* j, const uint8_t* id)
+{
+    if (!id)
+        return cbor_item(j, CBOR_TEXT, 0, 0);
+    size_t acc_size = 0;
+    const char* acc = xd_address(j->ctx, id, &acc_size);
+    if (!acc)
+        return xd_error(j->ctx, XD_ERR_ENCODE, "Error: could not base58 encode");
+    return cbor_item(j, CBOR_TEXT, acc, acc_size - 1);
+}
+
+// the element wrapper inside an array (a map of one pair), then the key
+static int cbor_key(struct xd_json* j, const struct xd_field* field)
+{
+    if ((j->parent_is_array & 1) && !cbor_marker(j, (CBOR_MAP << 5U) | 1U))
+        return 0;
+    if (!field->name)
+        return xd_error(j->ctx, XD_ERR_UNKNOWN_FIELD, "Error: Unknown field_id %05X", field->field_id);
+    return cbor_item(j, CBOR_TEXT, field->name, field->name_len);
+}
+
+static int cbor_begin(struct xd_json* j, const struct xd_field* field, int is_array)
+{
+    if (!field)
+        return cbor_marker(j, (CBOR_MAP << 5U) | CBOR_INDEFINITE);
+
+    if (!cbor_key(j, field) || !cbor_marker(j, ((is_array ? CBOR_ARRAY : CBOR_MAP) << 5U) | CBOR_INDEFINITE))
+        return 0;
+    j->parent_is_array <<= 1U;
+    j->parent_is_array |= (unsigned)is_array;
+    j->depth++;
+    return 1;
+}
+
+static int cbor_end(struct xd_json* j)
+{
+    // the computed transaction ID goes after the outermost object's last field
+    if (j->depth == 0 && (j->ctx->flags & XD_TXID) &&
+            (!cbor_item(j, CBOR_TEXT, "hash", 4) || !cbor_binary(j, j->ctx->txid, 32)))
+        return 0;
+    if (!cbor_marker(j, CBOR_BREAK))
+        return 0;
+    if (j->depth > 0)
+    {
+        j->parent_is_array >>= 1U;
+        j->depth--;
+    }
+    return 1;
+}
+
+static int cbor_begin_object(void* user, const struct xd_field* field)
+{
+    return cbor_begin(user, field, 0);
+}
+
+static int cbor_begin_array(void* user, const struct xd_field* field)
+{
+    return cbor_begin(user, field, 1);
+}
+
+static int cbor_end_container(void* user)
+{
+    return cbor_end(user);
+}
+
+static int cbor_integer(void* user, const struct xd_field* field, uint64_t number)
+{
+    struct xd_json* j = user;
+    const struct definitions* definitions = j->ctx->definitions;
+    if (!cbor_key(j, field))
+        return 0;
+
+    // named codes
+    const struct definitions_name* name = 0;
+    if (field->type_code == 1 && field->field_code == 2)
+        name = &definitions->transaction_types[number & 0xFFU];
+    else if (field->type_code == 1 && field->field_code == 1)
+        name = &definitions->ledger_entry_types[number & 0xFFU];
+    else if (field->type_code == 16 && field->field_code == 3)
+        name = &definitions->transaction_results[number & 0xFFU];
+
+    // stored as `"Name"`
+    if (name && number < 256 && name->offset)
+        return cbor_item(j, CBOR_TEXT, DEFINITIONS_STR(definitions, *name) + 1, name->len - 2);
+
+    uint8_t head[9];
+    APPEND(APPENDNOINDENT, head, cbor_head(head, CBOR_UINT, number));
+    return 1;
+}
+
+static int cbor_hash(void* user, const struct xd_field* field, const uint8_t* bytes, int len)
+{
+    struct xd_json* j = user;
+    return cbor_key(j, field) && cbor_binary(j, bytes, len);
+}
+
+static int cbor_blob_part(void* user, const struct xd_field* field, const uint8_t* bytes, int len, int offset, int total)
+{
+    struct xd_json* j = user;
+    if (offset == 0 && !(cbor_key(j, field) && cbor_binary_head(j, total)))
+        return 0;
+    return cbor_binary_body(j, bytes, len);
+}
+
+static int cbor_account(void* user, const struct xd_field* field, const uint8_t* id)
+{
+    struct xd_json* j = user;
+    return cbor_key(j, field) && cbor_address(j, id);
+}
+
+static int cbor_amount(void* user, const struct xd_field* field, const struct xd_amount* amount)
+{
+    struct xd_json* j = user;
+    if (!cbor_key(j, field))
+        return 0;
+
+    char value[XD_AMOUNT_VALUE_SIZE];
+    int value_len = xd_amount_value(value, amount);
+    if (amount->native)
+        return cbor_item(j, CBOR_TEXT, value, value_len);
+
+    char currency[40];
+    return cbor_marker(j, (CBOR_MAP << 5U) | 3U) &&
+           cbor_item(j, CBOR_TEXT, "value", 5) && cbor_item(j, CBOR_TEXT, value, value_len) &&
+           cbor_item(j, CBOR_TEXT, "currency", 8) &&
+           cbor_item(j, CBOR_TEXT, currency, xd_currency_code(currency, amount->currency)) &&
+           cbor_item(j, CBOR_TEXT, "issuer", 6) && cbor_address(j, amount->issuer);
+}
+
+// a pathset is an array of paths, each an array of steps
+static int cbor_begin_pathset(void* user, const struct xd_field* field)
+{
+    struct xd_json* j = user;
+    return cbor_key(j, field) &&
+           cbor_marker(j, (CBOR_ARRAY << 5U) | CBOR_INDEFINITE) &&
+           cbor_marker(j, (CBOR_ARRAY << 5U) | CBOR_INDEFINITE);
+}
+
+static int cbor_path_step(void* user, const struct xd_path_step* step)
+{
+    struct xd_json* j = user;
+    char currency[40];
+    uint8_t head[9];
+    unsigned pairs = 1U + (step->account != 0) + (step->currency != 0) + (step->issuer != 0);
+    if (!cbor_marker(j, (CBOR_MAP << 5U) | pairs) || !cbor_item(j, CBOR_TEXT, "type", 4))
+        return 0;
+    APPEND(APPENDNOINDENT, head, cbor_head(head, CBOR_UINT, step->type));
+    return (!step->account || (cbor_item(j, CBOR_TEXT, "account", 7) && cbor_address(j, step->account))) &&
+           (!step->currency || (cbor_item(j, CBOR_TEXT, "currency", 8) &&
+                   cbor_item(j, CBOR_TEXT, currency, xd_currency_code(currency, step->currency)))) &&
+           (!step->issuer || (cbor_item(j, CBOR_TEXT, "issuer", 6) && cbor_address(j, step->issuer)));
+}
+
+static int cbor_next_path(void* user)
+{
+    struct xd_json* j = user;
+    return cbor_marker(j, CBOR_BREAK) && cbor_marker(j, (CBOR_ARRAY << 5U) | CBOR_INDEFINITE);
+}
+
+static int cbor_end_pathset(void* user)
+{
+    struct xd_json* j = user;
+    return cbor_marker(j, CBOR_BREAK) && cbor_marker(j, CBOR_BREAK);
+}
+
+static const struct xd_visitor cbor_visitor =
+{
+    .begin_object = cbor_begin_object,
+    .end_object = cbor_end_container,
+    .begin_array = cbor_begin_array,
+    .end_array = cbor_end_container,
+    .integer = cbor_integer,
+    .hash = cbor_hash,
+    .account = cbor_account,
+    .amount = cbor_amount,
+    .blob = cbor_hash,
+    .blob_part = cbor_blob_part,
+    .begin_pathset = cbor_begin_pathset,
+    .path_step = cbor_path_step,
+    .next_path = cbor_next_path,
+    .end_pathset = cbor_end_pathset
+};
+
+// start buffer mode output at the front of the context's chunks with XD_CHUNKED or of ctx->output otherwise
+static int xd_sink_open(struct xd_ctx* ctx, struct xd_sink* sink)
+{
+    *sink = (struct xd_sink){ 0 };
+    if (ctx->flags & XD_CHUNKED)
+    {
+        if (!ctx->chunks)
+        {
+            if (!(ctx->chunks = malloc(sizeof(*ctx->chunks))))
+                return xd_error(ctx, XD_ERR_MEMORY, "Error: could not allocate an output chunk");
+            ctx->chunks->next = 0;
+        }
+        sink->chunk = ctx->chunks;
+        sink->output = sink->chunk->bytes;
+        sink->len = XD_OUTPUT_CHUNK_SIZE;
+        return 1;
+    }
+
+    if (!ctx->output)
+    {
+        if (!(ctx->output = malloc(XD_OUTPUT_SIZE + 1)))
+            return xd_error(ctx, XD_ERR_MEMORY, "Error: could not allocate the output buffer");
+        ctx->output_capacity = XD_OUTPUT_SIZE;
+        ctx->owns_output = 1;
+    }
+    sink->output = ctx->output;
+    sink->len = ctx->output_capacity;
+    sink->fixed = !ctx->owns_output;
+    return 1;
+}
+
+// leave what went into the sink since it was opened as the context's result
+static void xd_sink_close(struct xd_ctx* ctx, struct xd_sink* sink)
+{
+    if (sink->chunk)
+    {
+        sink->chunk->len = sink->upto;
+        ctx->output_len = 0;
+        ctx->output_chunks = 0;
+        for (struct xd_chunk* chunk = ctx->chunks;; chunk = chunk->next)
+        {
+            ctx->output_len += chunk->len;
+            ctx->output_chunks++;
+            if (chunk == sink->chunk)
+                break;
+        }
+        return;
+    }
+
+    ctx->output = sink->output;
+    if (!sink->fixed)
+        ctx->output_capacity = sink->len;
+    ctx->output_len = sink->upto;
+    ctx->output[sink->upto] = '\0';
+}
+
+// parse with the JSON (or with XD_CBOR the CBOR) visitor, see xd_parse for the modes
+static int xd_json(
+        struct xd_ctx* ctx,
+        const uint8_t* input,
+        int input_len,
+        xd_fetch fetch_data_func,
+        void* fetch_arg,
+        int write_fd)
+{
+    struct xd_json json = { ctx, (ctx->flags & XD_COMPACT) != 0 };
+
+    if (write_fd)
+    {
+        if (!ctx->write_buffer && !(ctx->write_buffer = malloc(XD_WRITE_BUFFER_SIZE)))
+            return xd_error(ctx, XD_ERR_MEMORY, "Error: could not allocate the write buffer");
+        json.out.output = ctx->write_buffer;
+        json.out.len = XD_WRITE_BUFFER_SIZE;
+        json.out.write_fd = write_fd;
+    }
+    else if (!xd_sink_open(ctx, &json.out))
+        return 0;
+
+    const struct xd_visitor* visitor = ((ctx->flags & XD_CBOR) ? &cbor_visitor : &json_visitor);
+    int ok = xd_parse(ctx, input, input_len, fetch_data_func, fetch_arg, visitor, &json);
+
+    if (write_fd)
+    {
+        // anything buffered before an error still goes out
+        if (!flush_output(write_fd, json.out.output, &json.out.upto, 0, 0) && ok)
+            return xd_error(ctx, XD_ERR_OUTPUT, "Error: output could not be written");
+        return ok;
+    }
+
+    // a grown buffer is kept even when the parse failed, the partial result isn't
+    xd_sink_close(ctx, &json.out);
+    if (!ok)
+        ctx->output_len = ctx->output_chunks = 0;
+    return ok;
+}
+
+
+
+static void xd_reset(struct xd_ctx* ctx)
+{
+    ctx->error = XD_OK;
+    ctx->error_offset = 0;
+    ctx->error_message[0] = '\0';
+    ctx->output_len = 0;
+    ctx->output_chunks = 0;
+}
+
+/**
+ * Push mode: the object arrives in chunks of any size through xd_feed instead of being pulled through a fetch
+ * function, so one thread can decode many streams from an event loop. The parse is a state machine over units (a
+ * field header, a field's value, one path step or path marker) kept in the context between calls. Units are
+ * handled in place in the chunk, only one that straddles two chunks is gathered into the carry buffer first, and
+ * the value of a skipped field is counted off without being gathered at all.
+ */
+enum xd_push_state
+{
+    XD_PUSH_HEADER = 0,     // the next field's header
+    XD_PUSH_VALUE,          // the value of `field`
+    XD_PUSH_PATHSET,        // a path step or marker of `field`
+    XD_PUSH_DISCARD,        // `discard` more bytes of a skipped value
+    XD_PUSH_BLOB,           // the rest of a blob handed over in pieces
+    XD_PUSH_STOPPED         // failed or ended, until the next xd_feed_begin
+};
+
+struct xd_push
+{
+    const struct xd_visitor* visitor;
+    void* user;
+    struct xd_json json;            // the visitor's state for xd_feed_begin without a visitor
+    struct xd_nesting nesting;
+    int state;
+    struct xd_field field;
+    int emit;
+    int64_t discard;
+    int blob_offset;
+    int blob_len;
+
+    uint8_t* carry;                 // the start of a unit the last chunk ended inside
+    int carry_len;
+    int carry_capacity;
+    size_t offset;                  // bytes of the object consumed, for error_offset
+
+    struct sha512_ctx txid;
+    int hashing;
+};
+
+// record the failure, or a visitor's refusal, and stop the object
+static int xd_push_stop(struct xd_ctx* ctx, struct xd_push* s)
+{
+    if (ctx->error == XD_OK)
+        xd_error(ctx, XD_ERR_VISITOR, "Error: stopped by the visitor");
+    ctx->error_offset = s->offset;
+    s->state = XD_PUSH_STOPPED;
+    return ctx->error;
+}
+
+#define PUSH_EMIT(event, ...)\
+{\
+    if (s->visitor->event && !s->visitor->event(__VA_ARGS__))\
+        return xd_push_stop(ctx, s);\
+}
+
+/**
+ * Point `view` at the next `want` bytes of the unit: in place when the chunk holds them and nothing is carried,
+ * otherwise gathered into the carry buffer. Returns 0 when the chunk ran out first (everything left in it is carried
+ * to the next one) and -1 with ctx->error set if the unit is too large. Nothing is consumed
+ */
+static int xd_push_view(struct xd_ctx* ctx, struct xd_push* s, const uint8_t** p, const uint8_t* end,
+        int64_t want, const uint8_t** view)
+{
+    if (s->carry_len == 0 && end - *p >= want)
+    {
+        *view = *p;
+        return 1;
+    }
+
+    if (want > XD_INPUT_SIZE)
+        return (xd_error(ctx, XD_ERR_OVERSIZE, "Error: %d byte field does not fit the %d byte input buffer",
+                    (int)want, XD_INPUT_SIZE), -1);
+    if (want > s->carry_capacity)
+    {
+        int capacity = (s->carry_capacity ? s->carry_capacity : 256);
+        while (capacity < want)
+            capacity *= 2;
+        uint8_t* grown = realloc(s->carry, capacity);
+        if (!grown)
+            return (xd_error(ctx, XD_ERR_MEMORY, "Error: could not allocate the carry buffer"), -1);
+        s->carry = grown;
+        s->carry_capacity = capacity;
+    }
+
+    int64_t take = want - s->carry_len;
+    if (take > end - *p)
+        take = end - *p;
+    if (take > 0)
+    {
+        memcpy(s->carry + s->carry_len, *p, take);
+        s->carry_len += take;
+        *p += take;
+    }
+    if (s->carry_len < want)
+        return 0;
+
+    *view = s->carry;
+    return 1;
+}
+
+// move past `count` bytes of the unit, the carried ones first
+static void xd_push_consume(struct xd_push* s, const uint8_t** p, int64_t count)
+{
+    s->offset += count;
+    if (s->carry_len == 0)
+    {
+        *p += count;
+        return;
+    }
+
+    int carried = (count < s->carry_len ? count : s->carry_len);
+    memmove(s->carry, s->carry + carried, s->carry_len - carried);
+    s->carry_len -= carried;
+    *p += count - carried;
+}
+
+#define VIEW(want)\
+{\
+    int ready = xd_push_view(ctx, s, &p, end, (want), &v);\
+    if (ready < 0)\
+        return xd_push_stop(ctx, s);\
+    if (!ready)\
+        return XD_OK;\
+}
+
+// run the state machine over one chunk
+static int xd_push_run(struct xd_ctx* ctx, struct xd_push* s, const uint8_t* p, const uint8_t* end)
+{
+    const struct definitions* definitions = ctx->definitions;
+    const uint8_t* v;
+
+    while (p < end || s->carry_len > 0)
+    {
+        if (s->state == XD_PUSH_DISCARD)
+        {
+            int64_t count = s->carry_len + (end - p);
+            if (count > s->discard)
+                count = s->discard;
+            xd_push_consume(s, &p, count);
+            if ((s->discard -= count) == 0)
+                s->state = XD_PUSH_HEADER;
+        }
+        else if (s->state == XD_PUSH_BLOB)
+        {
+            // whatever of it is carried, then whatever is in the chunk
+            const uint8_t* part = (s->carry_len ? s->carry : p);
+            int64_t part_len = (s->carry_len ? s->carry_len : end - p);
+            if (part_len > s->blob_len - s->blob_offset)
+                part_len = s->blob_len - s->blob_offset;
+            PUSH_EMIT(blob_part, s->user, &s->field, part, part_len, s->blob_offset, s->blob_len);
+            xd_push_consume(s, &p, part_len);
+            if ((s->blob_offset += part_len) == s->blob_len)
+                s->state = XD_PUSH_HEADER;
+        }
+        else if (s->state == XD_PUSH_HEADER)
+        {
+            VIEW(1);
+            int header_len = xd_header_len(*v);
+            VIEW(header_len);
+            int type_code, field_code;
+            xd_header(v, &type_code, &field_code);
+            xd_push_consume(s, &p, header_len);
+
+            int is_end;
+            s->emit = xd_open_field(ctx, &s->nesting, &s->field, type_code, field_code, &is_end);
+            if (s->emit < 0)
+                return xd_push_stop(ctx, s);
+
+            int kind = s->field.kind;
+            if (is_end)
+            {
+                if (s->emit && kind == KIND_OBJECT)
+                    PUSH_EMIT(end_object, s->user)
+                else if (s->emit)
+                    PUSH_EMIT(end_array, s->user)
+            }
+            else if (kind == KIND_OBJECT)
+            {
+                if (s->emit)
+                    PUSH_EMIT(begin_object, s->user, &s->field);
+            }
+            else if (kind == KIND_ARRAY)
+            {
+                if (s->emit)
+                    PUSH_EMIT(begin_array, s->user, &s->field);
+            }
+            else if (kind == KIND_PATHSET)
+            {
+                if (s->emit)
+                    PUSH_EMIT(begin_pathset, s->user, &s->field);
+                s->state = XD_PUSH_PATHSET;
+            }
+            else
+                s->state = XD_PUSH_VALUE;
+        }
+        else if (s->state == XD_PUSH_PATHSET)
+        {
+            VIEW(1);
+            uint8_t path_type = *v;
+            if (path_type == 0x00U || path_type == 0xFFU)
+            {
+                xd_push_consume(s, &p, 1);
+                if (path_type == 0x00U)
+                    s->state = XD_PUSH_HEADER;
+                if (s->emit && path_type == 0x00U)
+                    PUSH_EMIT(end_pathset, s->user)
+                else if (s->emit)
+                    PUSH_EMIT(next_path, s->user)
+                continue;
+            }
+
+            int step_len = 1 + 20 * ((path_type & 0x01U) + ((path_type >> 4U) & 1U) + ((path_type >> 5U) & 1U));
+            VIEW(step_len);
+            if (s->emit)
+            {
+                struct xd_path_step step = { path_type, 0, 0, 0 };
+                const uint8_t* step_bytes = v + 1;
+                if (path_type & 0x01U)
+                {
+                    step.account = step_bytes;
+                    step_bytes += 20;
+                }
+                if (path_type & 0x10U)
+                {
+                    step.currency = step_bytes;
+                    step_bytes += 20;
+                }
+                if (path_type & 0x20U)
+                    step.issuer = step_bytes;
+                PUSH_EMIT(path_step, s->user, &step);
+            }
+            xd_push_consume(s, &p, step_len);
+        }
+        else if (s->state == XD_PUSH_VALUE)
+        {
+            // the length prefix (if any) and the value's length
+            int kind = s->field.kind;
+            int prefix = 0;
+            int64_t len = definitions->type_size[s->field.type_code];
+            if (kind == KIND_ACCOUNT)
+            {
+                VIEW(1);
+                prefix = 1;
+                len = (*v ? 20 : 0);
+            }
+            else if (kind == KIND_AMOUNT)
+            {
+                VIEW(1);
+                len = ((*v) >> 7U ? 48 : 8);
+            }
+            else if (kind == KIND_BLOB || kind == KIND_VECTOR256)
+            {
+                VIEW(1);
+                prefix = (*v <= 192 ? 1 : *v <= 240 ? 2 : 3);
+                VIEW(prefix);
+                len = *v;
+                if (prefix == 2)
+                    len = 193 + ((len - 193) * 256) + *(v+1);
+                else if (prefix == 3)
+                    len = 12481 + ((len - 241) * 65536) + ((*(v+1)) * 256) + *(v+2);
+            }
+
+            if (!s->emit)
+            {
+                xd_push_consume(s, &p, prefix);
+                s->discard = len;
+                s->state = (len > 0 ? XD_PUSH_DISCARD : XD_PUSH_HEADER);
+                continue;
+            }
+
+            // a blob that isn't all in this chunk goes to a visitor that takes pieces as they come, not gathered
+            int in_place = (s->carry_len == 0 && end - p >= prefix + len);
+            if ((kind == KIND_BLOB || kind == KIND_VECTOR256) && len > 0 && !in_place && s->visitor->blob_part)
+            {
+                xd_push_consume(s, &p, prefix);
+                s->blob_offset = 0;
+                s->blob_len = len;
+                s->state = XD_PUSH_BLOB;
+                continue;
+            }
+
+            VIEW(prefix + len);
+            const uint8_t* value = v + prefix;
+            const struct xd_field* field = &s->field;
+            if (kind == KIND_ACCOUNT)
+                PUSH_EMIT(account, s->user, field, (len ? value : 0))
+            else if (kind == KIND_HASH)
+                PUSH_EMIT(hash, s->user, field, value, len)
+            else if (kind == KIND_BLOB || kind == KIND_VECTOR256)
+                PUSH_EMIT(blob, s->user, field, value, len)
+            else if (kind == KIND_AMOUNT)
+            {
+                struct xd_amount amount;
+                xd_amount_read(&amount, value);
+                PUSH_EMIT(amount, s->user, field, &amount);
+            }
+            else if (kind == KIND_UINT)
+            {
+                uint64_t number = 0;
+                for (int i = 0; i < len; ++i)
+                    number = (number << 8U) + *(value+i);
+                PUSH_EMIT(integer, s->user, field, number);
+            }
+            xd_push_consume(s, &p, prefix + len);
+            s->state = XD_PUSH_HEADER;
+        }
+        else
+            return ctx->error;
+    }
+
+    return XD_OK;
+}
+
+// start a call: the JSON visitor's text so far has been taken by the caller, so its output starts over
+static void xd_push_enter(struct xd_ctx* ctx, struct xd_push* s)
+{
+    ctx->output_len = ctx->output_chunks = 0;
+    if (s->user == &s->json)
+        xd_sink_open(ctx, &s->json.out);    // can't fail, xd_feed_begin allocated the output
+}
+
+// end a call: what the JSON visitor wrote during it is left in ctx->output (or its chunks)
+static int xd_push_leave(struct xd_ctx* ctx, struct xd_push* s, int error)
+{
+    if (s->user == &s->json)
+        xd_sink_close(ctx, &s->json.out);
+    return error;
+}
+
+int xd_feed_begin(struct xd_ctx* ctx, const struct xd_visitor* visitor, void* user)
+{
+    xd_reset(ctx);
+    if (!ctx->push)
+    {
+        if (!(ctx->push = calloc(1, sizeof(*ctx->push))))
+            return (xd_error(ctx, XD_ERR_MEMORY, "Error: could not allocate the push parser"), ctx->error);
+    }
+
+    // everything but the carry buffer starts afresh
+    struct xd_push* s = ctx->push;
+    uint8_t* carry = s->carry;
+    int carry_capacity = s->carry_capacity;
+    memset(s, 0, sizeof(*s));
+    s->carry = carry;
+    s->carry_capacity = carry_capacity;
+
+    s->visitor = visitor;
+    s->user = user;
+    if (!visitor)
+    {
+        s->json = (struct xd_json){ ctx, (ctx->flags & XD_COMPACT) != 0 };
+        if (!xd_sink_open(ctx, &s->json.out))
+            return xd_push_stop(ctx, s);
+        s->visitor = ((ctx->flags & XD_CBOR) ? &cbor_visitor : &json_visitor);
+        s->user = &s->json;
+    }
+
+    s->hashing = ((ctx->flags & XD_TXID) && !ctx->txid_given);
+    if (s->hashing)
+    {
+        sha512_init(&s->txid);
+        sha512_update(&s->txid, (const uint8_t[]){ 'T', 'X', 'N', 0 }, 4);
+    }
+    ctx->txid_given = 0;
+
+    xd_push_enter(ctx, s);
+    PUSH_EMIT(begin_object, s->user, 0);
+    return xd_push_leave(ctx, s, XD_OK);
+}
+
+int xd_feed(struct xd_ctx* ctx, const uint8_t* bytes, size_t len)
+{
+    struct xd_push* s = ctx->push;
+    if (!s || s->state == XD_PUSH_STOPPED)
+        return (ctx->error != XD_OK ? ctx->error :
+                (xd_error(ctx, XD_ERR_INPUT, "Error: xd_feed without xd_feed_begin"), ctx->error));
+
+    xd_push_enter(ctx, s);
+    if (s->hashing)
+        sha512_update(&s->txid, bytes, len);
+    return xd_push_leave(ctx, s, xd_push_run(ctx, s, bytes, bytes + len));
+}
+
+int xd_feed_end(struct xd_ctx* ctx)
+{
+    struct xd_push* s = ctx->push;
+    if (!s || s->state == XD_PUSH_STOPPED)
+        return (ctx->error != XD_OK ? ctx->error :
+                (xd_error(ctx, XD_ERR_INPUT, "Error: xd_feed_end without xd_feed_begin"), ctx->error));
+
+    xd_push_enter(ctx, s);
+
+    // don't pass off a partial object as a result
+    if (s->state != XD_PUSH_HEADER || s->carry_len > 0)
+    {
+        xd_error(ctx, XD_ERR_TRUNCATED, "Error: input ended inside a field");
+        return xd_push_leave(ctx, s, xd_push_stop(ctx, s));
+    }
+    if (s->nesting.object_level != 0 || s->nesting.array_level != 0)
+    {
+        xd_error(ctx, XD_ERR_TRUNCATED, "Error: input ended inside an object or array");
+        return xd_push_leave(ctx, s, xd_push_stop(ctx, s));
+    }
+
+    if (s->hashing)
+        sha512_half_final(&s->txid, ctx->txid);
+
+    if (s->visitor->end_object && !s->visitor->end_object(s->user))
+        return xd_push_leave(ctx, s, xd_push_stop(ctx, s));
+    s->state = XD_PUSH_STOPPED;
+    return xd_push_leave(ctx, s, XD_OK);
+}
+
+void xd_init(struct xd_ctx* ctx, const struct definitions* definitions, unsigned flags)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->definitions = definitions;
+    ctx->flags = flags;
+
+    // without a cache every address is encoded from scratch, which is slower but still correct
+    if ((ctx->accounts = aligned_alloc(64, sizeof(*ctx->accounts))))
+        memset(ctx->accounts, 0, sizeof(*ctx->accounts));
+}
+
+void xd_free(struct xd_ctx* ctx)
+{
+    if (ctx->accounts)
+        account_cache_retire(ctx->accounts);
+    free(ctx->accounts);
+    if (ctx->owns_output)
+        free(ctx->output);
+    xd_free_input(ctx);
+    free(ctx->write_buffer);
+    while (ctx->chunks)
+    {
+        struct xd_chunk* next = ctx->chunks->next;
+        free(ctx->chunks);
+        ctx->chunks = next;
+    }
+    if (ctx->push)
+        free(ctx->push->carry);
+    free(ctx->push);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void xd_set_output(struct xd_ctx* ctx, uint8_t* buffer, size_t capacity)
+{
+    if (ctx->owns_output)
+        free(ctx->output);
+    ctx->output = buffer;
+    // one byte is kept for the NUL
+    ctx->output_capacity = (capacity > 0 ? capacity - 1 : 0);
+    ctx->owns_output = 0;
+}
+
+int xd_output_iov(const struct xd_ctx* ctx, struct iovec* iov, int max)
+{
+    if (!(ctx->flags & XD_CHUNKED))
+    {
+        if (max > 0)
+            iov[0] = (struct iovec){ ctx->output, ctx->output_len };
+        return 1;
+    }
+
+    const struct xd_chunk* chunk = ctx->chunks;
+    for (int i = 0; i < ctx->output_chunks && i < max; ++i, chunk = chunk->next)
+        iov[i] = (struct iovec){ (void*)chunk->bytes, chunk->len };
+    return ctx->output_chunks;
+}
+
+int xd_output_copy(const struct xd_ctx* ctx, uint8_t* buffer, size_t capacity)
+{
+    if (capacity < ctx->output_len + 1)
+        return XD_ERR_OUTPUT;
+
+    if (!(ctx->flags & XD_CHUNKED))
+        memcpy(buffer, ctx->output, ctx->output_len);
+    else
+    {
+        uint8_t* p = buffer;
+        const struct xd_chunk* chunk = ctx->chunks;
+        for (int i = 0; i < ctx->output_chunks; ++i, chunk = chunk->next)
+        {
+            memcpy(p, chunk->bytes, chunk->len);
+            p += chunk->len;
+        }
+    }
+    buffer[ctx->output_len] = '\0';
+    return XD_OK;
+}
+
+void xd_set_projection(struct xd_ctx* ctx, const struct xd_projection* projection)
+{
+    ctx->projection = projection;
+}
+
+void xd_set_txid(struct xd_ctx* ctx, const uint8_t* hash)
+{
+    memcpy(ctx->txid, hash, sizeof(ctx->txid));
+    ctx->txid_given = 1;
+}
+
+void xd_set_input_buffer(struct xd_ctx* ctx, uint8_t* buffer, int size)
+{
+    xd_free_input(ctx);
+    ctx->input_buffer = buffer;
+    ctx->input_buffer_size = size;
+    ctx->owns_input = 0;
+}
+
+int xd_decode_to_fd(struct xd_ctx* ctx, const uint8_t* input, size_t input_len, int write_fd)
+{
+    xd_reset(ctx);
+    if (input_len > INT32_MAX)
+        return (xd_error(ctx, XD_ERR_OVERSIZE, "Error: input larger than 2GB"), ctx->error);
+    return (xd_json(ctx, input, (int)input_len, 0, 0, write_fd) ? XD_OK : ctx->error);
+}
+
+int xd_decode(struct xd_ctx* ctx, const uint8_t* input, size_t input_len)
+{
+    return xd_decode_to_fd(ctx, input, input_len, 0);
+}
+
+int xd_decode_stream(struct xd_ctx* ctx, xd_fetch fetch, void* user, int write_fd)
+{
+    xd_reset(ctx);
+    return (xd_json(ctx, 0, 0, fetch, user, write_fd) ? XD_OK : ctx->error);
+}
+
+int xd_visit(struct xd_ctx* ctx, const uint8_t* input, size_t input_len, const struct xd_visitor* visitor, void* user)
+{
+    xd_reset(ctx);
+    if (input_len > INT32_MAX)
+        return (xd_error(ctx, XD_ERR_OVERSIZE, "Error: input larger than 2GB"), ctx->error);
+    return (xd_parse(ctx, input, (int)input_len, 0, 0, visitor, user) ? XD_OK : ctx->error);
+}
+
+int xd_visit_stream(struct xd_ctx* ctx, xd_fetch fetch, void* fetch_user, const struct xd_visitor* visitor, void* user)
+{
+    xd_reset(ctx);
+    return (xd_parse(ctx, 0, 0, fetch, fetch_user, visitor, user) ? XD_OK : ctx->error);
+}
+
+const char* xd_strerror(int error)
+{
+    switch (error)
+    {
+        case XD_OK:                 return "ok";
+        case XD_ERR_TRUNCATED:      return "input ended inside a field, object or array";
+        case XD_ERR_UNKNOWN_TYPE:   return "unknown type code";
+        case XD_ERR_UNKNOWN_FIELD:  return "unknown field code";
+        case XD_ERR_UNBALANCED:     return "unbalanced object or array end marker";
+        case XD_ERR_ENCODE:         return "AccountID could not be base58 encoded";
+        case XD_ERR_AMOUNT:         return "amount could not be formatted";
+        case XD_ERR_OVERSIZE:       return "field larger than the input buffer";
+        case XD_ERR_INPUT:          return "input could not be read";
+        case XD_ERR_OUTPUT:         return "output buffer full or output could not be written";
+        case XD_ERR_MEMORY:         return "out of memory";
+        case XD_ERR_VISITOR:        return "stopped by the visitor";
+        case XD_ERR_INDEX_FULL:     return "too many or too deeply nested fields";
+    }
+    return "unknown error";
+}
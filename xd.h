@@ -0,0 +1,248 @@
+#ifndef XD_H
+#define XD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include "definitions.h"
+#include "account_cache.h"
+
+/**
+ * libxd, the XRPL binary -> JSON deserializer as a library
+ * All state lives in a struct xd_ctx, so any number of contexts may decode concurrently on different threads.
+ * A context reuses its buffers (and its AccountID cache) from one call to the next, nothing calls exit() or
+ * writes to stderr: failures come back as an error code with a message and the input offset they happened at.
+ */
+
+#define XD_OUTPUT_SIZE (64*1024)        // initial size of an xd owned output buffer, it doubles as needed
+#define XD_INPUT_SIZE (2048*1024)       // stream mode input buffer, the largest field a stream may hold whole
+#define XD_WRITE_BUFFER_SIZE (64*1024)  // stream mode output is flushed to the fd in blocks of this
+#define XD_OUTPUT_CHUNK_SIZE (16*1024)  // with XD_CHUNKED, output is built in chunks of this kept from call to call
+
+#define XD_PROJECTION_SIZE 128  // most path components one projection holds
+#define XD_PROJECTION_DEPTH 16  // longest path in a projection
+
+// flags
+#define XD_COMPACT 1U   // JSON without indentation or newlines (apart from the one at the end)
+#define XD_TXID 2U      // compute the transaction ID (SHA-512Half of "TXN\0" + the object) into ctx->txid, the JSON gains "hash"
+#define XD_CBOR 4U      // CBOR (RFC 8949) instead of JSON, the same tree with integers as integers
+#define XD_RAW_BYTES 8U // with XD_CBOR, hashes and blobs as byte strings instead of hex text
+#define XD_CHUNKED 16U  // buffer mode output goes into a chain of fixed size chunks instead of ctx->output, see xd_output_iov
+
+enum xd_error
+{
+    XD_OK = 0,
+    XD_ERR_TRUNCATED,       // input ended inside a field, object or array
+    XD_ERR_UNKNOWN_TYPE,    // type code missing from the definitions
+    XD_ERR_UNKNOWN_FIELD,   // field code missing from the definitions
+    XD_ERR_UNBALANCED,      // more end markers than objects or arrays
+    XD_ERR_ENCODE,          // an AccountID could not be base58 encoded
+    XD_ERR_AMOUNT,          // an IOU amount could not be formatted
+    XD_ERR_OVERSIZE,        // stream mode field larger than the input buffer
+    XD_ERR_INPUT,           // the fetch function reported a read error or bad input
+    XD_ERR_OUTPUT,          // caller supplied output buffer too small, or writing to the fd failed
+    XD_ERR_MEMORY,          // allocation failure
+    XD_ERR_VISITOR,         // a visitor callback returned 0
+    XD_ERR_INDEX_FULL       // too many or too deeply nested fields for a field index or projection
+};
+
+/**
+ * Stream mode input. Write at least `min_bytes` (and at most `len`) bytes to `buf` and return how many were written.
+ * Return -1 at the end of the input and anything below -1 on a read error or bad input.
+ */
+typedef int (*xd_fetch)(void* user, uint8_t* buf, int len, int min_bytes);
+
+/**
+ * Field projection: a list of dotted field paths like "Account,Fee,AffectedNodes.ModifiedNode.LedgerEntryType"
+ * compiled to a trie of field_ids rooted at node 0. Only the listed fields, everything below them and the objects
+ * and arrays on the way to them are decoded, the rest is skipped by length without being formatted.
+ */
+struct xd_projection_node
+{
+    uint32_t field_id;
+    int16_t first_child;    // -1 for none
+    int16_t next;           // next sibling, -1 for none
+    uint8_t whole;          // a path ends here, everything below is selected
+};
+
+struct xd_projection
+{
+    int count;
+    struct xd_projection_node nodes[XD_PROJECTION_SIZE];
+};
+
+// returns XD_OK, XD_ERR_UNKNOWN_FIELD for a name missing from `definitions` or XD_ERR_INDEX_FULL if too long
+int xd_projection_compile(struct xd_projection* projection, const struct definitions* definitions, const char* fields);
+
+struct xd_ctx
+{
+    const struct definitions* definitions;
+    unsigned flags;
+    const struct xd_projection* projection;     // null to decode every field
+
+    // buffer mode result, NUL terminated. With XD_CHUNKED output_len is still its length but it is in the chunks
+    uint8_t* output;
+    size_t output_len;
+    size_t output_capacity;
+    int output_chunks;      // with XD_CHUNKED, how many chunks the result fills
+
+    // with XD_TXID, the ID of the object last decoded
+    uint8_t txid[32];
+
+    // set when a call fails
+    int error;
+    size_t error_offset;    // bytes into the input
+    char error_message[128];
+
+    // internal, kept between calls
+    int owns_output;
+    int owns_input;
+    int input_mirrored;     // input_buffer is mapped twice back to back, see xd_mirror_alloc
+    uint8_t* input_buffer;
+    int input_buffer_size;
+    uint8_t* write_buffer;
+    struct xd_chunk* chunks;    // the XD_CHUNKED arena, only ever grows
+    struct account_cache* accounts;
+    char address[43];
+    int txid_given;
+    struct xd_push* push;   // push mode state
+};
+
+// set up a context decoding against `definitions`, which must outlive it
+void xd_init(struct xd_ctx* ctx, const struct definitions* definitions, unsigned flags);
+
+// release everything the context allocated (caller supplied buffers are left alone)
+void xd_free(struct xd_ctx* ctx);
+
+// decode into the caller's buffer from now on, a result that doesn't fit fails with XD_ERR_OUTPUT. Not with XD_CHUNKED
+void xd_set_output(struct xd_ctx* ctx, uint8_t* buffer, size_t capacity);
+
+/**
+ * The last buffer mode result, whether or not it was XD_CHUNKED. Chunked output never moves what is already written
+ * as it grows and takes only as many chunks as it fills, a context keeps them for the next call. Without XD_CHUNKED
+ * the result is the one iovec over ctx->output.
+ * Fill in up to `max` iovecs, valid until the next call on the context, and return how many the result takes
+ */
+int xd_output_iov(const struct xd_ctx* ctx, struct iovec* iov, int max);
+
+// copy the result into `buffer` and NUL terminate it, XD_ERR_OUTPUT if it holds less than ctx->output_len + 1 bytes
+int xd_output_copy(const struct xd_ctx* ctx, uint8_t* buffer, size_t capacity);
+
+// decode only the fields `projection` selects from now on (null for all of them), it must outlive the context
+void xd_set_projection(struct xd_ctx* ctx, const struct xd_projection* projection);
+
+// use `hash` (32 bytes) as the next object's transaction ID instead of computing it, for callers that hash in bulk
+void xd_set_txid(struct xd_ctx* ctx, const uint8_t* hash);
+
+// stream mode reads into the caller's buffer from now on, no field may be larger than it unless it is a blob going to
+// a visitor with blob_part (as the JSON and CBOR ones do), so a small buffer is enough for them. The context's own
+// buffer is a ring that never needs compacting, a caller's buffer is compacted by moving what is left to its start
+void xd_set_input_buffer(struct xd_ctx* ctx, uint8_t* buffer, int size);
+
+// decode one object held entirely in memory, the JSON (or CBOR) is left in ctx->output / ctx->output_len
+int xd_decode(struct xd_ctx* ctx, const uint8_t* input, size_t input_len);
+
+// the same, writing the JSON to `write_fd` as it is produced
+int xd_decode_to_fd(struct xd_ctx* ctx, const uint8_t* input, size_t input_len, int write_fd);
+
+// decode one object read through `fetch`, writing the JSON to `write_fd` as it is produced
+int xd_decode_stream(struct xd_ctx* ctx, xd_fetch fetch, void* user, int write_fd);
+
+/**
+ * Typed events for the fields of one object, see xd_visit. They carry raw values: building hex, base58 or
+ * decimal strings is left to the visitor. Byte pointers point into the input and are valid only during the call.
+ */
+struct xd_field
+{
+    uint32_t field_id;      // type_code << 16 | field_code
+    int type_code;
+    int field_code;
+    int kind;               // enum type_kind
+    const char* name;       // from the definitions, not NUL terminated, null for a field they don't know
+    int name_len;
+};
+
+struct xd_amount
+{
+    int native;             // XRP, the mantissa holds the drops and the rest is unset
+    int negative;
+    uint64_t mantissa;
+    int exponent;
+    const uint8_t* currency;    // 20 bytes
+    const uint8_t* issuer;      // 20 byte AccountID
+};
+
+// decode the 8 (XRP) or 48 (IOU) byte serialized amount at `bytes`, bit 63 of the first byte says which
+void xd_amount_read(struct xd_amount* amount, const uint8_t* bytes);
+
+struct xd_path_step
+{
+    int type;                   // the step's type byte, says which of the following are present
+    const uint8_t* account;     // 20 byte AccountID or null
+    const uint8_t* currency;    // 20 bytes or null
+    const uint8_t* issuer;      // 20 byte AccountID or null
+};
+
+// every callback is optional, returning 0 from one stops the parse with XD_ERR_VISITOR unless it set ctx->error
+struct xd_visitor
+{
+    int (*begin_object)(void* user, const struct xd_field* field);    // field is null for the outermost object
+    int (*end_object)(void* user);
+    int (*begin_array)(void* user, const struct xd_field* field);
+    int (*end_array)(void* user);
+    int (*integer)(void* user, const struct xd_field* field, uint64_t value);                  // UInt8 - UInt64
+    int (*hash)(void* user, const struct xd_field* field, const uint8_t* bytes, int len);      // Hash128 - Hash256
+    int (*account)(void* user, const struct xd_field* field, const uint8_t* id);    // 20 bytes, null when empty
+    int (*amount)(void* user, const struct xd_field* field, const struct xd_amount* amount);
+    int (*blob)(void* user, const struct xd_field* field, const uint8_t* bytes, int len);      // Blob and Vector256
+    // optional, a Blob or Vector256 the stream or push parser doesn't have whole comes through this in pieces
+    // instead, `offset` bytes into a value `total` bytes long. Without it the value is gathered whole for `blob`
+    int (*blob_part)(void* user, const struct xd_field* field, const uint8_t* bytes, int len, int offset, int total);
+    int (*begin_pathset)(void* user, const struct xd_field* field);
+    int (*path_step)(void* user, const struct xd_path_step* step);
+    int (*next_path)(void* user);   // a path ended and another follows
+    int (*end_pathset)(void* user);
+};
+
+/**
+ * Formatting for visitors, the text the JSON decoder writes without its quotes
+ */
+#define XD_AMOUNT_VALUE_SIZE 128
+
+// NUL terminated r-address of a 20 byte AccountID or 0 if it could not be encoded, `len` receives the length
+// including the NUL. From the context's cache when it has one, valid until the next call on the context
+const char* xd_address(struct xd_ctx* ctx, const uint8_t* id, size_t* len);
+
+// the decimal value of an amount (drops for XRP) into `out`, which holds XD_AMOUNT_VALUE_SIZE, returns its length
+int xd_amount_value(char* out, const struct xd_amount* amount);
+
+// 3 letter code (XRP for all zeros) or 40 hex digits into `out`, not NUL terminated, returns the length
+int xd_currency_code(char* out, const uint8_t* currency);
+
+// parse one object held entirely in memory into events for `visitor`, the JSON decoder is one such visitor
+int xd_visit(struct xd_ctx* ctx, const uint8_t* input, size_t input_len, const struct xd_visitor* visitor, void* user);
+
+// the same, reading the object through `fetch`
+int xd_visit_stream(struct xd_ctx* ctx, xd_fetch fetch, void* fetch_user, const struct xd_visitor* visitor, void* user);
+
+/**
+ * Push mode, for event loops: the object's bytes are handed over in chunks of any size as they arrive instead of
+ * being pulled through a fetch function, and the parse suspends wherever a chunk ends, inside a field or not.
+ * Events go to `visitor`, or with a null visitor JSON (or CBOR) goes into ctx->output (or with XD_CHUNKED its
+ * chunks): each call leaves there the text it produced, which the caller takes before the next call. The input has
+ * no end of its own, the caller says where the object ends with xd_feed_end. One context holds one object at a time,
+ * start the next with xd_feed_begin. Every call returns an XD_* code, after a failure the rest of the object is
+ * refused.
+ */
+int xd_feed_begin(struct xd_ctx* ctx, const struct xd_visitor* visitor, void* user);
+
+// the next `len` bytes of the object, the pointers events carry are valid only during the call
+int xd_feed(struct xd_ctx* ctx, const uint8_t* bytes, size_t len);
+
+// the object ended, fails with XD_ERR_TRUNCATED unless it ended between fields at the top level
+int xd_feed_end(struct xd_ctx* ctx);
+
+const char* xd_strerror(int error);
+
+#endif